@@ -0,0 +1,20 @@
+#version 330 core
+
+// The depth pre-pass shader: it only outputs the position of the vertex (computed exactly like in the other shaders)
+layout(location = 0) in vec3 position;
+
+#ifdef INSTANCED
+// The instanced variant reads the object matrix from an instance attribute instead of a uniform
+layout(location = 4) in mat4 object_to_world;
+#else
+uniform mat4 object_to_world;
+#endif
+
+#include "frame-data.glsl"
+
+invariant gl_Position;
+
+void main(){
+    vec3 world = (object_to_world * vec4(position, 1.0)).xyz;
+    gl_Position = view_projection * vec4(world, 1.0);
+}
@@ -0,0 +1,28 @@
+// The data shared by all the draws of a frame (uploaded once per frame by the renderer)
+// It is declared once here and included by every shader that uses it, so its layout always matches the renderer
+#define MAX_DIRECTIONAL_LIGHT_COUNT 8
+
+struct Light {
+    vec3 color;
+    int type;
+    vec3 position;
+    float attenuation_constant;
+    vec3 direction;
+    float attenuation_linear;
+    float attenuation_quadratic;
+    float inner_angle, outer_angle;
+    float range;
+};
+
+layout(std140) uniform FrameData {
+    mat4 view_projection;
+    vec3 camera_position;
+    int directional_light_count;
+    vec3 camera_forward;
+    float cluster_depth_scale;
+    vec2 viewport_start;
+    vec2 cluster_tile_size;
+    float cluster_depth_bias;
+    int cluster_count_x, cluster_count_y, cluster_count_z;
+    Light directional_lights[MAX_DIRECTIONAL_LIGHT_COUNT];
+};
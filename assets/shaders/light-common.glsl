@@ -0,0 +1,65 @@
+// The lighting functions shared by the lit shaders (the Light struct and the directional lights come from frame-data.glsl)
+#include "frame-data.glsl"
+
+#define TYPE_DIRECTIONAL    0
+#define TYPE_POINT          1
+#define TYPE_SPOT           2
+
+// The point and spot lights are binned into clusters (a grid of cluster_count_x * cluster_count_y screen tiles by cluster_count_z depth slices)
+// light_clusters holds the (offset, count) of the list of each cluster in light_indices, and each light takes 4 texels of light_data
+uniform samplerBuffer light_data;
+uniform usamplerBuffer light_clusters;
+uniform usamplerBuffer light_indices;
+
+Light fetch_light(int index) {
+    vec4 texel0 = texelFetch(light_data, 4 * index);
+    vec4 texel1 = texelFetch(light_data, 4 * index + 1);
+    vec4 texel2 = texelFetch(light_data, 4 * index + 2);
+    vec4 texel3 = texelFetch(light_data, 4 * index + 3);
+    Light light;
+    light.color = texel0.rgb;
+    light.type = floatBitsToInt(texel0.a);
+    light.position = texel1.xyz;
+    light.attenuation_constant = texel1.w;
+    light.direction = texel2.xyz;
+    light.attenuation_linear = texel2.w;
+    light.attenuation_quadratic = texel3.x;
+    light.inner_angle = texel3.y;
+    light.outer_angle = texel3.z;
+    light.range = texel3.w;
+    return light;
+}
+
+// Returns the index of the cluster containing the current fragment (given its world position)
+int find_cluster(vec3 world) {
+    ivec2 tile = ivec2((gl_FragCoord.xy - viewport_start) / cluster_tile_size);
+    tile = clamp(tile, ivec2(0), ivec2(cluster_count_x - 1, cluster_count_y - 1));
+    float depth = max(dot(world - camera_position, camera_forward), 1e-6);
+    int slice = clamp(int(floor(log(depth) * cluster_depth_scale + cluster_depth_bias)), 0, cluster_count_z - 1);
+    return (slice * cluster_count_y + tile.y) * cluster_count_x + tile.x;
+}
+
+float attenuationOfOtherLightTypes(vec3 light_direction, Light light) {
+    float distance = length(light_direction); // get the length of the direction vector
+    light_direction /= distance; // normalize
+    float attenuation = 1.0f / (light.attenuation_constant +
+                light.attenuation_linear * distance +
+                light.attenuation_quadratic * distance * distance); // realistically 1/d^2 but we use linear and quadratic constants for better results
+    if(light.type == TYPE_SPOT){
+        float angle = acos(dot(light.direction, light_direction)); // get the angle with the light
+        attenuation *= smoothstep(light.outer_angle, light.inner_angle, angle); // attenuate smoothly between the angles
+    }
+    return attenuation;
+}
+
+vec3 calculateDiffuse(vec3 sampled_diffuse, vec3 normal, vec3 light_direction, vec3 light_color) {
+    float lambert = max(0.0f, dot(normal, -light_direction)); // as the angle increases between light direction and normal, the diffuse decreases
+    return sampled_diffuse * light_color * lambert;
+}
+
+vec3 calculateSpecular(vec3 normal, vec3 light_direction, vec3 view, float sampled_shininess,
+                       vec3 sampled_specular, vec3 light_color) {
+    vec3 reflected = reflect(light_direction, normal);
+    float phong = pow(max(0.0f, dot(view, reflected)), sampled_shininess); // as the angle increases between the vector towards our human eye and the reflected light direction, the specular decreases
+    return sampled_specular * light_color * phong;
+}
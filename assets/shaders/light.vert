@@ -5,10 +5,16 @@ layout(location = 1) in vec4 color;
 layout(location = 2) in vec2 tex_coord;
 layout(location = 3) in vec3 normal;
 
+#ifdef INSTANCED
+// The instanced variant reads the object matrices from instance attributes instead of uniforms
+layout(location = 4) in mat4 object_to_world;
+layout(location = 8) in mat3 object_to_world_inv_transpose;
+#else
 uniform mat4 object_to_world;
 uniform mat4 object_to_world_inv_transpose;
-uniform mat4 view_projection;
-uniform vec3 camera_position;
+#endif
+
+#include "frame-data.glsl"
 
 out Varyings {
    vec4 color;
@@ -18,11 +24,18 @@ out Varyings {
    vec3 normal;
 } vsout;
 
+// The depth pre-pass draws the opaque meshes with another shader then this one with an equal depth test, so both must give the same position
+invariant gl_Position;
+
 void main() {
    vsout.world = (object_to_world * vec4(position, 1.0f)).xyz;
    vsout.view = camera_position - vsout.world;
    // we use the inverse specifically to adjust normal in case of non-uniform scaling. If uniform it's equivalent to using the object to world without inverse
+#ifdef INSTANCED
+   vsout.normal = normalize(object_to_world_inv_transpose * normal);
+#else
    vsout.normal = normalize((object_to_world_inv_transpose * vec4(normal, 0.0f)).xyz);
+#endif
    gl_Position = view_projection * vec4(vsout.world, 1.0);
    vsout.color = color;
    vsout.tex_coord = tex_coord;
@@ -9,8 +9,13 @@ out vec4 frag_color;
 
 uniform vec4 tint;
 uniform sampler2D tex;
+uniform float alphaThreshold;
 
 void main(){
     // by multiplying the tint with the vertex color and with the texture color 
     frag_color = tint * fs_in.color * texture(tex, fs_in.tex_coord); // apply all of the color, the texture and the tint
+#ifdef ALPHA_TEST
+    // The variant with ALPHA_TEST is only used by the materials with an alpha threshold, so the others keep the early depth test
+    if(frag_color.a < alphaThreshold) discard;
+#endif
 }
\ No newline at end of file
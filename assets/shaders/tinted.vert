@@ -7,9 +7,21 @@ out Varyings {
     vec4 color;
 } vs_out;
 
-uniform mat4 transform;
+#ifdef INSTANCED
+// The instanced variant reads the object matrix from an instance attribute instead of a uniform
+layout(location = 4) in mat4 object_to_world;
+#else
+uniform mat4 object_to_world;
+#endif
+
+#include "frame-data.glsl"
+
+// The depth pre-pass draws the opaque meshes with another shader then this one with an equal depth test, so both must give the same position
+invariant gl_Position;
 
 void main(){
-    gl_Position = transform * vec4(position, 1.0);
+    // The position is computed exactly like in the other shaders, so the depth pre-pass gives the same depths (see depth.vert)
+    vec3 world = (object_to_world * vec4(position, 1.0)).xyz;
+    gl_Position = view_projection * vec4(world, 1.0);
     vs_out.color = color;
 }
\ No newline at end of file
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <limits>
+
+// The helpers shared by the benchmarks. Each benchmark compares an optimized path of the engine with a copy of the code
+// it replaced, checks that both give the same result and prints their timings. Build them in release for meaningful numbers
+// (e.g. "cmake -DCMAKE_BUILD_TYPE=Release") and run them from the root of the repository.
+namespace our::benchmark {
+
+    // Runs "function" "repeats" times and returns the time of the fastest run in milliseconds
+    // (the fastest run is the one least disturbed by the rest of the system)
+    template<typename Function>
+    double measure(int repeats, Function&& function) {
+        double best = std::numeric_limits<double>::max();
+        for(int repeat = 0; repeat < repeats; repeat++) {
+            auto start = std::chrono::steady_clock::now();
+            function();
+            std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+            best = std::min(best, elapsed.count());
+        }
+        return best;
+    }
+
+    // Prints the time of the reference and of the optimized path (and the time per item) followed by the speedup
+    inline void report(const char* reference, double referenceTime, const char* optimized, double optimizedTime, size_t itemCount) {
+        std::printf("%-28s %10.3f ms (%8.2f ns per item)\n", reference, referenceTime, referenceTime * 1e6 / double(itemCount));
+        std::printf("%-28s %10.3f ms (%8.2f ns per item)\n", optimized, optimizedTime, optimizedTime * 1e6 / double(itemCount));
+        std::printf("%-28s %10.2fx\n", "speedup", referenceTime / optimizedTime);
+    }
+
+    // Makes a computed value escape where the compiler can't see, so the work producing it isn't optimized away
+    template<typename T>
+    void keep(const T& value) {
+#if defined(__GNUC__) || defined(__clang__)
+        // The empty assembly statement claims to read the value, which the compiler can't check
+        asm volatile("" : : "g"(value) : "memory");
+#else
+        // The address of the value is published through a volatile pointer, then the compiler is stopped from reordering
+        static const T* volatile escaped;
+        escaped = &value;
+        std::atomic_signal_fence(std::memory_order_seq_cst);
+#endif
+    }
+
+}
@@ -0,0 +1,87 @@
+#include <ecs/world.hpp>
+#include <components/movement.hpp>
+#include <components/mesh-renderer.hpp>
+#include "benchmark.hpp"
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Compares Entity::getComponent (a column lookup in the archetype of the entity) with the lookup it replaced:
+// a map from the string ID of the component type to the component, followed by a dynamic_cast
+#define ENTITY_COUNT 100000
+#define REPEATS 20
+
+namespace {
+
+    // A copy of the component storage of the entities before the archetypes (kept as the reference)
+    struct LegacyEntity {
+        std::unordered_map<std::string, our::Component*> components;
+        // The components are owned through shared pointers created with their concrete type, so each one is deleted
+        // by the destructor of its type (Component has no virtual destructor)
+        std::vector<std::shared_ptr<our::Component>> owners;
+
+        template<typename T>
+        T* addComponent(){
+            auto component = std::make_shared<T>();
+            components[T::getID()] = component.get();
+            owners.push_back(component);
+            return component.get();
+        }
+
+        template<typename T>
+        T* getComponent(){
+            if(auto it = components.find(static_cast<std::string>(T::getID())); it != components.end()){
+                return dynamic_cast<T*>(it->second);
+            }
+            return nullptr;
+        }
+    };
+
+    // Looks up a component every entity has and a component half of them have (like a system filtering the entities)
+    template<typename EntityType>
+    float lookUpAll(const std::vector<EntityType*>& entities) {
+        float sum = 0.0f;
+        for(EntityType* entity : entities){
+            if(auto movement = entity->template getComponent<our::MovementComponent>()) sum += movement->linearVelocity.x;
+            if(auto meshRenderer = entity->template getComponent<our::MeshRendererComponent>()) sum += meshRenderer->radius;
+        }
+        return sum;
+    }
+
+}
+
+int main() {
+    our::World world;
+    std::vector<our::Entity*> entities;
+    std::vector<std::unique_ptr<LegacyEntity>> legacyOwners;
+    std::vector<LegacyEntity*> legacyEntities;
+    for(size_t index = 0; index < ENTITY_COUNT; index++){
+        our::Entity* entity = world.add();
+        legacyOwners.push_back(std::make_unique<LegacyEntity>());
+        LegacyEntity* legacy = legacyOwners.back().get();
+        float velocity = float(index % 7);
+        entity->addComponent<our::MovementComponent>()->linearVelocity.x = velocity;
+        legacy->addComponent<our::MovementComponent>()->linearVelocity.x = velocity;
+        if(index % 2 == 0){
+            entity->addComponent<our::MeshRendererComponent>()->radius = 2.0f;
+            legacy->addComponent<our::MeshRendererComponent>()->radius = 2.0f;
+        }
+        entities.push_back(entity);
+        legacyEntities.push_back(legacy);
+    }
+
+    float legacySum = 0.0f, sum = 0.0f;
+    double legacyTime = our::benchmark::measure(REPEATS, [&](){ legacySum = lookUpAll(legacyEntities); });
+    double time = our::benchmark::measure(REPEATS, [&](){ sum = lookUpAll(entities); });
+    our::benchmark::keep(legacySum + sum);
+
+    std::printf("%d entities, 2 lookups per entity\n", ENTITY_COUNT);
+    our::benchmark::report("string map + dynamic_cast", legacyTime, "archetype column", time, 2 * ENTITY_COUNT);
+    if(sum != legacySum){
+        std::printf("FAILED: the lookups found different components (%f != %f)\n", sum, legacySum);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,61 @@
+#include <systems/render-queue.hpp>
+#include "benchmark.hpp"
+
+#include <random>
+#include <vector>
+
+// Compares RenderQueue::sort (a radix sort of (key, index) pairs) with a std::sort of the commands on the same keys
+#define COMMAND_COUNT 100000
+#define REPEATS 20
+#define SHADER_COUNT 8
+#define MATERIAL_COUNT 200
+#define MESH_COUNT 300
+#define TRANSPARENT_RATIO 0.2f // The fraction of the commands that are transparent
+#define FAR 100.0f // The distance to the far plane of the camera
+
+int main() {
+    // The keys are built like the renderer builds them: a few shaders, many materials and meshes, most draws opaque
+    // in layer 0 and some overlays in the upper layers, each draw at a random depth in the view frustum
+    std::mt19937 generator(42);
+    std::uniform_int_distribution<std::uint32_t> shaderDistribution(0, SHADER_COUNT - 1);
+    std::uniform_int_distribution<std::uint32_t> materialDistribution(0, MATERIAL_COUNT - 1);
+    std::uniform_int_distribution<std::uint32_t> meshDistribution(0, MESH_COUNT - 1);
+    std::uniform_real_distribution<float> depthDistribution(0.1f, FAR);
+    std::uniform_real_distribution<float> unitDistribution(0.0f, 1.0f);
+    std::vector<our::RenderCommand> commands(COMMAND_COUNT);
+    for(our::RenderCommand& command : commands){
+        std::uint32_t layer = unitDistribution(generator) < 0.95f ? 0 : 1 + (generator() % 2);
+        std::uint32_t shader = shaderDistribution(generator), material = materialDistribution(generator);
+        float depth = depthDistribution(generator);
+        command.sortKey = unitDistribution(generator) < TRANSPARENT_RATIO ?
+            our::makeTransparentSortKey(layer, shader, material, depth) :
+            our::makeOpaqueSortKey(layer, shader, material, meshDistribution(generator), depth, FAR);
+    }
+
+    our::RenderQueue queue;
+    queue.reserve(COMMAND_COUNT);
+    queue.append(commands.begin(), commands.end());
+    std::vector<our::RenderCommand> sorted;
+
+    // Each run sorts a fresh copy of the unsorted commands, so the time of the copy alone is subtracted from the reference
+    double copyTime = our::benchmark::measure(REPEATS, [&](){ sorted = commands; });
+    double referenceTime = our::benchmark::measure(REPEATS, [&](){
+        sorted = commands;
+        std::sort(sorted.begin(), sorted.end(), [](const our::RenderCommand& first, const our::RenderCommand& second){
+            return first.sortKey < second.sortKey;
+        });
+    }) - copyTime;
+    double time = our::benchmark::measure(REPEATS, [&](){ queue.sort(); });
+    our::benchmark::keep(sorted.front().sortKey + queue[0].sortKey);
+
+    std::printf("%d commands (%d shaders, %d materials, %d meshes)\n", COMMAND_COUNT, SHADER_COUNT, MATERIAL_COUNT, MESH_COUNT);
+    our::benchmark::report("std::sort", referenceTime, "RenderQueue::sort", time, COMMAND_COUNT);
+    // std::sort isn't stable, so the commands with equal keys may be swapped: only the order of the keys is compared
+    for(size_t index = 0; index < COMMAND_COUNT; index++){
+        if(queue[index].sortKey != sorted[index].sortKey){
+            std::printf("FAILED: the sorts differ at the command %zu\n", index);
+            return 1;
+        }
+    }
+    return 0;
+}
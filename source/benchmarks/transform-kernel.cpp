@@ -0,0 +1,85 @@
+#include <ecs/transform-kernel.hpp>
+#include "benchmark.hpp"
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtx/euler_angles.hpp>
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+// Compares the transform kernel (quaternions, batched with SSE) with the code it replaced: a matrix built by
+// "Transform::toMat4" from glm::yawPitchRoll, followed by a general glm::inverse to get the normal matrix
+#define TRANSFORM_COUNT 100000
+#define REPEATS 20
+#define TOLERANCE 1e-4f // The maximum difference allowed between the elements of the matrices of both paths
+
+namespace {
+
+    // A copy of "Transform::toMat4" before the transform kernel (kept as the reference)
+    glm::mat4 legacyToMat4(const glm::vec3& position, const glm::vec3& rotation, const glm::vec3& scale) {
+        glm::highp_mat4 translation(glm::translate(glm::mat4(1.0f), position));
+        glm::highp_mat4 rotationMatrix(glm::yawPitchRoll(rotation.y, rotation.x, rotation.z));
+        glm::highp_mat4 scaling(glm::scale(glm::mat4(1.0f), scale));
+        return translation * rotationMatrix * scaling;
+    }
+
+    // Returns the largest absolute difference between the elements of two matrices
+    template<int C, int R>
+    float maxDifference(const glm::mat<C, R, float>& first, const glm::mat<C, R, float>& second) {
+        float difference = 0.0f;
+        for(int column = 0; column < C; column++)
+            for(int row = 0; row < R; row++)
+                difference = std::max(difference, std::abs(first[column][row] - second[column][row]));
+        return difference;
+    }
+
+}
+
+int main() {
+    // Random transforms like the ones of a scene (the scales are never zero, so every matrix is invertible)
+    std::mt19937 generator(42);
+    std::uniform_real_distribution<float> positionDistribution(-100.0f, 100.0f);
+    std::uniform_real_distribution<float> angleDistribution(-glm::pi<float>(), glm::pi<float>());
+    std::uniform_real_distribution<float> scaleDistribution(0.25f, 4.0f);
+    std::vector<glm::vec3> positions(TRANSFORM_COUNT), rotations(TRANSFORM_COUNT), scales(TRANSFORM_COUNT);
+    for(size_t index = 0; index < TRANSFORM_COUNT; index++){
+        positions[index] = { positionDistribution(generator), positionDistribution(generator), positionDistribution(generator) };
+        rotations[index] = { angleDistribution(generator), angleDistribution(generator), angleDistribution(generator) };
+        scales[index] = { scaleDistribution(generator), scaleDistribution(generator), scaleDistribution(generator) };
+    }
+
+    std::vector<glm::mat4> legacyMatrices(TRANSFORM_COUNT), matrices(TRANSFORM_COUNT);
+    std::vector<glm::mat3> legacyNormalMatrices(TRANSFORM_COUNT), normalMatrices(TRANSFORM_COUNT);
+    std::vector<glm::quat> quaternions(TRANSFORM_COUNT);
+
+    double legacyTime = our::benchmark::measure(REPEATS, [&](){
+        for(size_t index = 0; index < TRANSFORM_COUNT; index++){
+            legacyMatrices[index] = legacyToMat4(positions[index], rotations[index], scales[index]);
+            legacyNormalMatrices[index] = glm::mat3(glm::transpose(glm::inverse(legacyMatrices[index])));
+        }
+    });
+    // The euler angles are converted to quaternions like in "Transform::getRotationQuaternion"
+    double time = our::benchmark::measure(REPEATS, [&](){
+        for(size_t index = 0; index < TRANSFORM_COUNT; index++)
+            quaternions[index] = our::transform_kernel::eulerToQuaternion(rotations[index]);
+        our::transform_kernel::composeMatrices(TRANSFORM_COUNT, positions.data(), quaternions.data(), scales.data(), matrices.data());
+        our::transform_kernel::computeNormalMatrices(TRANSFORM_COUNT, matrices.data(), normalMatrices.data());
+    });
+    our::benchmark::keep(legacyMatrices.back()[3][0] + matrices.back()[3][0]);
+
+    float matrixError = 0.0f, normalMatrixError = 0.0f;
+    for(size_t index = 0; index < TRANSFORM_COUNT; index++){
+        matrixError = std::max(matrixError, maxDifference(legacyMatrices[index], matrices[index]));
+        normalMatrixError = std::max(normalMatrixError, maxDifference(legacyNormalMatrices[index], normalMatrices[index]));
+    }
+
+    std::printf("%d transforms, a matrix and a normal matrix per transform\n", TRANSFORM_COUNT);
+    our::benchmark::report("yawPitchRoll + glm::inverse", legacyTime, "transform kernel", time, TRANSFORM_COUNT);
+    std::printf("max error: %g (matrix), %g (normal matrix)\n", matrixError, normalMatrixError);
+    if(matrixError > TOLERANCE || normalMatrixError > TOLERANCE){
+        std::printf("FAILED: the error is above the tolerance (%g)\n", TOLERANCE);
+        return 1;
+    }
+    return 0;
+}
@@ -9,9 +9,14 @@
 #include <queue>
 #include <tuple>
 #include <filesystem>
+#include <vector>
+#include <algorithm>
+#include <numeric>
 
 #include <flags/flags.h>
 
+#include "shader/program-cache.hpp"
+
 // Include the Dear ImGui implementation headers
 #define IMGUI_IMPL_OPENGL_LOADER_GLAD2
 #include <imgui_impl/imgui_impl_glfw.h>
@@ -32,6 +37,15 @@ std::string default_screenshot_filepath() {
     return stream.str();
 }
 
+// Prints the average and the median of the measured frame times (in milliseconds)
+void print_frame_times(std::vector<double> frame_times, int warmup_frames) {
+    double average = std::accumulate(frame_times.begin(), frame_times.end(), 0.0) / double(frame_times.size());
+    std::nth_element(frame_times.begin(), frame_times.begin() + frame_times.size() / 2, frame_times.end());
+    double median = frame_times[frame_times.size() / 2];
+    std::cout << "Frame time      : " << std::fixed << std::setprecision(3) << average << " ms average, " << median << " ms median ("
+              << frame_times.size() << " frames after " << warmup_frames << " warm-up frames)" << std::endl;
+}
+
 // This function will be used to log errors thrown by GLFW
 void glfw_error_callback(int error, const char* description){
     std::cerr << "GLFW Error: " << error << ": " << description << std::endl;
@@ -183,6 +197,11 @@ int our::Application::run(int run_for_frames) {
     std::cout << "VERSION         : " << glGetString(GL_VERSION) << std::endl;
     std::cout << "GLSL VERSION    : " << glGetString(GL_SHADING_LANGUAGE_VERSION) << std::endl;
 
+    // Let the driver compile the shaders on as many threads as it wants (see ShaderProgram::beginLink)
+    if(GLAD_GL_KHR_parallel_shader_compile) glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+    // The linked programs are saved to (and loaded from) this directory, so only the first run compiles the shaders
+    program_cache::initialize(app_config.value("shader-cache", ""));
+
 #if defined(ENABLE_OPENGL_DEBUG_MESSAGES)
     // if we have OpenGL debug messages enabled, set the message callback
     glDebugMessageCallback(opengl_callback, nullptr);
@@ -225,11 +244,21 @@ int our::Application::run(int run_for_frames) {
         }
     }
 
+    // If "frame-timing" is in the config, the time of each frame after the warm-up frames is measured and
+    // the average and the median are printed when the application closes (useful to compare configurations with "-f")
+    bool time_frames = app_config.contains("frame-timing");
+    int warmup_frames = time_frames ? app_config["frame-timing"].value("warmup-frames", 10) : 0;
+    std::vector<double> frame_times;
+
     // If a scene change was requested, apply it
     if(nextState) {
         currentState = nextState;
         nextState = nullptr;
     }
+    // If "startup-timing" is true in the config, the time from here to the end of the first frame is printed
+    // It includes the loading of the assets of the first state (see "Assets loaded" in "deserializeAllAssets")
+    bool time_startup = app_config.value("startup-timing", false);
+    double initialize_start_time = glfwGetTime();
     // Call onInitialize if the scene needs to do some custom initialization (such as file loading, object creation, etc).
     if(currentState) currentState->onInitialize();
 
@@ -268,6 +297,10 @@ int our::Application::run(int run_for_frames) {
         // Call onDraw, in which we will draw the current frame, and send to it the time difference between the last and current frame
         if(currentState) currentState->onDraw(current_frame_time - last_frame_time);
         last_frame_time = current_frame_time; // Then update the last frame start time (this frame is now the last frame)
+        if(time_frames && current_frame >= warmup_frames){
+            glFinish(); // Wait for the GPU to finish the frame, so its rendering is included in the measured time
+            frame_times.push_back((glfwGetTime() - current_frame_time) * 1000.0);
+        }
 
 #if defined(ENABLE_OPENGL_DEBUG_MESSAGES)
         // Since ImGui causes many messages to be thrown, we are temporarily disabling the debug messages till we render the ImGui
@@ -305,6 +338,10 @@ int our::Application::run(int run_for_frames) {
 
         // Swap the frame buffers
         glfwSwapBuffers(window);
+        if(time_startup && current_frame == 0){
+            glFinish();
+            std::cout << "First frame     : " << (glfwGetTime() - initialize_start_time) * 1000.0 << " ms" << std::endl;
+        }
 
         // Update the keyboard and mouse data
         keyboard.update();
@@ -324,6 +361,8 @@ int our::Application::run(int run_for_frames) {
         ++current_frame;
     }
 
+    if(!frame_times.empty()) print_frame_times(frame_times, warmup_frames);
+
     // Call for cleaning up
     if(currentState) currentState->onDestroy();
 
@@ -8,37 +8,99 @@
 #include "mesh/mesh-utils.hpp"
 #include "material/material.hpp"
 #include "deserialize-utils.hpp"
+#include "shader/program-cache.hpp"
+
+#include <chrono>
+#include <iostream>
 
 namespace our {
 
     // Where we define all the asset maps since static member variables must be defined in a source file
-    std::unordered_map<std::string, ShaderProgram*> AssetLoader<ShaderProgram>::assets;
-    std::unordered_map<std::string, Texture2D*> AssetLoader<Texture2D>::assets;
-    std::unordered_map<std::string, Sampler*> AssetLoader<Sampler>::assets;
-    std::unordered_map<std::string, Mesh*> AssetLoader<Mesh>::assets;
-    std::unordered_map<std::string, Material*> AssetLoader<Material>::assets;
+    template<> std::unordered_map<std::string, ShaderProgram*> AssetLoader<ShaderProgram>::assets{};
+    template<> std::unordered_map<std::string, Texture2D*> AssetLoader<Texture2D>::assets{};
+    template<> std::unordered_map<std::string, Sampler*> AssetLoader<Sampler>::assets{};
+    template<> std::unordered_map<std::string, Mesh*> AssetLoader<Mesh>::assets{};
+    template<> std::unordered_map<std::string, Material*> AssetLoader<Material>::assets{};
+
+    // The descriptions of the loaded shaders, kept to build their variants
+    struct ShaderDescription {
+        std::string vsPath, fsPath;
+        ShaderDefines defines;
+    };
+    static std::unordered_map<std::string, ShaderDescription> shaderDescriptions;
+    // The variants whose link was started by "getShaderVariant" but not finished yet
+    static std::vector<ShaderProgram*> pendingShaderVariants;
+
+    // Reads the defines of a shader: either an array of names or an object of (name : value)
+    static ShaderDefines readShaderDefines(const nlohmann::json& data) {
+        ShaderDefines defines;
+        if(data.is_array()){
+            for(auto& name : data) defines[name.get<std::string>()] = "";
+        } else if(data.is_object()){
+            for(auto& [name, value] : data.items()) defines[name] = value.is_string() ? value.get<std::string>() : value.dump();
+        }
+        return defines;
+    }
 
     // This will load all the shaders defined in "data"
     // data must be in the form:
-    //    { shader_name : { "vs" : "path/to/vertex-shader", "fs" : "path/to/fragment-shader" }, ... }
-    void AssetLoader<ShaderProgram>::deserialize(const nlohmann::json& data) {
+    //    { shader_name : { "vs" : "path/to/vertex-shader", "fs" : "path/to/fragment-shader", "defines" : defines }, ... }
+    // Where "defines" (optional) is read by "readShaderDefines" and is added to both stages
+    template<> void AssetLoader<ShaderProgram>::deserialize(const nlohmann::json& data) {
         if(data.is_object()){
+            // All the links are started before any is finished, so the driver can build the programs in parallel
+            std::vector<ShaderProgram*> shaders;
             for(auto& [name, desc] : data.items()){
-                std::string vsPath = desc.value("vs", "");
-                std::string fsPath = desc.value("fs", "");
+                ShaderDescription& description = shaderDescriptions[name];
+                description.vsPath = desc.value("vs", "");
+                description.fsPath = desc.value("fs", "");
+                description.defines = readShaderDefines(desc.value("defines", nlohmann::json()));
                 auto shader = new ShaderProgram();
-                shader->attach(vsPath, GL_VERTEX_SHADER);
-                shader->attach(fsPath, GL_FRAGMENT_SHADER);
-                shader->link();
+                shader->attach(description.vsPath, GL_VERTEX_SHADER, description.defines);
+                shader->attach(description.fsPath, GL_FRAGMENT_SHADER, description.defines);
+                shader->beginLink();
+                shaders.push_back(shader);
                 assets[name] = shader;
             }
+            for(auto shader : shaders) shader->finishLink();
         }
     };
 
+    ShaderProgram* getShaderVariant(const std::string& name, const ShaderDefines& defines) {
+        if(defines.empty()) return AssetLoader<ShaderProgram>::get(name);
+        auto it = shaderDescriptions.find(name);
+        if(it == shaderDescriptions.end()) return nullptr;
+
+        // The variant is stored with the other shaders under a name made of the shader name and its defines
+        std::string variantName = name + "[";
+        for(auto& [define, value] : defines) {
+            if(variantName.back() != '[') variantName += ",";
+            variantName += value.empty() ? define : define + "=" + value;
+        }
+        variantName += "]";
+        if(auto variant = AssetLoader<ShaderProgram>::get(variantName)) return variant;
+
+        const ShaderDescription& description = it->second;
+        ShaderDefines variantDefines = description.defines;
+        for(auto& [define, value] : defines) variantDefines[define] = value;
+        auto variant = new ShaderProgram();
+        variant->attach(description.vsPath, GL_VERTEX_SHADER, variantDefines);
+        variant->attach(description.fsPath, GL_FRAGMENT_SHADER, variantDefines);
+        variant->beginLink();
+        pendingShaderVariants.push_back(variant);
+        AssetLoader<ShaderProgram>::add(variantName, variant);
+        return variant;
+    }
+
+    void finishShaderVariants() {
+        for(auto variant : pendingShaderVariants) variant->finishLink();
+        pendingShaderVariants.clear();
+    }
+
     // This will load all the textures defined in "data"
     // data must be in the form:
     //    { texture_name : "path/to/image", ... }
-    void AssetLoader<Texture2D>::deserialize(const nlohmann::json& data) {
+    template<> void AssetLoader<Texture2D>::deserialize(const nlohmann::json& data) {
         if(data.is_object()){
             for(auto& [name, desc] : data.items()){
                 std::string path = desc.get<std::string>();
@@ -56,7 +118,7 @@ namespace our {
     //      The key is the parameter name, e.g. "MAG_FILTER", "MIN_FILTER", "WRAP_S", "WRAP_T" or "MAX_ANISOTROPY"
     //      The value is the parameter value, e.g. "GL_NEAREST", "GL_REPEAT"
     //  For "MAX_ANISOTROPY", the value must be a float with a value >= 1.0f
-    void AssetLoader<Sampler>::deserialize(const nlohmann::json& data) {
+    template<> void AssetLoader<Sampler>::deserialize(const nlohmann::json& data) {
         if(data.is_object()){
             for(auto& [name, desc] : data.items()){
                 auto sampler = new Sampler();
@@ -69,11 +131,19 @@ namespace our {
     // This will load all the meshes defined in "data"
     // data must be in the form:
     //    { mesh_name : "path/to/3d-model-file", ... }
-    void AssetLoader<Mesh>::deserialize(const nlohmann::json& data) {
+    // or, to choose the number of simplified LODs generated for the mesh (MESH_LOD_DEFAULT_COUNT otherwise, 0 for none)
+    // and the format of its vertices ("float" by default, "packed" or "quantized", see VertexFormat):
+    //    { mesh_name : { "path" : "path/to/3d-model-file", "lods" : count, "vertexFormat" : format }, ... }
+    template<> void AssetLoader<Mesh>::deserialize(const nlohmann::json& data) {
         if(data.is_object()){
             for(auto& [name, desc] : data.items()){
-                std::string path = desc.get<std::string>();
-                auto mesh = mesh_utils::loadOBJ(path.c_str());
+                std::string path = desc.is_object() ? desc.value("path", "") : desc.get<std::string>();
+                int lodCount = desc.is_object() ? desc.value("lods", MESH_LOD_DEFAULT_COUNT) : MESH_LOD_DEFAULT_COUNT;
+                std::string formatName = desc.is_object() ? desc.value("vertexFormat", "float") : "float";
+                VertexFormat format = VertexFormat::FLOAT;
+                if(formatName == "packed") format = VertexFormat::PACKED;
+                else if(formatName == "quantized") format = VertexFormat::QUANTIZED;
+                auto mesh = mesh_utils::loadOBJ(path.c_str(), lodCount, format);
                 assets[name] = mesh;
             }
         }
@@ -91,7 +161,7 @@ namespace our {
     //      "pipelineState" (optional) where the value is a json object that can be read by "PipelineState::deserialize"
     //      "transparent" (optional, default=false) where the value is a boolean indicating whether the material is transparent or not
     //      ... more keys/values can be added depending on the material type (e.g. "texture", "sampler", "tint")
-    void AssetLoader<Material>::deserialize(const nlohmann::json& data) {
+    template<> void AssetLoader<Material>::deserialize(const nlohmann::json& data) {
         if(data.is_object()){
             for(auto& [name, desc] : data.items()){
                 std::string type = desc.value("type", "");
@@ -99,25 +169,49 @@ namespace our {
                 material->deserialize(desc);
                 assets[name] = material;
             }
+            // The shader variants requested by the materials were compiled together
+            finishShaderVariants();
         }
     };
 
-    void deserializeAllAssets(const nlohmann::json& assetData){
+    // Returns the milliseconds elapsed since "start"
+    static double millisecondsSince(std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    void deserializeAllAssets(const nlohmann::json& assetData, bool logTiming){
         if(!assetData.is_object()) return;
-        if(assetData.contains("shaders"))
+        // The time spent on the shaders (and on the shader variants, which are linked by the material loader) is logged
+        // with the number of programs that came from the program cache, to compare a cold cache with a warm one
+        auto start = std::chrono::steady_clock::now();
+        program_cache::Statistics before = program_cache::getStatistics();
+        double shaderTime = 0, materialTime = 0;
+        if(assetData.contains("shaders")){
+            auto shaderStart = std::chrono::steady_clock::now();
             AssetLoader<ShaderProgram>::deserialize(assetData["shaders"]);
+            shaderTime = millisecondsSince(shaderStart);
+        }
         if(assetData.contains("textures"))
             AssetLoader<Texture2D>::deserialize(assetData["textures"]);
         if(assetData.contains("samplers"))
             AssetLoader<Sampler>::deserialize(assetData["samplers"]);
         if(assetData.contains("meshes"))
             AssetLoader<Mesh>::deserialize(assetData["meshes"]);
-        if(assetData.contains("materials"))
+        if(assetData.contains("materials")){
+            auto materialStart = std::chrono::steady_clock::now();
             AssetLoader<Material>::deserialize(assetData["materials"]);
+            materialTime = millisecondsSince(materialStart);
+        }
+        if(!logTiming) return;
+        const program_cache::Statistics& after = program_cache::getStatistics();
+        std::cout << "Assets loaded   : " << millisecondsSince(start) << " ms (shaders: " << shaderTime
+                  << " ms, materials and shader variants: " << materialTime << " ms, programs: "
+                  << after.loaded - before.loaded << " from the cache, " << after.built - before.built << " built)" << std::endl;
     }
 
     void clearAllAssets(){
         AssetLoader<ShaderProgram>::clear();
+        shaderDescriptions.clear();
         AssetLoader<Texture2D>::clear();
         AssetLoader<Sampler>::clear();
         AssetLoader<Mesh>::clear();
@@ -5,6 +5,9 @@
 #include <json/json.hpp>
 #include <glm/glm.hpp>
 
+#include "shader/shader-preprocessor.hpp"
+#include "texture/texture2d.hpp"
+
 namespace our {
 
     // This static template class will hold the loaded assets
@@ -56,6 +59,11 @@ namespace our {
         }
 
 
+        // This function adds an asset with the given name. The asset loader takes its ownership (it is deleted by "clear")
+        static void add(const std::string& name, T* asset) {
+            assets[name] = asset;
+        }
+
         // This function deletes all the assets held by this class and clear the assets map 
         static void clear(){
             for(auto& [name, asset] : assets){
@@ -69,7 +77,16 @@ namespace our {
     // This function will call "AssetLoader<T>::deserialize" for all the different asset types T
     // For example, a json in the form {"shaders": ... , "textures": ... } will call "deserialize" for:
     // AssetLoader<ShaderProgram> and AssetLoader<Texture2D>
-    void deserializeAllAssets(const nlohmann::json& assetData);
+    // If "logTiming" is true, the loading time and the number of shader programs that came from the program cache are printed
+    void deserializeAllAssets(const nlohmann::json& assetData, bool logTiming = false);
     // This will call "AssetLoader<T>::clear" for all the different asset types T
     void clearAllAssets();
+
+    class ShaderProgram;
+    // Returns the variant of the loaded shader "name" built with the given defines added to its own (the shader itself if
+    // there are none), or nullptr if there is no such shader. Each variant is built once and stored with the other shaders,
+    // so the materials asking for the same variant share it. The link of a new variant is only started: it is finished by
+    // "finishShaderVariants", which the material loader calls once all its materials asked for their variants
+    ShaderProgram* getShaderVariant(const std::string& name, const ShaderDefines& defines);
+    void finishShaderVariants();
 }
\ No newline at end of file
@@ -3,6 +3,9 @@
 #include "../deserialize-utils.hpp"
 #include "../asset-loader.hpp"
 
+#include <algorithm>
+#include <cmath>
+
 void our::LightComponent::deserialize(const nlohmann::json& data)
 {
     if (!data.is_object()) return;
@@ -26,4 +29,20 @@ void our::LightComponent::deserialize(const nlohmann::json& data)
     ambient = data.value("ambient",ambient);
     diffuse = data.value("diffuse",diffuse);
     specular = data.value("specular",specular);
+    range = data.value("range", range);
+}
+
+float our::LightComponent::getRange() const
+{
+    if (range > 0) return range;
+    float intensity = std::max(color.r, std::max(color.g, color.b));
+    if (intensity <= 0) return 0;
+    // Find the distance d at which "intensity / (constant + linear * d + quadratic * d^2)" drops to LIGHT_RANGE_CUTOFF
+    float constant = attenuation.x - intensity / LIGHT_RANGE_CUTOFF;
+    if (attenuation.z > 0) {
+        float discriminant = attenuation.y * attenuation.y - 4 * attenuation.z * constant;
+        return (-attenuation.y + std::sqrt(std::max(discriminant, 0.0f))) / (2 * attenuation.z);
+    }
+    if (attenuation.y > 0) return std::max(-constant / attenuation.y, 0.0f);
+    return INFINITY;
 }
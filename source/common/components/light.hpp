@@ -5,6 +5,9 @@
 #include <glm/mat4x4.hpp>
 #include "../shader/shader.hpp"
 
+// A point or spot light is ignored where it lights a surface with less than this fraction of a fully lit color channel
+#define LIGHT_RANGE_CUTOFF (1.0f / 256.0f)
+
 namespace our {
 
     // An enum that defines the type of the light 
@@ -25,10 +28,15 @@ namespace our {
         glm::vec3 diffuse = { 0, 0, 0 };
         glm::vec3 specular = { 0, 0, 0 };
         glm::vec2 coneAngles = { 0, 0 }; // for spot light
+        float range = 0; // for spot and point light types: the distance beyond which the light is ignored (if 0, it is computed from the attenuation)
 
         static std::string getID() { return "Light"; }
 
         void deserialize(const nlohmann::json& data) override;
+
+        // Returns the distance beyond which a point or spot light can be ignored
+        // It is infinite if the light has no attenuation (and no explicit range)
+        float getRange() const;
     };
 
 }
\ No newline at end of file
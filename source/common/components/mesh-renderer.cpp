@@ -8,6 +8,8 @@ namespace our {
         // Notice how we just get a string from the json file and pass it to the AssetLoader to get us the actual asset
         mesh = AssetLoader<Mesh>::get(data["mesh"].get<std::string>());
         material = AssetLoader<Material>::get(data["material"].get<std::string>());
+        layer = data.value<std::uint32_t>("layer", 0);
+        occluder = data.value<bool>("occluder", false);
         player = data.value<bool>("player", false);
         obstacle = data.value<bool>("obstacle", false);
         radius = data.value<float>("radius", 1.0f);
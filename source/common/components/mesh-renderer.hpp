@@ -12,6 +12,9 @@ namespace our {
     public:
         Mesh* mesh; // The mesh that should be drawn
         Material* material; // The material used to draw the mesh
+        std::uint32_t layer = 0; // The layers are drawn in increasing order (from 0 to RENDER_LAYER_COUNT - 1), for example to draw overlays last
+        bool occluder = false; // If true, the mesh hides the objects behind it during the occlusion culling (only for big opaque meshes)
+        std::uint8_t lodLevel = 0; // The level of detail of the mesh drawn in the last frame (see LODSelector)
         bool player = false;
         bool obstacle = false;
         float radius = 1.0f;
@@ -0,0 +1,162 @@
+#include "archetype.hpp"
+#include "entity.hpp"
+
+namespace our {
+
+    // Appends a row for the given entity (whose components were already pushed to the columns) and returns its index
+    size_t Archetype::pushRow(Entity* entity, bool marked) {
+        entities.push_back(entity);
+        size_t row = entities.size() - 1;
+        entity->row = row;
+        if(!marked) {
+            // Move the new row to the end of the live range
+            swapRows(row, liveCount);
+            row = liveCount++;
+        }
+        return row;
+    }
+
+    // Destroys the components at the given row and fills the hole by moving the rows around
+    void Archetype::removeRow(size_t row) {
+        // A live row is first moved to the marked range so that the live range stays contiguous
+        if(!isMarked(row)) row = markRow(row);
+        swapRows(row, entities.size() - 1);
+        for(auto& column : columns) {
+            if(column) column->popBack();
+        }
+        entities.pop_back();
+    }
+
+    // Moves the given row to the range of rows marked for removal and returns its new index
+    size_t Archetype::markRow(size_t row) {
+        if(isMarked(row)) return row;
+        swapRows(row, --liveCount);
+        return liveCount;
+    }
+
+    // Swaps two rows (both the components and the owning entities)
+    void Archetype::swapRows(size_t first, size_t second) {
+        if(first == second) return;
+        for(auto& column : columns) {
+            if(column) column->swapRows(first, second);
+        }
+        std::swap(entities[first], entities[second]);
+        entities[first]->row = first;
+        entities[second]->row = second;
+    }
+
+    // Moves the components of the given row to the target archetype and removes the row from this archetype
+    size_t Archetype::moveRowTo(size_t row, Archetype* target) {
+        Entity* entity = entities[row];
+        bool marked = isMarked(row);
+        for(ComponentTypeID type = 0; type < MAX_COMPONENT_TYPES; ++type) {
+            auto& targetColumn = target->columns[type];
+            if(!targetColumn) continue;
+            if(auto& column = columns[type]; column) {
+                targetColumn->pushMovedFrom(*column, row);
+            } else {
+                targetColumn->pushDefault();
+            }
+        }
+        removeRow(row);
+        return target->pushRow(entity, marked);
+    }
+
+    // Appends a row for the given entity holding a copy of the components at the given row of "source"
+    size_t Archetype::pushCopyOf(Entity* entity, const Archetype& source, size_t row) {
+        for(ComponentTypeID type = 0; type < MAX_COMPONENT_TYPES; ++type) {
+            if(auto& column = columns[type]; column) column->pushCopiedFrom(*source.columns[type], row);
+        }
+        return pushRow(entity);
+    }
+
+    ArchetypeStorage::ArchetypeStorage() {
+        emptyArchetype = getOrCreate(ComponentMask(), nullptr, 0, nullptr);
+    }
+
+    // Returns the archetype with the given mask, creating it if it doesn't exist yet
+    Archetype* ArchetypeStorage::getOrCreate(ComponentMask mask, const Archetype* source, ComponentTypeID newType, const ComponentColumnType* newColumnType) {
+        if(auto it = archetypes.find(mask); it != archetypes.end()) {
+            return it->second.get();
+        }
+        Archetype* archetype = new Archetype(this, mask);
+        if(source) {
+            for(ComponentTypeID type = 0; type < MAX_COMPONENT_TYPES; ++type) {
+                if(mask.test(type) && source->columns[type]) {
+                    archetype->columns[type].reset(createColumn(type, source->columns[type]->getType()));
+                }
+            }
+        }
+        if(newColumnType) archetype->columns[newType].reset(createColumn(newType, *newColumnType));
+        archetypes[mask].reset(archetype);
+        archetypeList.push_back(archetype);
+        // Add the new archetype to every cached query that it matches
+        for(auto& [queryMask, query] : queries) {
+            if((mask & queryMask) == queryMask) query->matches.push_back(archetype);
+        }
+        return archetype;
+    }
+
+    // Creates an empty column of the given type backed by the pool of this type
+    ComponentColumn* ArchetypeStorage::createColumn(ComponentTypeID type, const ComponentColumnType& columnType) {
+        auto& pool = pools[type];
+        if(!pool) pool = std::make_unique<ComponentBlockPool>(columnType.blockSize, columnType.blockAlignment);
+        return columnType.createColumn(pool.get());
+    }
+
+    // Returns the cached query for the given mask, creating it if it doesn't exist yet
+    const ArchetypeQuery* ArchetypeStorage::getQuery(ComponentMask mask) {
+        auto& query = queries[mask];
+        if(!query) {
+            query = std::make_unique<ArchetypeQuery>();
+            query->mask = mask;
+            for(Archetype* archetype : archetypeList) {
+                if((archetype->getMask() & mask) == mask) query->matches.push_back(archetype);
+            }
+        }
+        return query.get();
+    }
+
+    // Returns the archetype with the component types of "source" plus the given type
+    Archetype* ArchetypeStorage::getWithComponent(Archetype* source, ComponentTypeID type, const ComponentColumnType& columnType) {
+        if(Archetype* cached = source->addEdges[type]; cached) return cached;
+        ComponentMask mask = source->mask;
+        mask.set(type);
+        Archetype* target = getOrCreate(mask, source, type, &columnType);
+        source->addEdges[type] = target;
+        target->removeEdges[type] = source;
+        return target;
+    }
+
+    // Returns the archetype with the component types of "source" minus the given type
+    Archetype* ArchetypeStorage::getWithoutComponent(Archetype* source, ComponentTypeID type) {
+        if(Archetype* cached = source->removeEdges[type]; cached) return cached;
+        ComponentMask mask = source->mask;
+        mask.reset(type);
+        Archetype* target = getOrCreate(mask, source, 0, nullptr);
+        source->removeEdges[type] = target;
+        target->addEdges[type] = source;
+        return target;
+    }
+
+    // Returns the archetype of this storage that has the same component types as "prototype"
+    Archetype* ArchetypeStorage::getMatching(const Archetype* prototype) {
+        return getOrCreate(prototype->mask, prototype, 0, nullptr);
+    }
+
+    // Returns the counters of the pool holding the given component type
+    ComponentPoolStats ArchetypeStorage::getPoolStats(ComponentTypeID type) const {
+        if(const auto& pool = pools[type]; pool) return pool->getStats();
+        return ComponentPoolStats();
+    }
+
+    // Returns the sum of the counters of all the pools
+    ComponentPoolStats ArchetypeStorage::getPoolStats() const {
+        ComponentPoolStats total;
+        for(const auto& pool : pools) {
+            if(pool) total += pool->getStats();
+        }
+        return total;
+    }
+
+}
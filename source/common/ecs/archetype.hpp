@@ -0,0 +1,266 @@
+#pragma once
+
+#include "component.hpp"
+#include "component-type.hpp"
+#include "component-pool.hpp"
+
+#include <array>
+#include <memory>
+#include <new>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace our {
+
+    class Entity; // A forward declaration of the Entity Class
+    class ArchetypeStorage; // A forward declaration of the ArchetypeStorage Class
+
+    // The number of components in each chunk of a component column (must be a power of 2)
+    #define COMPONENT_CHUNK_SIZE 256
+
+    struct ComponentColumnType; // A forward declaration of the ComponentColumnType Struct
+
+    // A column stores all the components of a single type inside an archetype.
+    // Row i of every column in an archetype belongs to the same entity (structure of arrays).
+    // This is the type-erased interface which the archetype uses to move rows around without knowing the component types.
+    class ComponentColumn {
+    public:
+        virtual ~ComponentColumn() = default;
+        // Returns the component at the given row
+        virtual Component* at(size_t row) = 0;
+        // Appends a default constructed component to the end of the column
+        virtual void pushDefault() = 0;
+        // Appends a component moved from the given row of another column holding the same component type
+        virtual void pushMovedFrom(ComponentColumn& source, size_t row) = 0;
+        // Appends a copy of the component at the given row of another column holding the same component type
+        virtual void pushCopiedFrom(const ComponentColumn& source, size_t row) = 0;
+        // Destroys the last component of the column
+        virtual void popBack() = 0;
+        // Swaps the components at the two given rows
+        virtual void swapRows(size_t first, size_t second) = 0;
+        // Returns the description of the component type held by this column (used to create other columns of the same type)
+        virtual const ComponentColumnType& getType() const = 0;
+    };
+
+    // Describes how to create the columns of a component type and the pool that backs them
+    struct ComponentColumnType {
+        size_t blockSize; // The size of a chunk of components in bytes
+        size_t blockAlignment; // The alignment of a chunk of components in bytes
+        ComponentColumn* (*createColumn)(ComponentBlockPool* pool); // Creates an empty column that takes its chunks from the given pool
+    };
+
+    // A column holding components of type T.
+    // The components are stored contiguously in fixed size chunks, so appending a component never moves the components
+    // that are already stored (pointers returned by "get" stay valid until their row is removed or swapped).
+    // The chunks come from the pool shared by all the columns of type T, so moving entities between archetypes
+    // recycles memory instead of allocating it.
+    template<typename T>
+    class TypedComponentColumn : public ComponentColumn {
+        ComponentBlockPool* pool; // The pool from which the chunks are acquired
+        std::vector<T*> chunks; // Each chunk is an uninitialized array of COMPONENT_CHUNK_SIZE components
+        size_t count = 0; // The number of constructed components in the column
+
+        // Returns the address at which the next component should be constructed, acquiring a new chunk if needed
+        T* reserve() {
+            if(count == chunks.size() * COMPONENT_CHUNK_SIZE) {
+                chunks.push_back(static_cast<T*>(pool->acquire()));
+            }
+            return get(count);
+        }
+    public:
+        static_assert((COMPONENT_CHUNK_SIZE & (COMPONENT_CHUNK_SIZE - 1)) == 0, "COMPONENT_CHUNK_SIZE must be a power of 2");
+
+        explicit TypedComponentColumn(ComponentBlockPool* pool) : pool(pool) {}
+
+        // Destroys all the components then gives the chunks back to the pool
+        ~TypedComponentColumn() override {
+            for(size_t row = 0; row < count; ++row) get(row)->~T();
+            for(T* chunk : chunks) pool->release(chunk);
+        }
+
+        // Returns the number of components in the column
+        size_t size() const { return count; }
+
+        // Returns the component at the given row without going through a virtual call
+        T* get(size_t row) {
+            return chunks[row / COMPONENT_CHUNK_SIZE] + (row % COMPONENT_CHUNK_SIZE);
+        }
+        const T* get(size_t row) const {
+            return chunks[row / COMPONENT_CHUNK_SIZE] + (row % COMPONENT_CHUNK_SIZE);
+        }
+
+        Component* at(size_t row) override { return get(row); }
+
+        void pushDefault() override {
+            new (reserve()) T();
+            ++count;
+        }
+
+        void pushMovedFrom(ComponentColumn& source, size_t row) override {
+            T* component = static_cast<TypedComponentColumn<T>&>(source).get(row);
+            new (reserve()) T(std::move(*component));
+            ++count;
+        }
+
+        void pushCopiedFrom(const ComponentColumn& source, size_t row) override {
+            const T* component = static_cast<const TypedComponentColumn<T>&>(source).get(row);
+            new (reserve()) T(*component);
+            ++count;
+        }
+
+        void popBack() override {
+            get(count - 1)->~T();
+            --count;
+            // Keep at most one empty chunk so that a row added and removed at a chunk boundary doesn't go back and forth to the pool
+            if(count + 2 * COMPONENT_CHUNK_SIZE <= chunks.size() * COMPONENT_CHUNK_SIZE) {
+                pool->release(chunks.back());
+                chunks.pop_back();
+            }
+        }
+
+        void swapRows(size_t first, size_t second) override {
+            if(first != second) std::swap(*get(first), *get(second));
+        }
+
+        // Used by the archetype storage to create the columns of type T
+        static ComponentColumn* createColumn(ComponentBlockPool* pool) { return new TypedComponentColumn<T>(pool); }
+
+        // Describes the columns of type T to the archetype storage
+        static constexpr ComponentColumnType columnType = { sizeof(T) * COMPONENT_CHUNK_SIZE, alignof(T), &createColumn };
+
+        const ComponentColumnType& getType() const override { return columnType; }
+
+        TypedComponentColumn(const TypedComponentColumn&) = delete;
+        TypedComponentColumn& operator=(const TypedComponentColumn&) = delete;
+    };
+
+    // An archetype holds all the entities that have exactly the same set of component types.
+    // The components are stored in one column per component type, so systems can walk the components of many entities
+    // in packed arrays instead of following a pointer per entity.
+    // The rows are split into two ranges: [0, liveCount) holds the live entities and [liveCount, size) holds the entities
+    // that were marked for removal. Views only visit the live range, so a marked entity stops being visited immediately.
+    class Archetype {
+        ArchetypeStorage* storage; // The storage that owns this archetype
+        ComponentMask mask; // The set of component types held by the entities of this archetype
+        std::array<std::unique_ptr<ComponentColumn>, MAX_COMPONENT_TYPES> columns; // Indexed by the component type ID (null if the type is absent)
+        std::vector<Entity*> entities; // The entity that owns each row
+        size_t liveCount = 0; // The number of rows that are not marked for removal
+
+        // Cached transitions to the archetypes that have one more (or one less) component type than this archetype
+        std::array<Archetype*, MAX_COMPONENT_TYPES> addEdges{};
+        std::array<Archetype*, MAX_COMPONENT_TYPES> removeEdges{};
+
+        friend ArchetypeStorage;
+        Archetype(ArchetypeStorage* storage, ComponentMask mask) : storage(storage), mask(mask) {}
+    public:
+        ArchetypeStorage* getStorage() const { return storage; }
+        const ComponentMask& getMask() const { return mask; }
+
+        // Returns the number of entities (rows) in this archetype including the ones marked for removal
+        size_t size() const { return entities.size(); }
+
+        // Returns the number of entities that are not marked for removal (they occupy the rows [0, getLiveCount()))
+        size_t getLiveCount() const { return liveCount; }
+
+        // Returns true if the given row belongs to an entity that was marked for removal
+        bool isMarked(size_t row) const { return row >= liveCount; }
+
+        // Returns the entity that owns the given row
+        Entity* getEntity(size_t row) const { return entities[row]; }
+
+        // Returns the column holding the components of type T, or a nullptr if this archetype does not contain T
+        template<typename T>
+        TypedComponentColumn<T>* getColumn() const {
+            return static_cast<TypedComponentColumn<T>*>(columns[componentTypeID<T>].get());
+        }
+
+        // Returns the type-erased column holding the components of the given type, or a nullptr if this archetype does not contain it
+        ComponentColumn* getColumn(ComponentTypeID type) const { return columns[type].get(); }
+
+        // Appends a row for the given entity and returns its index.
+        // The caller is responsible for pushing a component into every column of this archetype before calling this function.
+        // If "marked" is false, the row is placed at the end of the live range.
+        size_t pushRow(Entity* entity, bool marked = false);
+
+        // Destroys the components at the given row and fills the hole by moving the rows around
+        void removeRow(size_t row);
+
+        // Moves the given row to the range of rows marked for removal and returns its new index
+        size_t markRow(size_t row);
+
+        // Swaps two rows (both the components and the owning entities)
+        void swapRows(size_t first, size_t second);
+
+        // Moves the components of the given row to the target archetype and removes the row from this archetype.
+        // Components that do not exist in the target are destroyed and components that do not exist in this archetype are default constructed.
+        // Returns the index of the new row in the target archetype.
+        size_t moveRowTo(size_t row, Archetype* target);
+
+        // Appends a row for the given entity holding a copy of the components at the given row of "source".
+        // "source" must have the same component types as this archetype, but it may belong to another storage.
+        // Returns the index of the new row.
+        size_t pushCopyOf(Entity* entity, const Archetype& source, size_t row);
+
+        Archetype(const Archetype&) = delete;
+        Archetype& operator=(const Archetype&) = delete;
+    };
+
+    // A query caches the list of archetypes that contain all the component types in its mask.
+    // Since an entity changes its archetype whenever a component is added or deleted, the query never has to track entities.
+    // It is only updated when a new archetype is created, which stops happening once the scene has been loaded.
+    struct ArchetypeQuery {
+        ComponentMask mask; // The component types required by the query
+        std::vector<Archetype*> matches; // The archetypes that contain all the required component types
+    };
+
+    // This class owns all the archetypes of a world and creates them on demand
+    // It also owns one block pool per component type from which the component columns take their chunks
+    class ArchetypeStorage {
+        // The pools are declared before the archetypes so that they are destroyed after the columns release their chunks
+        std::array<std::unique_ptr<ComponentBlockPool>, MAX_COMPONENT_TYPES> pools; // Indexed by the component type ID (created on demand)
+        std::unordered_map<ComponentMask, std::unique_ptr<Archetype>> archetypes; // The archetypes keyed by their component mask
+        std::vector<Archetype*> archetypeList; // The archetypes in their creation order (used for iteration)
+        Archetype* emptyArchetype; // The archetype of the entities that have no components
+        std::unordered_map<ComponentMask, std::unique_ptr<ArchetypeQuery>> queries; // The cached queries keyed by their mask
+
+        // Returns the archetype with the given mask. If it doesn't exist yet, it is created with columns created
+        // by cloning the columns of "source" in addition to the column described by "newColumnType" (if not null)
+        Archetype* getOrCreate(ComponentMask mask, const Archetype* source, ComponentTypeID newType, const ComponentColumnType* newColumnType);
+
+        // Creates an empty column of the given type that takes its chunks from the pool of this type (creating the pool if needed)
+        ComponentColumn* createColumn(ComponentTypeID type, const ComponentColumnType& columnType);
+    public:
+        ArchetypeStorage();
+
+        // Returns the archetype that holds entities without any components
+        Archetype* getEmpty() const { return emptyArchetype; }
+
+        // Returns the archetype with the component types of "source" plus the given type
+        // "columnType" is used to create the column of the new component type if the archetype has to be created
+        Archetype* getWithComponent(Archetype* source, ComponentTypeID type, const ComponentColumnType& columnType);
+
+        // Returns the archetype with the component types of "source" minus the given type
+        Archetype* getWithoutComponent(Archetype* source, ComponentTypeID type);
+
+        // Returns the archetype of this storage that has the same component types as "prototype" (which may belong to another storage)
+        Archetype* getMatching(const Archetype* prototype);
+
+        // Returns all the archetypes in their creation order
+        const std::vector<Archetype*>& getArchetypes() const { return archetypeList; }
+
+        // Returns the cached query for the given mask, creating it if it doesn't exist yet
+        // The returned pointer stays valid as long as this storage exists
+        const ArchetypeQuery* getQuery(ComponentMask mask);
+
+        // Returns the counters of the pool holding the given component type (all zeros if no component of this type was ever added)
+        ComponentPoolStats getPoolStats(ComponentTypeID type) const;
+
+        // Returns the sum of the counters of all the pools
+        ComponentPoolStats getPoolStats() const;
+
+        ArchetypeStorage(const ArchetypeStorage&) = delete;
+        ArchetypeStorage& operator=(const ArchetypeStorage&) = delete;
+    };
+
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <vector>
+
+namespace our {
+
+    // Counters that describe the memory activity of one (or more) component pools
+    // During steady-state gameplay, "heapAllocations" should stop increasing: every block is then recycled from the pool
+    struct ComponentPoolStats {
+        size_t heapAllocations = 0; // The number of blocks that were allocated from the heap
+        size_t reuses = 0; // The number of times a recycled block was handed out instead of allocating a new one
+        size_t blocksInUse = 0; // The number of blocks currently owned by component columns
+        size_t freeBlocks = 0; // The number of blocks waiting in the pool to be reused
+
+        ComponentPoolStats& operator+=(const ComponentPoolStats& other) {
+            heapAllocations += other.heapAllocations;
+            reuses += other.reuses;
+            blocksInUse += other.blocksInUse;
+            freeBlocks += other.freeBlocks;
+            return *this;
+        }
+    };
+
+    // A pool of fixed size memory blocks shared by all the columns that hold the same component type.
+    // Each block has room for COMPONENT_CHUNK_SIZE components, so a level with thousands of components of one type
+    // only costs a handful of heap allocations. When a column shrinks (or is destroyed), its blocks go back to the pool
+    // instead of the heap and are handed out again to the next column that grows.
+    // The blocks are only returned to the heap when the pool is destroyed (with the world that owns it).
+    class ComponentBlockPool {
+        size_t blockSize; // The size of each block in bytes
+        size_t alignment; // The alignment of each block in bytes
+        std::vector<void*> freeBlocks; // The blocks that are ready to be reused
+        ComponentPoolStats stats;
+    public:
+        ComponentBlockPool(size_t blockSize, size_t alignment) : blockSize(blockSize), alignment(alignment) {}
+
+        // Returns all the free blocks to the heap. All the acquired blocks must have been released before the pool is destroyed
+        ~ComponentBlockPool() {
+            for(void* block : freeBlocks) ::operator delete(block, std::align_val_t(alignment));
+        }
+
+        // Returns an uninitialized block, reusing a free block if possible
+        void* acquire() {
+            void* block;
+            if(!freeBlocks.empty()) {
+                block = freeBlocks.back();
+                freeBlocks.pop_back();
+                ++stats.reuses;
+            } else {
+                block = ::operator new(blockSize, std::align_val_t(alignment));
+                ++stats.heapAllocations;
+            }
+            ++stats.blocksInUse;
+            return block;
+        }
+
+        // Gives a block back to the pool. The components inside it must have been destroyed already
+        void release(void* block) {
+            freeBlocks.push_back(block);
+            --stats.blocksInUse;
+        }
+
+        // Returns the counters of this pool
+        ComponentPoolStats getStats() const {
+            ComponentPoolStats result = stats;
+            result.freeBlocks = freeBlocks.size();
+            return result;
+        }
+
+        ComponentBlockPool(const ComponentBlockPool&) = delete;
+        ComponentBlockPool& operator=(const ComponentBlockPool&) = delete;
+    };
+
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <bitset>
+#include <cstddef>
+#include <type_traits>
+
+namespace our {
+
+    // Forward declarations of every component type known to the engine
+    class CameraComponent;
+    class MeshRendererComponent;
+    class FreePlayerControllerComponent;
+    class MovementComponent;
+    class LightComponent;
+
+    // A compile time list of types
+    template<typename... Ts>
+    struct TypeList {
+        static constexpr std::size_t size = sizeof...(Ts);
+    };
+
+    // This list defines the integer ID of each component type (its index in the list)
+    // When you create a new type of components, append it to this list (and to "deserializeComponent")
+    typedef TypeList<
+        CameraComponent,
+        MeshRendererComponent,
+        FreePlayerControllerComponent,
+        MovementComponent,
+        LightComponent
+    > RegisteredComponents;
+
+    // The maximum number of component types that can be registered in "RegisteredComponents"
+    #define MAX_COMPONENT_TYPES 32
+
+    static_assert(RegisteredComponents::size <= MAX_COMPONENT_TYPES, "Increase MAX_COMPONENT_TYPES");
+
+    typedef std::size_t ComponentTypeID;
+    // A set of component types where the bit at index "componentTypeID<T>" is set if T is in the set
+    typedef std::bitset<MAX_COMPONENT_TYPES> ComponentMask;
+
+    namespace component_type_internal {
+        // Finds the index of T in the given TypeList at compile time
+        template<typename T, typename List>
+        struct IndexOf;
+
+        template<typename T, typename... Ts>
+        struct IndexOf<T, TypeList<T, Ts...>> : std::integral_constant<ComponentTypeID, 0> {};
+
+        template<typename T, typename U, typename... Ts>
+        struct IndexOf<T, TypeList<U, Ts...>> : std::integral_constant<ComponentTypeID, 1 + IndexOf<T, TypeList<Ts...>>::value> {};
+
+        template<typename T>
+        struct IndexOf<T, TypeList<>> {
+            static_assert(!std::is_same<T, T>::value, "T must be added to RegisteredComponents in component-type.hpp");
+        };
+    }
+
+    // The integer ID of the component type T. It is computed at compile time, so using it costs nothing at runtime
+    // This ID is used to find the column holding the components of type T inside an archetype (see "archetype.hpp")
+    template<typename T>
+    constexpr ComponentTypeID componentTypeID = component_type_internal::IndexOf<T, RegisteredComponents>::value;
+
+    // Returns a mask containing all the given component types
+    template<typename... Ts>
+    ComponentMask componentMaskOf() {
+        ComponentMask mask;
+        (mask.set(componentTypeID<Ts>), ...);
+        return mask;
+    }
+
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+
+namespace our {
+
+    // An entity handle is a 32-bit value that refers to an entity of a world without pointing to it.
+    // It packs the index of the entity's slot in the world (lower bits) with the generation of that slot (upper bits).
+    // Every time an entity is destroyed, the generation of its slot is incremented, so the handles that refer
+    // to the destroyed entity stop resolving (World::get returns a nullptr) even if the slot is reused by a new entity.
+    class EntityHandle {
+    public:
+        static constexpr std::uint32_t INDEX_BITS = 20; // Up to ~1M entities alive at the same time
+        static constexpr std::uint32_t GENERATION_BITS = 32 - INDEX_BITS;
+        static constexpr std::uint32_t INDEX_MASK = (1u << INDEX_BITS) - 1;
+        static constexpr std::uint32_t GENERATION_MASK = (1u << GENERATION_BITS) - 1;
+        static constexpr std::uint32_t MAX_ENTITIES = INDEX_MASK; // The index INDEX_MASK is reserved for the null handle
+
+    private:
+        std::uint32_t value = 0xFFFFFFFFu; // The default handle is the null handle
+
+    public:
+        constexpr EntityHandle() = default;
+        constexpr EntityHandle(std::uint32_t index, std::uint32_t generation)
+            : value((index & INDEX_MASK) | ((generation & GENERATION_MASK) << INDEX_BITS)) {}
+
+        // Returns the index of the slot that holds the entity
+        constexpr std::uint32_t getIndex() const { return value & INDEX_MASK; }
+        // Returns the generation of the slot when the entity was created
+        constexpr std::uint32_t getGeneration() const { return value >> INDEX_BITS; }
+        // Returns the raw 32-bit value of the handle
+        constexpr std::uint32_t getValue() const { return value; }
+
+        // Returns true if the handle doesn't refer to any entity
+        constexpr bool isNull() const { return value == 0xFFFFFFFFu; }
+
+        constexpr bool operator==(const EntityHandle& other) const { return value == other.value; }
+        constexpr bool operator!=(const EntityHandle& other) const { return value != other.value; }
+    };
+
+}
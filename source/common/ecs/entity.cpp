@@ -1,4 +1,5 @@
 #include "entity.hpp"
+#include "world.hpp"
 #include "../deserialize-utils.hpp"
 #include "../components/component-deserializer.hpp"
 
@@ -6,15 +7,40 @@
 
 namespace our {
 
-    // This function returns the transformation matrix from the entity's local space to the world space
-    glm::mat4 Entity::getLocalToWorldMatrix() const {
-        if (parent != NULL)
-        {
-            return parent->getLocalToWorldMatrix() * localTransform.toMat4();
-        }
-        else
-        {
-            return localTransform.toMat4();
+    // Adds this entity to the dirty list of its world (once until the next transform update)
+    void Entity::markTransformDirty() {
+        if(transformDirty) return;
+        transformDirty = true;
+        // An entity is in the list at most once, so the list (which has room for every entity) can't overflow
+        world->dirtyEntities[world->dirtyCount.fetch_add(1, std::memory_order_relaxed)] = this;
+    }
+
+    // Returns the parent of this entity (or null if it is a root entity or if its parent was deleted)
+    Entity* Entity::getParent() const {
+        return world->get(parent);
+    }
+
+    // Changes the parent of this entity and tells the world that the hierarchy has changed
+    void Entity::setParent(Entity* newParent) {
+        EntityHandle newHandle = newParent ? newParent->handle : EntityHandle();
+        if(parent == newHandle) return;
+        parent = newHandle;
+        markTransformDirty();
+        world->hierarchyChanged = true;
+    }
+
+    // Replaces all the components of this entity with copies of the components of "source"
+    void Entity::copyComponentsFrom(const Entity* source) {
+        // The entity goes directly to the archetype of the source, so the components are copied column by column
+        // without going through the intermediate archetypes
+        Archetype* target = archetype->getStorage()->getMatching(source->archetype);
+        bool marked = archetype->isMarked(row);
+        archetype->removeRow(row);
+        archetype = target;
+        row = target->pushCopyOf(this, *source->archetype, source->row);
+        if(marked) row = target->markRow(row);
+        for(ComponentTypeID type = 0; type < MAX_COMPONENT_TYPES; ++type) {
+            if(ComponentColumn* column = target->getColumn(type); column) column->at(row)->owner = this;
         }
     }
 
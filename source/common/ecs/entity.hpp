@@ -1,8 +1,9 @@
 #pragma once
 
 #include "component.hpp"
+#include "archetype.hpp"
+#include "entity-handle.hpp"
 #include "transform.hpp"
-#include <unordered_map>
 #include <string>
 #include <type_traits>
 #include <glm/glm.hpp>
@@ -13,30 +14,88 @@ namespace our {
 
     class Entity{
         World *world; // This defines what world own this entity
-        std::unordered_map<std::string, Component*> components; // A map of components that are owned by this entity
-                                                                // The key is the ID of the component so an entity can only have one component of each type
+        EntityHandle handle; // The handle that refers to this entity in its world
+        Archetype* archetype; // The archetype in which the components of this entity are stored
+        size_t row; // The row of this entity inside its archetype
+                    // An entity can only have one component of each type since each type has a single column in the archetype
+
+        EntityHandle parent; // The handle of the parent of the entity. The transform of the entity is relative to its parent.
+                             // If parent is null (or the parent was deleted), the entity is a root entity (has no parent).
+
+        Transform localTransform; // The transform of this entity relative to its parent (see "editLocalTransform")
+
+        // The local to world matrix is cached and only recomputed by "World::updateTransforms" when it could have changed
+        glm::mat4 localToWorld = glm::mat4(1.0f); // The cached transformation from the local space to the world space
+        glm::mat3 normalMatrix = glm::mat3(1.0f); // The cached inverse transpose of the upper 3x3 part of "localToWorld"
+        bool transformDirty = false; // True if this entity is waiting in the dirty list of the world for the next transform update
+        bool localToWorldChanged = false; // True if "localToWorld" was recomputed in the last update
+        size_t depth = 0; // The number of ancestors of this entity (computed by the world when the hierarchy changes)
+
+        // Replaces all the components of this entity with copies of the components of "source" (which may belong to another world)
+        void copyComponentsFrom(const Entity* source);
 
         friend World; // The world is a friend since it is the only class that is allowed to instantiate an entity
+        friend Archetype; // The archetype updates the row of the entity when it moves rows around
         Entity() = default; // The entity constructor is private since only the world is allowed to instantiate an entity
     public:
         std::string name; // The name of the entity. It could be useful to refer to an entity by its name
-        Entity* parent;   // The parent of the entity. The transform of the entity is relative to its parent.
-                          // If parent is null, the entity is a root entity (has no parent).
-        Transform localTransform; // The transform of this entity relative to its parent.
 
         World* getWorld() const { return world; } // Returns the world to which this entity belongs
 
-        glm::mat4 getLocalToWorldMatrix() const; // Computes and returns the transformation from the entities local space to the world space
+        EntityHandle getHandle() const { return handle; } // Returns the handle that refers to this entity in its world
+
+        Entity* getParent() const; // Returns the parent of this entity (or null if it is a root entity or if its parent was deleted)
+        void setParent(Entity* newParent); // Changes the parent of this entity
+
+        // Returns the transformation from the entity's local space to the world space
+        // The matrix is cached and is only up to date after "World::updateTransforms" has been called for the current frame
+        const glm::mat4& getLocalToWorldMatrix() const { return localToWorld; }
+
+        // Returns the matrix used to transform the normals to the world space (the inverse transpose of the local to world matrix)
+        // The matrix is cached with the local to world matrix, so the renderer doesn't need to invert the matrix of every object
+        const glm::mat3& getNormalMatrix() const { return normalMatrix; }
+
+        // Returns true if the local to world matrix was recomputed by the last transform update (so the copies of it are outdated)
+        bool hasLocalToWorldChanged() const { return localToWorldChanged; }
+
+        // Returns the transform of this entity relative to its parent
+        const Transform& getLocalTransform() const { return localTransform; }
+
+        // Returns the transform of this entity relative to its parent so it can be modified. The entity is marked dirty,
+        // so the next transform update recomputes its matrices and those of its children (the untouched entities are skipped)
+        // The transforms of different entities can be edited on different threads (but not while entities are being added)
+        Transform& editLocalTransform() {
+            markTransformDirty();
+            return localTransform;
+        }
+
+        // Replaces the transform of this entity relative to its parent (and marks the entity dirty)
+        void setLocalTransform(const Transform& transform) { editLocalTransform() = transform; }
+
+        // Forces the local to world matrix of this entity and its children to be recomputed in the next transform update
+        void markTransformDirty();
+
         void deserialize(const nlohmann::json&); // Deserializes the entity data and components from a json object
         
         // This template method create a component of type T,
-        // adds it to the components map and returns a pointer to it 
+        // moves the entity to the archetype that contains T and returns a pointer to the new component
+        // WARNING: Adding or deleting components moves the other components of this entity,
+        // so component pointers should not be kept across calls to "addComponent" and "deleteComponent"
         template<typename T>
         T* addComponent(){
             static_assert(std::is_base_of<Component, T>::value, "T must inherit from Component");
-            T* component = new T();
+            T* component;
+            if(auto column = archetype->getColumn<T>(); column){
+                // The entity already has a component of type T, so we replace it with a new one
+                component = column->get(row);
+                *component = T();
+            } else {
+                Archetype* target = archetype->getStorage()->getWithComponent(archetype, componentTypeID<T>, TypedComponentColumn<T>::columnType);
+                row = archetype->moveRowTo(row, target);
+                archetype = target;
+                component = target->getColumn<T>()->get(row);
+            }
             component->owner = this;
-            components[T::getID()] = component;
             return component;
         }
 
@@ -45,27 +104,41 @@ namespace our {
         template<typename T>
         T* getComponent(){
             static_assert(std::is_base_of<Component, T>::value, "T must inherit from Component");
-            if(auto it = components.find(static_cast<std::string>(T::getID())); it != components.end()){
-                return dynamic_cast<T*>(it->second);
+            if(auto column = archetype->getColumn<T>(); column){
+                return column->get(row);
             }
             return nullptr;
         }
 
+        // This template method replaces the component of type T of this entity with a copy of the component of type T of "source"
+        // (which may belong to another world) and returns a pointer to the copy. The copy is owned by this entity.
+        // If "source" has no component of type T, this entity is not changed and a nullptr is returned
+        template<typename T>
+        T* copyComponentFrom(const Entity* source){
+            static_assert(std::is_base_of<Component, T>::value, "T must inherit from Component");
+            auto sourceColumn = source->archetype->getColumn<T>();
+            if(!sourceColumn) return nullptr;
+            T* component = getComponent<T>();
+            if(!component) component = addComponent<T>();
+            *component = *sourceColumn->get(source->row);
+            component->owner = this;
+            return component;
+        }
+
         // This template method searhes for a component of type T and deletes it
         template<typename T>
         void deleteComponent(){
             static_assert(std::is_base_of<Component, T>::value, "T must inherit from Component");
-            if(auto it = components.find(static_cast<std::string>(T::getID())); it != components.end()){
-                delete it->second;
-                components.erase(it);
+            if(archetype->getColumn<T>()){
+                Archetype* target = archetype->getStorage()->getWithoutComponent(archetype, componentTypeID<T>);
+                row = archetype->moveRowTo(row, target);
+                archetype = target;
             }
         }
 
         // Since the entity owns its components, they should be deleted alongside the entity
         ~Entity(){
-            for(auto& it : components){
-                delete it.second;
-            }
+            archetype->removeRow(row);
         }
 
         // Entities should not be copyable
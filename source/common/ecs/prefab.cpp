@@ -0,0 +1,32 @@
+#include "prefab.hpp"
+
+#include <unordered_map>
+
+namespace our {
+
+    // Compiles the given json array of entities
+    void Prefab::compile(const nlohmann::json& data) {
+        prototypes.clear();
+        entities.clear();
+        prototypes.deserialize(data);
+        // The world keeps the entities in their creation order and "deserialize" creates the parents before their children
+        std::unordered_map<const Entity*, size_t> indices;
+        for(Entity* prototype : prototypes.getEntities()) {
+            Entity* parent = prototype->getParent();
+            entities.push_back({prototype, parent ? indices[parent] : NO_PARENT});
+            indices[prototype] = entities.size() - 1;
+        }
+    }
+
+    // Adds a copy of all the entities of the prefab to the given world
+    Entity* Prefab::instantiate(World* world, Entity* parent) const {
+        std::vector<Entity*> instances(entities.size());
+        for(size_t index = 0; index < entities.size(); ++index) {
+            const PrefabEntity& entity = entities[index];
+            Entity* instanceParent = entity.parent == NO_PARENT ? parent : instances[entity.parent];
+            instances[index] = world->addCopyOf(entity.prototype, instanceParent);
+        }
+        return instances.empty() ? nullptr : instances.front();
+    }
+
+}
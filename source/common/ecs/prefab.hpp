@@ -0,0 +1,44 @@
+#pragma once
+
+#include "world.hpp"
+
+#include <json/json.hpp>
+#include <vector>
+
+namespace our {
+
+    // A prefab is a snippet of a scene (a json array of entities like the "world" in the scene config) that is compiled
+    // once into prototype entities. Instantiating a prefab copies the components of the prototypes column by column,
+    // so, unlike "World::deserialize", it doesn't parse any json nor look up any asset by name.
+    class Prefab {
+        // A compiled entity of the prefab
+        struct PrefabEntity {
+            Entity* prototype; // The entity holding the compiled data
+            size_t parent; // The index of the parent in "entities" (or NO_PARENT if it is a root of the prefab)
+        };
+        static constexpr size_t NO_PARENT = static_cast<size_t>(-1);
+
+        World prototypes; // The world that holds the prototypes (it is never updated nor rendered)
+        std::vector<PrefabEntity> entities; // The compiled entities where the parents always come before their children
+    public:
+        Prefab() = default;
+
+        // Compiles the given json array of entities (replacing the previous content of the prefab)
+        void compile(const nlohmann::json& data);
+
+        // Returns true if the prefab has no entities
+        bool empty() const { return entities.empty(); }
+
+        // Returns the prototype of the first root entity (or a nullptr if the prefab is empty)
+        // It can be used to read (or modify) the data that will be given to the next instances
+        Entity* getRoot() { return entities.empty() ? nullptr : entities.front().prototype; }
+
+        // Adds a copy of all the entities of the prefab to the given world and returns the copy of the first root entity
+        // The roots of the prefab become children of the given parent (if not null)
+        Entity* instantiate(World* world, Entity* parent = nullptr) const;
+
+        Prefab(const Prefab&) = delete;
+        Prefab& operator=(const Prefab&) = delete;
+    };
+
+}
@@ -0,0 +1,47 @@
+#include "system-scheduler.hpp"
+#include "../jobs/job-system.hpp"
+
+#include <algorithm>
+
+namespace our {
+
+    // Adds a system in the first stage after all the systems that it conflicts with
+    void SystemScheduler::add(const SystemAccess& access, std::function<void(World*, float)> update) {
+        size_t stage = 0;
+        for(const auto& system : systems) {
+            if(system.access.conflictsWith(access)) stage = std::max(stage, system.stage + 1);
+        }
+        if(stages.size() <= stage) stages.resize(stage + 1);
+        stages[stage].push_back(systems.size());
+        systems.push_back({access, std::move(update), stage});
+    }
+
+    // Runs the systems stage by stage. The systems inside a stage don't conflict, so they run in parallel
+    void SystemScheduler::run(World* world, float deltaTime) {
+        JobSystem& jobs = JobSystem::getInstance();
+        for(const auto& stage : stages) {
+            // A stage with a single system doesn't need to go through the job queues
+            if(stage.size() == 1) {
+                systems[stage.front()].update(world, deltaTime);
+                continue;
+            }
+            JobGroup group;
+            for(size_t index : stage) {
+                auto& system = systems[index];
+                if(system.access.isOnMainThread()) continue;
+                jobs.run(group, [&system, world, deltaTime](){ system.update(world, deltaTime); });
+            }
+            for(size_t index : stage) {
+                auto& system = systems[index];
+                if(system.access.isOnMainThread()) system.update(world, deltaTime);
+            }
+            jobs.wait(group);
+        }
+    }
+
+    void SystemScheduler::clear() {
+        systems.clear();
+        stages.clear();
+    }
+
+}
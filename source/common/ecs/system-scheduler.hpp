@@ -0,0 +1,89 @@
+#pragma once
+
+#include "world.hpp"
+
+#include <functional>
+#include <vector>
+
+namespace our {
+
+    // Transforms are stored in the entities instead of a component column, so they get a reserved bit in the access masks
+    #define TRANSFORM_ACCESS_BIT (MAX_COMPONENT_TYPES - 1)
+
+    static_assert(RegisteredComponents::size < MAX_COMPONENT_TYPES, "The last component type ID is reserved for TRANSFORM_ACCESS_BIT");
+
+    namespace system_scheduler_internal {
+        // The bit that represents the type T in an access mask
+        template<typename T>
+        constexpr ComponentTypeID accessBit = componentTypeID<T>;
+
+        template<>
+        constexpr ComponentTypeID accessBit<Transform> = TRANSFORM_ACCESS_BIT;
+    }
+
+    // Declares the data that a system touches. Two systems can run at the same time only if neither of them
+    // writes a type that the other reads or writes. The types can be any component type or "Transform".
+    // For example: SystemAccess().reads<MovementComponent>().writes<Transform>()
+    class SystemAccess {
+        ComponentMask readMask; // The types read by the system
+        ComponentMask writeMask; // The types written by the system
+        bool mainThread = false; // If true, the system must run on the thread that calls "SystemScheduler::run"
+    public:
+        template<typename... Ts>
+        SystemAccess& reads() {
+            (readMask.set(system_scheduler_internal::accessBit<Ts>), ...);
+            return *this;
+        }
+
+        template<typename... Ts>
+        SystemAccess& writes() {
+            (writeMask.set(system_scheduler_internal::accessBit<Ts>), ...);
+            return *this;
+        }
+
+        // Declares that the system writes everything (for example, it adds or removes entities or components)
+        // Such a system never runs at the same time as another system
+        SystemAccess& exclusive() {
+            writeMask.set();
+            return *this;
+        }
+
+        // Declares that the system must run on the calling thread (for example, it uses the window, the input or OpenGL)
+        SystemAccess& onMainThread() {
+            mainThread = true;
+            return *this;
+        }
+
+        bool isOnMainThread() const { return mainThread; }
+
+        // Returns true if the two systems can't run at the same time
+        bool conflictsWith(const SystemAccess& other) const {
+            return (writeMask & (other.readMask | other.writeMask)).any() || (other.writeMask & readMask).any();
+        }
+    };
+
+    // The scheduler runs a list of systems every frame.
+    // When a system is added, it is placed in the first stage that comes after all the previously added systems that it conflicts with.
+    // So the systems that conflict keep the order in which they were added, while the systems in the same stage run in parallel
+    // on the job system (except the main thread systems which run on the calling thread while the others are running).
+    class SystemScheduler {
+        struct ScheduledSystem {
+            SystemAccess access;
+            std::function<void(World*, float)> update;
+            size_t stage;
+        };
+
+        std::vector<ScheduledSystem> systems;
+        std::vector<std::vector<size_t>> stages; // The indices of the systems in each stage
+    public:
+        // Adds a system that will be called as "update(world, deltaTime)" during "run"
+        void add(const SystemAccess& access, std::function<void(World*, float)> update);
+
+        // Runs all the systems stage by stage and returns after all of them finished
+        void run(World* world, float deltaTime);
+
+        // Removes all the systems
+        void clear();
+    };
+
+}
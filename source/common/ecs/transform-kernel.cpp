@@ -0,0 +1,184 @@
+#include "transform-kernel.hpp"
+
+#include <cmath>
+
+#ifdef TRANSFORM_KERNEL_SSE
+#include <xmmintrin.h>
+#endif
+
+namespace our::transform_kernel {
+
+    // Computes the affine matrix of a single transform
+    static void composeMatrix(const glm::vec3& position, const glm::quat& q, const glm::vec3& scale, glm::mat4& matrix) {
+        float xx = q.x * q.x, yy = q.y * q.y, zz = q.z * q.z;
+        float xy = q.x * q.y, xz = q.x * q.z, yz = q.y * q.z;
+        float wx = q.w * q.x, wy = q.w * q.y, wz = q.w * q.z;
+        matrix[0] = glm::vec4(1.0f - 2.0f * (yy + zz), 2.0f * (xy + wz), 2.0f * (xz - wy), 0.0f) * scale.x;
+        matrix[1] = glm::vec4(2.0f * (xy - wz), 1.0f - 2.0f * (xx + zz), 2.0f * (yz + wx), 0.0f) * scale.y;
+        matrix[2] = glm::vec4(2.0f * (xz + wy), 2.0f * (yz - wx), 1.0f - 2.0f * (xx + yy), 0.0f) * scale.z;
+        matrix[3] = glm::vec4(position, 1.0f);
+    }
+
+    // Computes the normal matrix of a single affine matrix
+    static void computeNormalMatrix(const glm::mat4& matrix, glm::mat3& normalMatrix) {
+        glm::vec3 a(matrix[0]), b(matrix[1]), c(matrix[2]);
+        // The rows of the inverse are the cross products of the columns divided by the determinant,
+        // so they are the columns of the inverse transpose
+        glm::vec3 bc = glm::cross(b, c), ca = glm::cross(c, a), ab = glm::cross(a, b);
+        float inverseDeterminant = 1.0f / glm::dot(a, bc);
+        normalMatrix = glm::mat3(bc * inverseDeterminant, ca * inverseDeterminant, ab * inverseDeterminant);
+    }
+
+#ifdef TRANSFORM_KERNEL_SSE
+
+    void composeMatrices(size_t count, const glm::vec3* positions, const glm::quat* rotations, const glm::vec3* scales, glm::mat4* matrices) {
+        size_t index = 0;
+        const __m128 one = _mm_set1_ps(1.0f), two = _mm_set1_ps(2.0f);
+        for(; index + 4 <= count; index += 4) {
+            const glm::quat* q = rotations + index;
+            const glm::vec3* p = positions + index;
+            const glm::vec3* s = scales + index;
+            // Each register holds one value of the 4 transforms (structure of arrays)
+            __m128 x = _mm_set_ps(q[3].x, q[2].x, q[1].x, q[0].x);
+            __m128 y = _mm_set_ps(q[3].y, q[2].y, q[1].y, q[0].y);
+            __m128 z = _mm_set_ps(q[3].z, q[2].z, q[1].z, q[0].z);
+            __m128 w = _mm_set_ps(q[3].w, q[2].w, q[1].w, q[0].w);
+            __m128 sx = _mm_set_ps(s[3].x, s[2].x, s[1].x, s[0].x);
+            __m128 sy = _mm_set_ps(s[3].y, s[2].y, s[1].y, s[0].y);
+            __m128 sz = _mm_set_ps(s[3].z, s[2].z, s[1].z, s[0].z);
+            __m128 px = _mm_set_ps(p[3].x, p[2].x, p[1].x, p[0].x);
+            __m128 py = _mm_set_ps(p[3].y, p[2].y, p[1].y, p[0].y);
+            __m128 pz = _mm_set_ps(p[3].z, p[2].z, p[1].z, p[0].z);
+
+            __m128 x2 = _mm_mul_ps(x, two), y2 = _mm_mul_ps(y, two), z2 = _mm_mul_ps(z, two);
+            __m128 xx = _mm_mul_ps(x, x2), yy = _mm_mul_ps(y, y2), zz = _mm_mul_ps(z, z2);
+            __m128 xy = _mm_mul_ps(x, y2), xz = _mm_mul_ps(x, z2), yz = _mm_mul_ps(y, z2);
+            __m128 wx = _mm_mul_ps(w, x2), wy = _mm_mul_ps(w, y2), wz = _mm_mul_ps(w, z2);
+
+            // The elements of the upper 3x3 part (the element at column c and row r is named mCR) multiplied by the scale of their column
+            __m128 m00 = _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(yy, zz)), sx);
+            __m128 m01 = _mm_mul_ps(_mm_add_ps(xy, wz), sx);
+            __m128 m02 = _mm_mul_ps(_mm_sub_ps(xz, wy), sx);
+            __m128 m10 = _mm_mul_ps(_mm_sub_ps(xy, wz), sy);
+            __m128 m11 = _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(xx, zz)), sy);
+            __m128 m12 = _mm_mul_ps(_mm_add_ps(yz, wx), sy);
+            __m128 m20 = _mm_mul_ps(_mm_add_ps(xz, wy), sz);
+            __m128 m21 = _mm_mul_ps(_mm_sub_ps(yz, wx), sz);
+            __m128 m22 = _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(xx, yy)), sz);
+            // The w row of each column (the transposition below overwrites its arguments)
+            __m128 w0 = _mm_setzero_ps(), w1 = _mm_setzero_ps(), w2 = _mm_setzero_ps(), w3 = one;
+
+            // Transposing a group of 4 rows gives the same column of the 4 matrices
+            _MM_TRANSPOSE4_PS(m00, m01, m02, w0);
+            _MM_TRANSPOSE4_PS(m10, m11, m12, w1);
+            _MM_TRANSPOSE4_PS(m20, m21, m22, w2);
+            _MM_TRANSPOSE4_PS(px, py, pz, w3);
+            __m128 columns0[4] = { m00, m01, m02, w0 };
+            __m128 columns1[4] = { m10, m11, m12, w1 };
+            __m128 columns2[4] = { m20, m21, m22, w2 };
+            __m128 columns3[4] = { px, py, pz, w3 };
+            for(int lane = 0; lane < 4; ++lane) {
+                float* matrix = &matrices[index + lane][0][0];
+                _mm_storeu_ps(matrix + 0, columns0[lane]);
+                _mm_storeu_ps(matrix + 4, columns1[lane]);
+                _mm_storeu_ps(matrix + 8, columns2[lane]);
+                _mm_storeu_ps(matrix + 12, columns3[lane]);
+            }
+        }
+        for(; index < count; ++index) composeMatrix(positions[index], rotations[index], scales[index], matrices[index]);
+    }
+
+    void computeNormalMatrices(size_t count, const glm::mat4* matrices, glm::mat3* normalMatrices) {
+        size_t index = 0;
+        const __m128 one = _mm_set1_ps(1.0f);
+        for(; index + 4 <= count; index += 4) {
+            // Load the first 3 columns of the 4 matrices then transpose them to get one component of the 4 matrices per register
+            const float* m0 = &matrices[index + 0][0][0];
+            const float* m1 = &matrices[index + 1][0][0];
+            const float* m2 = &matrices[index + 2][0][0];
+            const float* m3 = &matrices[index + 3][0][0];
+            __m128 ax = _mm_loadu_ps(m0), ay = _mm_loadu_ps(m1), az = _mm_loadu_ps(m2), aw = _mm_loadu_ps(m3);
+            _MM_TRANSPOSE4_PS(ax, ay, az, aw);
+            __m128 bx = _mm_loadu_ps(m0 + 4), by = _mm_loadu_ps(m1 + 4), bz = _mm_loadu_ps(m2 + 4), bw = _mm_loadu_ps(m3 + 4);
+            _MM_TRANSPOSE4_PS(bx, by, bz, bw);
+            __m128 cx = _mm_loadu_ps(m0 + 8), cy = _mm_loadu_ps(m1 + 8), cz = _mm_loadu_ps(m2 + 8), cw = _mm_loadu_ps(m3 + 8);
+            _MM_TRANSPOSE4_PS(cx, cy, cz, cw);
+
+            // bc = cross(b, c), ca = cross(c, a), ab = cross(a, b)
+            __m128 bcx = _mm_sub_ps(_mm_mul_ps(by, cz), _mm_mul_ps(bz, cy));
+            __m128 bcy = _mm_sub_ps(_mm_mul_ps(bz, cx), _mm_mul_ps(bx, cz));
+            __m128 bcz = _mm_sub_ps(_mm_mul_ps(bx, cy), _mm_mul_ps(by, cx));
+            __m128 cax = _mm_sub_ps(_mm_mul_ps(cy, az), _mm_mul_ps(cz, ay));
+            __m128 cay = _mm_sub_ps(_mm_mul_ps(cz, ax), _mm_mul_ps(cx, az));
+            __m128 caz = _mm_sub_ps(_mm_mul_ps(cx, ay), _mm_mul_ps(cy, ax));
+            __m128 abx = _mm_sub_ps(_mm_mul_ps(ay, bz), _mm_mul_ps(az, by));
+            __m128 aby = _mm_sub_ps(_mm_mul_ps(az, bx), _mm_mul_ps(ax, bz));
+            __m128 abz = _mm_sub_ps(_mm_mul_ps(ax, by), _mm_mul_ps(ay, bx));
+            __m128 determinant = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, bcx), _mm_mul_ps(ay, bcy)), _mm_mul_ps(az, bcz));
+            __m128 inverseDeterminant = _mm_div_ps(one, determinant);
+
+            alignas(16) float result[9][4];
+            _mm_store_ps(result[0], _mm_mul_ps(bcx, inverseDeterminant));
+            _mm_store_ps(result[1], _mm_mul_ps(bcy, inverseDeterminant));
+            _mm_store_ps(result[2], _mm_mul_ps(bcz, inverseDeterminant));
+            _mm_store_ps(result[3], _mm_mul_ps(cax, inverseDeterminant));
+            _mm_store_ps(result[4], _mm_mul_ps(cay, inverseDeterminant));
+            _mm_store_ps(result[5], _mm_mul_ps(caz, inverseDeterminant));
+            _mm_store_ps(result[6], _mm_mul_ps(abx, inverseDeterminant));
+            _mm_store_ps(result[7], _mm_mul_ps(aby, inverseDeterminant));
+            _mm_store_ps(result[8], _mm_mul_ps(abz, inverseDeterminant));
+            for(int lane = 0; lane < 4; ++lane) {
+                float* normalMatrix = &normalMatrices[index + lane][0][0];
+                for(int element = 0; element < 9; ++element) normalMatrix[element] = result[element][lane];
+            }
+        }
+        for(; index < count; ++index) computeNormalMatrix(matrices[index], normalMatrices[index]);
+    }
+
+    glm::mat4 multiply(const glm::mat4& first, const glm::mat4& second) {
+        const float* a = &first[0][0];
+        const float* b = &second[0][0];
+        __m128 a0 = _mm_loadu_ps(a), a1 = _mm_loadu_ps(a + 4), a2 = _mm_loadu_ps(a + 8), a3 = _mm_loadu_ps(a + 12);
+        glm::mat4 result;
+        float* r = &result[0][0];
+        for(int column = 0; column < 4; ++column) {
+            const float* bColumn = b + 4 * column;
+            __m128 sum = _mm_mul_ps(a0, _mm_set1_ps(bColumn[0]));
+            sum = _mm_add_ps(sum, _mm_mul_ps(a1, _mm_set1_ps(bColumn[1])));
+            sum = _mm_add_ps(sum, _mm_mul_ps(a2, _mm_set1_ps(bColumn[2])));
+            sum = _mm_add_ps(sum, _mm_mul_ps(a3, _mm_set1_ps(bColumn[3])));
+            _mm_storeu_ps(r + 4 * column, sum);
+        }
+        return result;
+    }
+
+#else
+
+    void composeMatrices(size_t count, const glm::vec3* positions, const glm::quat* rotations, const glm::vec3* scales, glm::mat4* matrices) {
+        for(size_t index = 0; index < count; ++index) composeMatrix(positions[index], rotations[index], scales[index], matrices[index]);
+    }
+
+    void computeNormalMatrices(size_t count, const glm::mat4* matrices, glm::mat3* normalMatrices) {
+        for(size_t index = 0; index < count; ++index) computeNormalMatrix(matrices[index], normalMatrices[index]);
+    }
+
+    glm::mat4 multiply(const glm::mat4& first, const glm::mat4& second) {
+        return first * second;
+    }
+
+#endif
+
+    glm::quat eulerToQuaternion(const glm::vec3& rotation) {
+        // yawPitchRoll is Ry(yaw) * Rx(pitch) * Rz(roll), so the quaternion is the product of the 3 axis rotations in the same order
+        float cy = std::cos(rotation.y * 0.5f), sy = std::sin(rotation.y * 0.5f);
+        float cp = std::cos(rotation.x * 0.5f), sp = std::sin(rotation.x * 0.5f);
+        float cr = std::cos(rotation.z * 0.5f), sr = std::sin(rotation.z * 0.5f);
+        return glm::quat(
+            cy * cp * cr + sy * sp * sr, // w
+            cy * sp * cr + sy * cp * sr, // x
+            sy * cp * cr - cy * sp * sr, // y
+            cy * cp * sr - sy * sp * cr  // z
+        );
+    }
+
+}
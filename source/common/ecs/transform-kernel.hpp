@@ -0,0 +1,32 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <cstddef>
+
+// The kernels use SSE when the target supports it (always the case on x86-64), otherwise they fall back to scalar code
+#if !defined(TRANSFORM_KERNEL_SCALAR) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+    #define TRANSFORM_KERNEL_SSE
+#endif
+
+// These functions convert batches of transforms into matrices.
+// The SSE versions process 4 transforms at a time (one per SIMD lane) so the work of a batch is done without any branch or trig call.
+namespace our::transform_kernel {
+
+    // Computes the affine matrices (translation * rotation * scale) of "count" transforms given as separate arrays
+    // The rotations must be unit quaternions
+    void composeMatrices(size_t count, const glm::vec3* positions, const glm::quat* rotations, const glm::vec3* scales, glm::mat4* matrices);
+
+    // Computes the normal matrices (the inverse transpose of the upper 3x3 part) of "count" affine matrices
+    // Unlike a general 4x4 inverse, this only needs 3 cross products and a division per matrix
+    void computeNormalMatrices(size_t count, const glm::mat4* matrices, glm::mat3* normalMatrices);
+
+    // Returns first * second
+    glm::mat4 multiply(const glm::mat4& first, const glm::mat4& second);
+
+    // Returns the unit quaternion of the rotation defined by the given euler angles (y: yaw, x: pitch, z: roll)
+    // The rotation is the same as the matrix returned by "glm::yawPitchRoll(yaw, pitch, roll)"
+    glm::quat eulerToQuaternion(const glm::vec3& rotation);
+
+}
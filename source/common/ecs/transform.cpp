@@ -1,19 +1,31 @@
 #include "entity.hpp"
+#include "transform-kernel.hpp"
 #include "../deserialize-utils.hpp"
 
 #include<iostream>
-#include <glm/gtx/euler_angles.hpp>
 
 namespace our {
     // This function computes and returns a matrix that represents this transform
+    // It is equal to translation * rotation * scaling but it is built directly from the rotation quaternion instead of multiplying 3 matrices
     glm::mat4 Transform::toMat4() const {
-        // prepare transformation matrices for translation, rotation, scaling
-        glm::highp_mat4 translation(glm::translate(glm::mat4(1.0f), position));
-        glm::highp_mat4 rotation(glm::yawPitchRoll(rotation.y, rotation.x, rotation.z));
-        glm::highp_mat4 scaling(glm::scale(glm::mat4(1.0f), scale));
+        glm::quat rotationQuaternion = getRotationQuaternion();
+        glm::mat4 matrix;
+        transform_kernel::composeMatrices(1, &position, &rotationQuaternion, &scale, &matrix);
+        return matrix;
+    }
+
+    // Returns the rotation of this transform as a unit quaternion
+    glm::quat Transform::getRotationQuaternion() const {
+        return useOrientation ? orientation : transform_kernel::eulerToQuaternion(rotation);
+    }
 
-        // combine these transformations through matrix multiplication in the proper order
-        return  translation * rotation * scaling;
+    // Rotates the transform by the given euler angles
+    void Transform::rotate(const glm::vec3& angles) {
+        if(useOrientation) {
+            orientation = glm::normalize(orientation * transform_kernel::eulerToQuaternion(angles));
+        } else {
+            rotation += angles;
+        }
     }
 
     // Deserializes the entity data and components from a json object
@@ -21,6 +33,12 @@ namespace our {
         position = data.value("position", position);
         rotation = glm::radians(data.value("rotation", glm::degrees(rotation)));
         scale    = data.value("scale", scale);
+        // The orientation is given as a quaternion [x, y, z, w] and, if present, it is used instead of the euler angles
+        if(data.contains("orientation")){
+            glm::vec4 value = data["orientation"].get<glm::vec4>();
+            orientation = glm::normalize(glm::quat(value.w, value.x, value.y, value.z));
+            useOrientation = true;
+        }
     }
 
 }
\ No newline at end of file
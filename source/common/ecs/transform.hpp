@@ -1,6 +1,7 @@
 #pragma once
 
 #include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
 #include <json/json.hpp>
 
 namespace our {
@@ -11,9 +12,17 @@ namespace our {
         glm::vec3 position = glm::vec3(0, 0, 0); // The position is defined as a vec3. (0,0,0) means no translation
         glm::vec3 rotation = glm::vec3(0, 0, 0); // The rotation is defined using euler angles (y: yaw, x: pitch, z: roll). (0,0,0) means no rotation
         glm::vec3 scale = glm::vec3(1, 1, 1); // The scale is defined as a vec3. (1,1,1) means no scaling.
+        // Optionally, the rotation can be stored as a quaternion which skips the euler angles trigonometry when the matrix is computed
+        bool useOrientation = false; // If true, "orientation" defines the rotation and "rotation" is ignored
+        glm::quat orientation = glm::quat(1, 0, 0, 0); // The rotation as a unit quaternion (only used if "useOrientation" is true)
 
         // This function computes and returns a matrix that represents this transform
         glm::mat4 toMat4() const;
+        // Returns the rotation of this transform as a unit quaternion
+        glm::quat getRotationQuaternion() const;
+        // Rotates the transform by the given euler angles (y: yaw, x: pitch, z: roll)
+        // The angles are added to "rotation", or applied to "orientation" if the transform uses a quaternion
+        void rotate(const glm::vec3& angles);
          // Deserializes the entity data and components from a json object
         void deserialize(const nlohmann::json&);
     };
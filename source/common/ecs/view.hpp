@@ -0,0 +1,101 @@
+#pragma once
+
+#include "archetype.hpp"
+#include "../jobs/job-system.hpp"
+
+#include <algorithm>
+#include <tuple>
+
+namespace our {
+
+    // The default number of rows processed by each job in "View::forEachParallel"
+    #define PARALLEL_VIEW_GRAIN_SIZE 1024
+
+    // A view gives access to all the entities that hold the component types Ts...
+    // It is built on a cached archetype query, so iterating over a view only touches the archetypes (and rows) that match.
+    // The matching set is kept up to date incrementally: adding or deleting a component moves the entity to another archetype,
+    // marking an entity for removal moves it out of the live rows, and newly created archetypes are added to the query.
+    // A view is cheap to copy and stays valid as long as the world that created it exists.
+    template<typename... Ts>
+    class View {
+        const ArchetypeQuery* query;
+    public:
+        explicit View(const ArchetypeQuery* query) : query(query) {}
+
+        // This calls "function(entity, componentA, componentB, ...)" for every live entity in the view
+        // The components are visited archetype by archetype, walking the packed component columns row by row.
+        // WARNING: Don't add or remove components or entities inside "function" since this moves rows around.
+        template<typename Function>
+        void forEach(Function&& function) const {
+            for(Archetype* archetype : query->matches){
+                size_t count = archetype->getLiveCount();
+                if(count == 0) continue;
+                auto columns = std::make_tuple(archetype->getColumn<Ts>()...);
+                for(size_t row = 0; row < count; ++row){
+                    std::apply([&](auto*... column){
+                        function(archetype->getEntity(row), column->get(row)...);
+                    }, columns);
+                }
+            }
+        }
+
+        // This is the same as "forEach" except that the rows of each archetype are split into chunks of "grainSize" rows
+        // which are processed in parallel on the job system. It returns after all the entities have been visited.
+        // WARNING: "function" is called from multiple threads at the same time, so it should only modify the entity and the components it receives.
+        template<typename Function>
+        void forEachParallel(Function&& function, size_t grainSize = PARALLEL_VIEW_GRAIN_SIZE) const {
+            JobSystem& jobs = JobSystem::getInstance();
+            for(Archetype* archetype : query->matches){
+                size_t count = archetype->getLiveCount();
+                if(count == 0) continue;
+                auto columns = std::make_tuple(archetype->getColumn<Ts>()...);
+                jobs.parallelFor(count, grainSize, [&](size_t begin, size_t end){
+                    for(size_t row = begin; row < end; ++row){
+                        std::apply([&](auto*... column){
+                            function(archetype->getEntity(row), column->get(row)...);
+                        }, columns);
+                    }
+                });
+            }
+        }
+
+        // This calls "function(entity, componentA, componentB, ...)" for the live entities whose position in the view is in [begin, end)
+        // The position of an entity is its index when the archetypes of the view are visited in order (as done by "forEach").
+        // It is used to split a view into ranges that can be processed independently (see "JobSystem::parallelFor").
+        template<typename Function>
+        void forEachInRange(size_t begin, size_t end, Function&& function) const {
+            size_t offset = 0; // The position of the first row of the current archetype
+            for(Archetype* archetype : query->matches){
+                if(offset >= end) break;
+                size_t count = archetype->getLiveCount();
+                if(offset + count > begin){
+                    size_t first = begin > offset ? begin - offset : 0;
+                    size_t last = std::min(count, end - offset);
+                    auto columns = std::make_tuple(archetype->getColumn<Ts>()...);
+                    for(size_t row = first; row < last; ++row){
+                        std::apply([&](auto*... column){
+                            function(archetype->getEntity(row), column->get(row)...);
+                        }, columns);
+                    }
+                }
+                offset += count;
+            }
+        }
+
+        // Returns the number of live entities in the view
+        size_t size() const {
+            size_t count = 0;
+            for(Archetype* archetype : query->matches) count += archetype->getLiveCount();
+            return count;
+        }
+
+        // Returns true if no live entity holds all the component types Ts...
+        bool empty() const {
+            for(Archetype* archetype : query->matches) {
+                if(archetype->getLiveCount() != 0) return false;
+            }
+            return true;
+        }
+    };
+
+}
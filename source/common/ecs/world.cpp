@@ -1,4 +1,16 @@
 #include "world.hpp"
+#include "transform-kernel.hpp"
+#include "../jobs/job-system.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <memory>
+#include <new>
+
+// The number of entities of a hierarchy level updated by each job (smaller levels are updated on the calling thread)
+#define PARALLEL_TRANSFORM_GRAIN_SIZE 2048
+// The maximum number of changed entities whose matrices are computed together by the transform kernel
+#define TRANSFORM_BATCH_SIZE 64
 
 namespace our {
 
@@ -9,11 +21,217 @@ namespace our {
         if(!data.is_array()) return;
         for(const auto& entityData : data){
             Entity* entity = add();
-            entity->parent = parent;
+            entity->setParent(parent);
             entity->deserialize(entityData);
             if(entityData.contains("children"))
                 this->deserialize(entityData["children"], entity);
         }
     }
 
-}
\ No newline at end of file
+    // This adds an entity in a free slot (or a new one) and returns a pointer to that entity
+    Entity* World::add() {
+        std::uint32_t index;
+        if(firstFreeSlot != NO_SLOT) {
+            // Reuse the slot that has been free for the longest time
+            index = firstFreeSlot;
+            firstFreeSlot = slots[index].nextFree;
+            if(firstFreeSlot == NO_SLOT) lastFreeSlot = NO_SLOT;
+        } else {
+            index = static_cast<std::uint32_t>(slots.size());
+            assert(index < EntityHandle::MAX_ENTITIES && "Too many entities");
+            if(index % ENTITY_BLOCK_SIZE == 0) entityBlocks.push_back(std::allocator<Entity>().allocate(ENTITY_BLOCK_SIZE));
+            slots.emplace_back();
+        }
+        EntitySlot& slot = slots[index];
+        Entity* entity = new (entityBlocks[index / ENTITY_BLOCK_SIZE] + index % ENTITY_BLOCK_SIZE) Entity();
+        slot.entity = entity;
+        slot.nextFree = NO_SLOT;
+        entity->world = this;
+        entity->handle = EntityHandle(index, slot.generation);
+        entity->archetype = archetypes.getEmpty();
+        entity->row = entity->archetype->pushRow(entity);
+        entities.push_back(entity);
+        if(dirtyEntities.size() < entities.size()) dirtyEntities.resize(entities.capacity());
+        entity->markTransformDirty();
+        hierarchyChanged = true;
+        return entity;
+    }
+
+    // This adds a copy of the given entity and returns a pointer to the copy
+    Entity* World::addCopyOf(const Entity* source, Entity* parent) {
+        Entity* entity = add();
+        entity->name = source->name;
+        entity->setLocalTransform(source->localTransform);
+        entity->setParent(parent);
+        entity->copyComponentsFrom(source);
+        return entity;
+    }
+
+    // Destroys the entity and releases its slot
+    void World::destroy(Entity* entity) {
+        std::uint32_t index = entity->handle.getIndex();
+        EntitySlot& slot = slots[index];
+        // Incrementing the generation invalidates all the handles that refer to this entity
+        slot.generation = (slot.generation + 1) & EntityHandle::GENERATION_MASK;
+        slot.entity = nullptr;
+        entity->~Entity();
+        // Append the slot to the end of the free queue
+        if(lastFreeSlot != NO_SLOT) slots[lastFreeSlot].nextFree = index;
+        else firstFreeSlot = index;
+        lastFreeSlot = index;
+    }
+
+    // This removes the elements in "markedForRemoval" from the "entities" list then deletes them
+    void World::deleteMarkedEntities() {
+        if(markedForRemoval.empty()) return;
+        auto isMarked = [](Entity* entity){ return entity->archetype->isMarked(entity->row); };
+        // The marked entities are removed from the entities list in a single pass that keeps the creation order
+        entities.erase(std::remove_if(entities.begin(), entities.end(), isMarked), entities.end());
+        // and from the lists of the transform updates
+        Entity** dirtyBegin = dirtyEntities.data();
+        dirtyCount = std::remove_if(dirtyBegin, dirtyBegin + dirtyCount, isMarked) - dirtyBegin;
+        for(auto& level : updatedLevels){
+            level.erase(std::remove_if(level.begin(), level.end(), isMarked), level.end());
+        }
+        for(auto entity : markedForRemoval){
+            destroy(entity);
+        }
+        markedForRemoval.clear();
+        hierarchyChanged = true;
+    }
+
+    // This deletes all entities in the world
+    void World::clear() {
+        for(auto entity : entities){
+            destroy(entity);
+        }
+        entities.clear();
+        markedForRemoval.clear();
+        dirtyCount = 0;
+        updatedLevels.clear();
+        hierarchyChanged = true;
+    }
+
+    World::~World() {
+        clear();
+        for(auto block : entityBlocks){
+            std::allocator<Entity>().deallocate(block, ENTITY_BLOCK_SIZE);
+        }
+    }
+
+    // Computes the depth of the entities in the hierarchy and the lists of their children
+    void World::rebuildHierarchy() {
+        // Since we only know the parent of each entity, we walk up the parents to compute the depth
+        // Entities are visited from the root down so that each entity only needs its parent's depth
+        std::vector<Entity*> chain;
+        std::vector<bool> visited(slots.size(), false); // Indexed by the slot index of the entity
+        for(auto entity : entities){
+            Entity* current = entity;
+            while(current != nullptr && !visited[current->handle.getIndex()]){
+                chain.push_back(current);
+                current = current->getParent();
+            }
+            while(!chain.empty()){
+                current = chain.back();
+                chain.pop_back();
+                Entity* parent = current->getParent();
+                if(parent == nullptr && !current->parent.isNull()){
+                    // The parent was deleted, so this entity becomes a root and its matrix must be recomputed
+                    current->parent = EntityHandle();
+                    current->markTransformDirty();
+                }
+                current->depth = parent ? parent->depth + 1 : 0;
+                visited[current->handle.getIndex()] = true;
+            }
+        }
+        // The children are grouped by parent: count the children of each slot, then place each child after its older siblings
+        childOffsets.assign(slots.size() + 1, 0);
+        for(auto entity : entities){
+            if(Entity* parent = entity->getParent()) childOffsets[parent->handle.getIndex() + 1]++;
+        }
+        for(size_t index = 1; index < childOffsets.size(); ++index) childOffsets[index] += childOffsets[index - 1];
+        childEntities.resize(childOffsets.back());
+        std::vector<std::uint32_t> nextChild(childOffsets.begin(), childOffsets.end() - 1);
+        for(auto entity : entities){
+            if(Entity* parent = entity->getParent()) childEntities[nextChild[parent->handle.getIndex()]++] = entity;
+        }
+        hierarchyChanged = false;
+    }
+
+    // Recomputes the matrices of the given entities of a hierarchy level
+    // The entities are gathered into batches which are converted to matrices by the SIMD transform kernel
+    void World::updateTransformRange(Entity* const* entities, size_t count) {
+        Entity* changed[TRANSFORM_BATCH_SIZE];
+        glm::vec3 positions[TRANSFORM_BATCH_SIZE];
+        glm::quat rotations[TRANSFORM_BATCH_SIZE];
+        glm::vec3 scales[TRANSFORM_BATCH_SIZE];
+        glm::mat4 matrices[TRANSFORM_BATCH_SIZE];
+        glm::mat3 normalMatrices[TRANSFORM_BATCH_SIZE];
+        size_t index = 0;
+        while(index < count) {
+            size_t batchSize = 0;
+            for(; index < count && batchSize < TRANSFORM_BATCH_SIZE; ++index) {
+                Entity* entity = entities[index];
+                changed[batchSize] = entity;
+                positions[batchSize] = entity->localTransform.position;
+                rotations[batchSize] = entity->localTransform.getRotationQuaternion();
+                scales[batchSize] = entity->localTransform.scale;
+                ++batchSize;
+            }
+            if(batchSize == 0) continue;
+            transform_kernel::composeMatrices(batchSize, positions, rotations, scales, matrices);
+            for(size_t batchIndex = 0; batchIndex < batchSize; ++batchIndex) {
+                if(Entity* parent = changed[batchIndex]->getParent(); parent) {
+                    matrices[batchIndex] = transform_kernel::multiply(parent->getLocalToWorldMatrix(), matrices[batchIndex]);
+                }
+            }
+            transform_kernel::computeNormalMatrices(batchSize, matrices, normalMatrices);
+            for(size_t batchIndex = 0; batchIndex < batchSize; ++batchIndex) {
+                changed[batchIndex]->localToWorld = matrices[batchIndex];
+                changed[batchIndex]->normalMatrix = normalMatrices[batchIndex];
+            }
+        }
+    }
+
+    // This recomputes the cached local to world matrices of the dirty entities and their descendants level by level
+    void World::updateTransforms() {
+        if(hierarchyChanged) rebuildHierarchy();
+        // The matrices updated by the last update are not new anymore
+        for(auto& level : updatedLevels){
+            for(auto entity : level) entity->localToWorldChanged = false;
+            level.clear();
+        }
+        // The dirty entities are grouped by their depth, so the parents are always updated before their children
+        size_t count = dirtyCount;
+        for(size_t index = 0; index < count; ++index){
+            Entity* entity = dirtyEntities[index];
+            if(updatedLevels.size() <= entity->depth) updatedLevels.resize(entity->depth + 1);
+            updatedLevels[entity->depth].push_back(entity);
+        }
+        dirtyCount = 0;
+        JobSystem& jobs = JobSystem::getInstance();
+        for(size_t depth = 0; depth < updatedLevels.size(); ++depth){
+            if(updatedLevels[depth].empty()) continue;
+            if(updatedLevels.size() == depth + 1) updatedLevels.emplace_back();
+            std::vector<Entity*>& level = updatedLevels[depth];
+            std::vector<Entity*>& nextLevel = updatedLevels[depth + 1];
+            // Entities in the same level don't depend on each other, so the level is split into chunks that are updated in parallel
+            jobs.parallelFor(level.size(), PARALLEL_TRANSFORM_GRAIN_SIZE, [&level](size_t begin, size_t end){
+                updateTransformRange(level.data() + begin, end - begin);
+            });
+            // The children of the updated entities must be updated too (unless they are already dirty)
+            for(auto entity : level){
+                entity->transformDirty = false;
+                entity->localToWorldChanged = true;
+                std::uint32_t slot = entity->handle.getIndex();
+                for(std::uint32_t child = childOffsets[slot]; child < childOffsets[slot + 1]; ++child){
+                    Entity* childEntity = childEntities[child];
+                    if(childEntity->transformDirty) continue;
+                    childEntity->transformDirty = true;
+                    nextLevel.push_back(childEntity);
+                }
+            }
+        }
+    }
+
+}
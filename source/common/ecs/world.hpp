@@ -1,15 +1,60 @@
 #pragma once
 
-#include <unordered_set>
+#include <atomic>
+#include <cstdint>
+#include <vector>
+#include <utility>
 #include "entity.hpp"
+#include "view.hpp"
 
 namespace our {
 
+    // The number of entities in each block of the entity storage
+    #define ENTITY_BLOCK_SIZE 1024
+
     // This class holds a set of entities
+    // The entities are stored in a slot map: each entity lives in a slot of a block of ENTITY_BLOCK_SIZE entities,
+    // so creating and destroying entities reuses the memory of the destroyed entities instead of allocating,
+    // and an entity never moves while it is alive. Entities can be referred to by a generational "EntityHandle"
+    // which (unlike a pointer) can be safely checked after the entity has been destroyed.
     class World {
-        std::unordered_set<Entity*> entities; // These are the entities held by this world
-        std::unordered_set<Entity*> markedForRemoval; // These are the entities that are awaiting to be deleted
-                                                      // when deleteMarkedEntities is called
+        // A slot of the entity storage
+        struct EntitySlot {
+            Entity* entity = nullptr; // The entity currently living in the slot (null if the slot is free)
+            std::uint32_t generation = 0; // Incremented every time the entity living in the slot is destroyed
+            std::uint32_t nextFree = NO_SLOT; // If the slot is free, this is the index of the next free slot
+        };
+        static constexpr std::uint32_t NO_SLOT = 0xFFFFFFFFu;
+
+        ArchetypeStorage archetypes; // This holds the components of all the entities grouped by their component types
+        std::vector<Entity*> entityBlocks; // The memory blocks in which the entities are constructed
+        std::vector<EntitySlot> slots; // The slots of the entity storage (indexed by the handle index)
+        std::uint32_t firstFreeSlot = NO_SLOT, lastFreeSlot = NO_SLOT; // The free slots form a FIFO queue, so the generations of
+                                                                        // a slot are spread over time and stale handles are caught longer
+        std::vector<Entity*> entities; // These are the entities held by this world in the order of their creation
+        std::vector<Entity*> markedForRemoval; // These are the entities that are awaiting to be deleted
+                                               // when deleteMarkedEntities is called
+        // The entities whose transform was marked dirty since the last transform update are the first "dirtyCount" elements
+        // of "dirtyEntities", which has room for every entity (an entity is added once, when its "transformDirty" flag is set).
+        // The count is atomic since the transforms of different entities can be edited by the jobs of a system.
+        std::vector<Entity*> dirtyEntities;
+        std::atomic<size_t> dirtyCount{0};
+        // The children of the entity in the slot i are childEntities[childOffsets[i]] to childEntities[childOffsets[i + 1] - 1]
+        std::vector<std::uint32_t> childOffsets;
+        std::vector<Entity*> childEntities;
+        std::vector<std::vector<Entity*>> updatedLevels; // The entities updated by the last transform update grouped by their depth
+        bool hierarchyChanged = true; // If true, the depths and the children lists have to be rebuilt before the next transform update
+
+        friend Entity; // The entity tells the world when its parent changes
+
+        // Destroys the entity and releases its slot
+        void destroy(Entity* entity);
+
+        // Computes the depth of the entities in the hierarchy and the lists of their children
+        void rebuildHierarchy();
+
+        // Recomputes the matrices of the given entities (which must belong to the same hierarchy level)
+        static void updateTransformRange(Entity* const* entities, size_t count);
     public:
 
         World() = default;
@@ -19,53 +64,94 @@ namespace our {
         // If any of the entities has children, this function will be called recursively for these children
         void deserialize(const nlohmann::json& data, Entity* parent = nullptr);
 
-        // This adds an entity to the entities set and returns a pointer to that entity
+        // This adds an entity to the entities list and returns a pointer to that entity
         // WARNING The entity is owned by this world so don't use "delete" to delete it, instead, call "markForRemoval"
-        // to put it in the "markedForRemoval" set. The elements in the "markedForRemoval" set will be removed and
+        // to put it in the "markedForRemoval" list. The elements in the "markedForRemoval" list will be removed and
         // deleted when "deleteMarkedEntities" is called.
-        Entity* add() {
-            Entity* entity = new Entity();
-            entity->world = this;
-            entities.insert(entity);
-            return entity;
+        Entity* add();
+
+        // This adds a copy of the given entity (its name, local transform and components) and returns a pointer to the copy
+        // The source entity may belong to another world (this is how prefabs are instantiated) and its parent is not copied,
+        // instead, the parent of the copy is set to the given parent.
+        Entity* addCopyOf(const Entity* source, Entity* parent = nullptr);
+
+        // This returns the entity referred to by the given handle
+        // If the entity has been deleted (or the handle is null), it returns a nullptr
+        Entity* get(EntityHandle handle) const {
+            if(handle.isNull() || handle.getIndex() >= slots.size()) return nullptr;
+            const EntitySlot& slot = slots[handle.getIndex()];
+            return slot.generation == handle.getGeneration() ? slot.entity : nullptr;
         }
 
-        // This returns and immutable reference to the set of all entites in the world.
-        const std::unordered_set<Entity*>& getEntities() {
+        // This returns and immutable reference to the list of all entites in the world (in the order of their creation).
+        const std::vector<Entity*>& getEntities() {
             return entities;
         }
 
-        // This marks an entity for removal by adding it to the "markedForRemoval" set.
-        // The elements in the "markedForRemoval" set will be removed and deleted when "deleteMarkedEntities" is called.
-        void markForRemoval(Entity* entity){
-            if(entities.find(entity) != entities.end())
-                markedForRemoval.insert(entity);
+        // This returns a view over all the entities that have all the components Ts...
+        // The view is cached by the world and updated incrementally, so iterating over it costs nothing for the entities that don't match.
+        template<typename... Ts>
+        View<Ts...> view() {
+            return View<Ts...>(archetypes.getQuery(componentMaskOf<Ts...>()));
         }
 
-        // This removes the elements in "markedForRemoval" from the "entities" set.
-        // Then each of these elements are deleted.
-        void deleteMarkedEntities(){
-            for(auto entity: markedForRemoval){
-                entities.erase(entity);
-                delete entity;
-            }
-            markedForRemoval.clear();
+        // This calls "function(entity, componentA, componentB, ...)" for every entity that has all the components Ts...
+        // It is a shorthand for "view<Ts...>().forEach(function)"
+        template<typename... Ts, typename Function>
+        void forEach(Function&& function) {
+            view<Ts...>().forEach(std::forward<Function>(function));
         }
 
-        //This deletes all entities in the world
-        void clear(){
-            for(auto entity: entities){
-                delete entity;
+        // This is a shorthand for "view<Ts...>().forEachParallel(function)"
+        // The entities are visited in parallel chunks, so "function" must only modify the entity and the components it receives
+        template<typename... Ts, typename Function>
+        void forEachParallel(Function&& function) {
+            view<Ts...>().forEachParallel(std::forward<Function>(function));
+        }
+
+        // This returns the allocation counters of the pool that holds the components of type T
+        // It can be used to check that no component memory is allocated from the heap during steady-state gameplay
+        template<typename T>
+        ComponentPoolStats getComponentPoolStats() const {
+            return archetypes.getPoolStats(componentTypeID<T>);
+        }
+
+        // This returns the sum of the allocation counters of all the component pools
+        ComponentPoolStats getComponentPoolStats() const {
+            return archetypes.getPoolStats();
+        }
+
+        // This marks an entity for removal by adding it to the "markedForRemoval" list.
+        // The elements in the "markedForRemoval" list will be removed and deleted when "deleteMarkedEntities" is called.
+        // The entity is excluded from all the views right away.
+        void markForRemoval(Entity* entity){
+            if(entity && entity->world == this && !entity->archetype->isMarked(entity->row)){
+                entity->row = entity->archetype->markRow(entity->row);
+                markedForRemoval.push_back(entity);
             }
-            entities.clear();
-            markedForRemoval.clear();
         }
 
-        //Since the world owns all of its entities, they should be deleted alongside it.
-        ~World(){
-            clear();
+        // This marks the entity referred to by the given handle for removal (if it still exists)
+        void markForRemoval(EntityHandle handle){
+            markForRemoval(get(handle));
         }
 
+        // This removes the elements in "markedForRemoval" from the "entities" list.
+        // Then each of these elements are deleted and their slots are released to be reused by new entities.
+        void deleteMarkedEntities();
+
+        // This recomputes the cached local to world matrices of the entities marked dirty (see "Entity::editLocalTransform")
+        // and of their descendants. Only these entities are visited, so the cost doesn't grow with the untouched entities.
+        // The entities are updated level by level (parents before children). Large levels are split into jobs on the job system.
+        // This should be called once per frame after all the systems that modify the transforms.
+        void updateTransforms();
+
+        //This deletes all entities in the world
+        void clear();
+
+        //Since the world owns all of its entities, they should be deleted alongside it.
+        ~World();
+
         // The world should not be copyable
         World(const World&) = delete;
         World &operator=(World const &) = delete;
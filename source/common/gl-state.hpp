@@ -0,0 +1,173 @@
+#pragma once
+
+#include <glad/gl.h>
+#include <glm/glm.hpp>
+#include <cstdint>
+
+// The number of texture units whose bindings are shadowed (the bindings of the other units are always issued)
+#define GL_STATE_TEXTURE_UNIT_COUNT 16
+
+namespace our {
+
+    // The number of OpenGL calls that went through the state cache
+    struct GLStateStats {
+        std::uint64_t issuedCalls = 0; // The calls that were sent to OpenGL since they changed the state
+        std::uint64_t skippedCalls = 0; // The calls that were dropped since the state already had the requested value
+    };
+
+    // This class shadows the OpenGL state that changes between draws (the program, the vertex array, the textures and samplers
+    // of each unit, the blending, depth and culling options and the masks) and only calls OpenGL when a value actually changes.
+    // Every part of the state starts as unknown, so the first call after "invalidate" is always issued.
+    // WARNING: Code that changes this state without going through the cache must call "invalidate" afterwards.
+    // The renderer invalidates the cache at the start of every frame, so the state changed between frames (by loading assets
+    // or drawing the GUI for example) is never trusted.
+    class GLStateCache {
+        // The value stored for a part of the state whose value is not known
+        static constexpr GLuint UNKNOWN = 0xFFFFFFFFu;
+        // The shadowed texture targets of each unit
+        enum TextureTarget { TEXTURE_2D, TEXTURE_BUFFER, TEXTURE_TARGET_COUNT };
+
+        GLuint program, vertexArray, activeTextureUnit;
+        GLuint textures[GL_STATE_TEXTURE_UNIT_COUNT][TEXTURE_TARGET_COUNT];
+        GLuint samplers[GL_STATE_TEXTURE_UNIT_COUNT];
+        GLuint cullFaceEnabled, depthTestEnabled, blendEnabled; // Booleans (or UNKNOWN)
+        GLuint culledFace, frontFace, depthFunction, depthMask, colorMask;
+        GLuint blendEquation, blendSourceFactor, blendDestinationFactor;
+        glm::vec4 blendColor;
+        bool blendColorKnown;
+
+        GLStateStats stats, lastFrameStats;
+
+        // Returns true (and counts an issued call) if the shadowed value differs from the given one, then stores the given value
+        bool change(GLuint& shadow, GLuint value) {
+            if(shadow == value) { stats.skippedCalls++; return false; }
+            shadow = value;
+            stats.issuedCalls++;
+            return true;
+        }
+
+        static int getTargetIndex(GLenum target) {
+            switch(target){
+                case GL_TEXTURE_2D: return TEXTURE_2D;
+                case GL_TEXTURE_BUFFER: return TEXTURE_BUFFER;
+                default: return -1;
+            }
+        }
+
+        void setCapability(GLuint& shadow, GLenum capability, bool enabled) {
+            if(change(shadow, enabled)) {
+                if(enabled) glEnable(capability); else glDisable(capability);
+            }
+        }
+
+        GLStateCache() { invalidate(); }
+
+    public:
+        // Returns the cache of the OpenGL context (the application has a single context)
+        static GLStateCache& getInstance() {
+            static GLStateCache instance;
+            return instance;
+        }
+
+        // Forgets the whole shadowed state, so the next call for each part of the state is issued
+        void invalidate() {
+            program = vertexArray = activeTextureUnit = UNKNOWN;
+            for(auto& unit : textures) for(auto& texture : unit) texture = UNKNOWN;
+            for(auto& sampler : samplers) sampler = UNKNOWN;
+            cullFaceEnabled = depthTestEnabled = blendEnabled = UNKNOWN;
+            culledFace = frontFace = depthFunction = depthMask = colorMask = UNKNOWN;
+            blendEquation = blendSourceFactor = blendDestinationFactor = UNKNOWN;
+            blendColorKnown = false;
+        }
+
+        // Should be called at the start of every frame: it keeps the counters of the previous frame and invalidates the state
+        void beginFrame() {
+            lastFrameStats = stats;
+            stats = GLStateStats();
+            invalidate();
+        }
+
+        // Returns the counters of the current frame (so far) and of the previous frame
+        const GLStateStats& getStats() const { return stats; }
+        const GLStateStats& getLastFrameStats() const { return lastFrameStats; }
+
+        void useProgram(GLuint name) {
+            if(change(program, name)) glUseProgram(name);
+        }
+
+        void bindVertexArray(GLuint name) {
+            if(change(vertexArray, name)) glBindVertexArray(name);
+        }
+
+        void setActiveTextureUnit(GLuint unit) {
+            if(change(activeTextureUnit, unit)) glActiveTexture(GL_TEXTURE0 + unit);
+        }
+
+        // Binds the texture to the given target of the given unit (the active unit is changed only if the binding changes)
+        void bindTexture(GLuint unit, GLenum target, GLuint name) {
+            int targetIndex = getTargetIndex(target);
+            if(unit < GL_STATE_TEXTURE_UNIT_COUNT && targetIndex >= 0) {
+                GLuint& shadow = textures[unit][targetIndex];
+                if(shadow == name) { stats.skippedCalls++; return; }
+                shadow = name;
+            }
+            setActiveTextureUnit(unit);
+            glBindTexture(target, name);
+            stats.issuedCalls++;
+        }
+
+        void bindSampler(GLuint unit, GLuint name) {
+            if(unit >= GL_STATE_TEXTURE_UNIT_COUNT) { glBindSampler(unit, name); stats.issuedCalls++; return; }
+            if(change(samplers[unit], name)) glBindSampler(unit, name);
+        }
+
+        void setFaceCulling(bool enabled) { setCapability(cullFaceEnabled, GL_CULL_FACE, enabled); }
+        void setDepthTesting(bool enabled) { setCapability(depthTestEnabled, GL_DEPTH_TEST, enabled); }
+        void setBlending(bool enabled) { setCapability(blendEnabled, GL_BLEND, enabled); }
+
+        void setCulledFace(GLenum face) {
+            if(change(culledFace, face)) glCullFace(face);
+        }
+
+        void setFrontFace(GLenum winding) {
+            if(change(frontFace, winding)) glFrontFace(winding);
+        }
+
+        void setDepthFunction(GLenum function) {
+            if(change(depthFunction, function)) glDepthFunc(function);
+        }
+
+        void setDepthMask(bool enabled) {
+            if(change(depthMask, enabled)) glDepthMask(enabled);
+        }
+
+        void setColorMask(glm::bvec4 mask) {
+            GLuint packed = GLuint(mask.r) | (GLuint(mask.g) << 1) | (GLuint(mask.b) << 2) | (GLuint(mask.a) << 3);
+            if(change(colorMask, packed)) glColorMask(mask.r, mask.g, mask.b, mask.a);
+        }
+
+        void setBlendEquation(GLenum equation) {
+            if(change(blendEquation, equation)) glBlendEquation(equation);
+        }
+
+        void setBlendFunction(GLenum sourceFactor, GLenum destinationFactor) {
+            if(blendSourceFactor == sourceFactor && blendDestinationFactor == destinationFactor) { stats.skippedCalls++; return; }
+            blendSourceFactor = sourceFactor;
+            blendDestinationFactor = destinationFactor;
+            glBlendFunc(sourceFactor, destinationFactor);
+            stats.issuedCalls++;
+        }
+
+        void setBlendColor(const glm::vec4& color) {
+            if(blendColorKnown && blendColor == color) { stats.skippedCalls++; return; }
+            blendColor = color;
+            blendColorKnown = true;
+            glBlendColor(color.r, color.g, color.b, color.a);
+            stats.issuedCalls++;
+        }
+
+        GLStateCache(const GLStateCache&) = delete;
+        GLStateCache& operator=(const GLStateCache&) = delete;
+    };
+
+}
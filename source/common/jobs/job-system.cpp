@@ -0,0 +1,103 @@
+#include "job-system.hpp"
+
+#include <algorithm>
+
+namespace our {
+
+    // The job system that owns the calling thread (null for the threads that are not workers)
+    static thread_local const JobSystem* currentJobSystem = nullptr;
+    // The index of the queue owned by the calling thread inside "currentJobSystem"
+    static thread_local size_t currentQueueIndex = 0;
+
+    JobSystem::JobSystem(size_t workerCount) {
+        for(size_t index = 0; index <= workerCount; ++index) {
+            queues.push_back(std::make_unique<JobQueue>());
+        }
+        for(size_t index = 1; index <= workerCount; ++index) {
+            workers.emplace_back(&JobSystem::workerLoop, this, index);
+        }
+    }
+
+    JobSystem::~JobSystem() {
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            stopping = true;
+        }
+        wakeUp.notify_all();
+        for(auto& worker : workers) worker.join();
+    }
+
+    JobSystem& JobSystem::getInstance() {
+        static JobSystem instance(std::max(1u, std::thread::hardware_concurrency()) - 1);
+        return instance;
+    }
+
+    size_t JobSystem::getCurrentQueue() const {
+        return currentJobSystem == this ? currentQueueIndex : 0;
+    }
+
+    void JobSystem::run(JobGroup& group, std::function<void()> job) {
+        group.pending.fetch_add(1, std::memory_order_relaxed);
+        {
+            // The counter is incremented under the sleep mutex (and before the job is visible) so that
+            // a worker can't miss the notification and the counter never goes below zero
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            queuedJobs.fetch_add(1, std::memory_order_relaxed);
+        }
+        JobQueue& queue = *queues[getCurrentQueue()];
+        {
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            queue.jobs.push_back({std::move(job), &group});
+        }
+        wakeUp.notify_one();
+    }
+
+    bool JobSystem::runOne(size_t queueIndex) {
+        Job job;
+        bool found = false;
+        // First, we try to pop the newest job from our own queue
+        {
+            JobQueue& queue = *queues[queueIndex];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if(!queue.jobs.empty()) {
+                job = std::move(queue.jobs.back());
+                queue.jobs.pop_back();
+                found = true;
+            }
+        }
+        // Otherwise, we steal the oldest job from the other queues
+        for(size_t offset = 1; !found && offset < queues.size(); ++offset) {
+            JobQueue& queue = *queues[(queueIndex + offset) % queues.size()];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if(!queue.jobs.empty()) {
+                job = std::move(queue.jobs.front());
+                queue.jobs.pop_front();
+                found = true;
+            }
+        }
+        if(!found) return false;
+        queuedJobs.fetch_sub(1, std::memory_order_relaxed);
+        job.function();
+        job.group->pending.fetch_sub(1, std::memory_order_release);
+        return true;
+    }
+
+    void JobSystem::wait(JobGroup& group) {
+        size_t queueIndex = getCurrentQueue();
+        while(!group.isDone()) {
+            if(!runOne(queueIndex)) std::this_thread::yield();
+        }
+    }
+
+    void JobSystem::workerLoop(size_t queueIndex) {
+        currentJobSystem = this;
+        currentQueueIndex = queueIndex;
+        while(true) {
+            if(runOne(queueIndex)) continue;
+            std::unique_lock<std::mutex> lock(sleepMutex);
+            wakeUp.wait(lock, [this](){ return stopping || queuedJobs.load(std::memory_order_relaxed) > 0; });
+            if(stopping && queuedJobs.load(std::memory_order_relaxed) == 0) return;
+        }
+    }
+
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace our {
+
+    class JobSystem; // A forward declaration of the JobSystem Class
+
+    // A job group counts the jobs that were submitted to it and did not finish yet
+    // It is used to wait for a batch of jobs (see "JobSystem::wait")
+    class JobGroup {
+        std::atomic<size_t> pending{0}; // The number of unfinished jobs in this group
+        friend JobSystem;
+    public:
+        JobGroup() = default;
+
+        // Returns true if all the jobs submitted to this group have finished
+        bool isDone() const { return pending.load(std::memory_order_acquire) == 0; }
+
+        JobGroup(const JobGroup&) = delete;
+        JobGroup& operator=(const JobGroup&) = delete;
+    };
+
+    // A work-stealing thread pool.
+    // Every worker thread owns a queue of jobs. A worker pushes and pops the jobs it creates at the back of its own queue
+    // (so nested jobs run while their data is still in the cache) and, when its queue is empty, it steals the oldest job
+    // from the front of another queue. Threads that are not workers (such as the main thread) share an extra queue.
+    // A thread that waits for a group doesn't sleep: it keeps running jobs until the group is done.
+    class JobSystem {
+        struct Job {
+            std::function<void()> function;
+            JobGroup* group;
+        };
+
+        struct JobQueue {
+            std::mutex mutex;
+            std::deque<Job> jobs;
+        };
+
+        std::vector<std::unique_ptr<JobQueue>> queues; // Queue 0 is shared by the threads that are not workers, queue i belongs to worker i
+        std::vector<std::thread> workers;
+
+        std::mutex sleepMutex; // Used with "wakeUp" to put the idle workers to sleep
+        std::condition_variable wakeUp;
+        std::atomic<size_t> queuedJobs{0}; // The number of jobs waiting in all the queues
+        bool stopping = false; // Set when the job system is destroyed to stop the workers
+
+        // Returns the index of the queue owned by the calling thread
+        size_t getCurrentQueue() const;
+
+        // Runs one job from the given queue, or steals one from another queue. Returns false if no job was found.
+        bool runOne(size_t queueIndex);
+
+        // The loop executed by every worker thread
+        void workerLoop(size_t queueIndex);
+    public:
+        // Creates a job system with the given number of worker threads (the threads that call "wait" help the workers)
+        explicit JobSystem(size_t workerCount);
+
+        // Finishes the queued jobs then stops and joins the workers
+        ~JobSystem();
+
+        // Returns the job system shared by the whole engine
+        // It is created on first use with one worker per hardware thread except the calling thread
+        static JobSystem& getInstance();
+
+        // Returns the number of worker threads
+        size_t getWorkerCount() const { return workers.size(); }
+
+        // Submits a job to be executed by any thread and adds it to the given group
+        void run(JobGroup& group, std::function<void()> job);
+
+        // Blocks until all the jobs of the group have finished. The calling thread runs queued jobs while waiting.
+        void wait(JobGroup& group);
+
+        // Splits the range [0, count) into chunks of at most "grainSize" elements and calls "function(begin, end)" for each chunk.
+        // The chunks run in parallel and the function returns after all of them finished.
+        // Small ranges (up to one chunk) are executed directly on the calling thread.
+        template<typename Function>
+        void parallelFor(size_t count, size_t grainSize, Function&& function) {
+            if(grainSize == 0) grainSize = 1;
+            if(count <= grainSize || workers.empty()) {
+                if(count > 0) function(size_t(0), count);
+                return;
+            }
+            JobGroup group;
+            // The first chunk is kept for the calling thread while the others are submitted
+            for(size_t begin = grainSize; begin < count; begin += grainSize) {
+                size_t end = std::min(begin + grainSize, count);
+                run(group, [&function, begin, end](){ function(begin, end); });
+            }
+            function(size_t(0), grainSize);
+            wait(group);
+        }
+
+        JobSystem(const JobSystem&) = delete;
+        JobSystem& operator=(const JobSystem&) = delete;
+    };
+
+}
@@ -12,10 +12,25 @@
 
 namespace our {
 
+    // The handles of the uniforms set by the materials (their locations are resolved once per shader program)
+    static const UniformHandle tintUniform("tint");
+    static const UniformHandle alphaThresholdUniform("alphaThreshold");
+    static const UniformHandle texUniform("tex");
+    static const UniformHandle albedoTintUniform("material.albedo_tint");
+    static const UniformHandle specularTintUniform("material.specular_tint");
+    static const UniformHandle roughnessRangeUniform("material.roughness_range");
+    static const UniformHandle emissiveTintUniform("material.emissive_tint");
+    static const UniformHandle alphaThresholdMaterialUniform("material.alpha_threshold");
+    static const UniformHandle albedoMapUniform("material.albedo_map");
+    static const UniformHandle specularMapUniform("material.specular_map");
+    static const UniformHandle ambientOcclusionMapUniform("material.ambient_occlusion_map");
+    static const UniformHandle roughnessMapUniform("material.roughness_map");
+    static const UniformHandle emissiveMapUniform("material.emissive_map");
+
     // This function should setup the pipeline state and set the shader to be used
-    void Material::setup() const {
+    void Material::setup(bool instanced) const {
         pipelineState.setup();
-        shader->use();
+        getShader(instanced)->use();
     }
 
     // This function read the material data from a json object
@@ -25,15 +40,21 @@ namespace our {
         if(data.contains("pipelineState")){
             pipelineState.deserialize(data["pipelineState"]);
         }
-        shader = AssetLoader<ShaderProgram>::get(data["shader"].get<std::string>());
+        std::string shaderName = data["shader"].get<std::string>();
+        // The materials with the same defines share the same variant of the shader
+        ShaderDefines defines = getShaderDefines(data);
+        shader = getShaderVariant(shaderName, defines);
+        // The instanced variant of a shader is found by the naming convention "<shader>-instanced" unless it is given explicitly
+        instancedShader = getShaderVariant(data.value("instancedShader", shaderName + "-instanced"), defines);
         transparent = data.value("transparent", false);
     }
 
     // This function should call the setup of its parent and
     // set the "tint" uniform to the value in the member variable tint 
-    void TintedMaterial::setup() const {
-        Material::setup(); // tinted material is the child of material class
-        shader->set("tint", tint);
+    void TintedMaterial::setup(bool instanced) const {
+        Material::setup(instanced); // tinted material is the child of material class
+        ShaderProgram* program = getShader(instanced);
+        program->set(tintUniform, tint);
     }
 
     // This function read the material data from a json object
@@ -46,13 +67,13 @@ namespace our {
     // This function should call the setup of its parent and
     // set the "alphaThreshold" uniform to the value in the member variable alphaThreshold
     // Then it should bind the texture and sampler to a texture unit and send the unit number to the uniform variable "tex" 
-    void TexturedMaterial::setup() const {
-        TintedMaterial::setup(); // textured material is the child of tinted material class
-        shader->set("alphaThreshold", alphaThreshold);
-        glActiveTexture(GL_TEXTURE0);
-        texture->bind();
+    void TexturedMaterial::setup(bool instanced) const {
+        TintedMaterial::setup(instanced); // textured material is the child of tinted material class
+        ShaderProgram* program = getShader(instanced);
+        program->set(alphaThresholdUniform, alphaThreshold);
+        texture->bind(TEXTURE_UNIT_0);
         sampler->bind(TEXTURE_UNIT_0);
-        shader->set("tex", TEXTURE_UNIT_0);
+        program->set(texUniform, TEXTURE_UNIT_0);
     }
 
     // This function read the material data from a json object
@@ -60,45 +81,58 @@ namespace our {
         TintedMaterial::deserialize(data);
         if(!data.is_object()) return;
         alphaThreshold = data.value("alphaThreshold", 0.0f);
+        alphaTested = alphaThreshold > 0.0f;
         texture = AssetLoader<Texture2D>::get(data.value("texture", ""));
         sampler = AssetLoader<Sampler>::get(data.value("sampler", ""));
     }
 
-    void LitMaterial::setup() const
-    {
-        Material::setup(); // parent's setup()
+    ShaderDefines TexturedMaterial::getShaderDefines(const nlohmann::json& data) const {
+        ShaderDefines defines = TintedMaterial::getShaderDefines(data);
+        if(data.value("alphaThreshold", 0.0f) > 0.0f) defines["ALPHA_TEST"] = "";
+        return defines;
+    }
 
-        shader->set("material.albedo_tint", albedo_tint);
-        shader->set("material.specular_tint", specular_tint);
-        shader->set("material.roughness_range", roughness_range);
-        shader->set("material.emissive_tint", emissive_tint);
+    void LitMaterial::setup(bool instanced) const
+    {
+        Material::setup(instanced); // parent's setup()
+        ShaderProgram* program = getShader(instanced);
+
+        program->set(albedoTintUniform, albedo_tint);
+        program->set(specularTintUniform, specular_tint);
+        program->set(roughnessRangeUniform, roughness_range);
+        program->set(emissiveTintUniform, emissive_tint);
+        if(alphaTested) program->set(alphaThresholdMaterialUniform, alpha_threshold);
         
         // each map has a different texture unit
         // bind each texture map, bind the sampler to its unit, and pass the texture unit reference to the frag shader
-        glActiveTexture(GL_TEXTURE1);
-        albedo_map->bind();
+        // The maps that the material doesn't have are not read by its shader variant, so they are not bound
+        albedo_map->bind(TEXTURE_UNIT_1);
         sampler->bind(TEXTURE_UNIT_1);
-        shader->set("material.albedo_map", TEXTURE_UNIT_1);
+        program->set(albedoMapUniform, TEXTURE_UNIT_1);
         
-        glActiveTexture(GL_TEXTURE2);
-        specular_map->bind();
-        sampler->bind(TEXTURE_UNIT_2);
-        shader->set("material.specular_map", TEXTURE_UNIT_2);
+        if(specular_map) {
+            specular_map->bind(TEXTURE_UNIT_2);
+            sampler->bind(TEXTURE_UNIT_2);
+            program->set(specularMapUniform, TEXTURE_UNIT_2);
+        }
         
-        glActiveTexture(GL_TEXTURE3);
-        ambient_occlusion_map->bind();
-        sampler->bind(TEXTURE_UNIT_3);
-        shader->set("material.ambient_occlusion_map", TEXTURE_UNIT_3);
+        if(ambient_occlusion_map) {
+            ambient_occlusion_map->bind(TEXTURE_UNIT_3);
+            sampler->bind(TEXTURE_UNIT_3);
+            program->set(ambientOcclusionMapUniform, TEXTURE_UNIT_3);
+        }
         
-        glActiveTexture(GL_TEXTURE4);
-        roughness_map->bind();
-        sampler->bind(TEXTURE_UNIT_4);
-        shader->set("material.roughness_map", TEXTURE_UNIT_4);
+        if(roughness_map) {
+            roughness_map->bind(TEXTURE_UNIT_4);
+            sampler->bind(TEXTURE_UNIT_4);
+            program->set(roughnessMapUniform, TEXTURE_UNIT_4);
+        }
         
-        glActiveTexture(GL_TEXTURE5);
-        emissive_map->bind();
-        sampler->bind(TEXTURE_UNIT_5);
-        shader->set("material.emissive_map", TEXTURE_UNIT_5);
+        if(emissive_map) {
+            emissive_map->bind(TEXTURE_UNIT_5);
+            sampler->bind(TEXTURE_UNIT_5);
+            program->set(emissiveMapUniform, TEXTURE_UNIT_5);
+        }
     }
 
     void LitMaterial::deserialize(const nlohmann::json& data) {
@@ -107,20 +141,41 @@ namespace our {
         
         sampler = AssetLoader<Sampler>::get(data.value("sampler", ""));
 
-        // load texture maps and always give a default value for each of them in case not found in json file
-        std::string test = data.value("albedo_map", "white");
+        // load texture maps, the albedo map always has a default value in case it is not found in json file
+        // The other maps are only loaded if they are given (the shader variant uses their default value otherwise)
         albedo_map = AssetLoader<Texture2D>::getTexture(data.value("albedo_map", "white"), glm::vec4(255, 255, 255, 255));
         albedo_tint = data.value<glm::vec3>("albedo_tint", { 1.0f, 1.0f, 1.0f });
         
-        specular_map = AssetLoader<Texture2D>::getTexture(data.value<std::string>("specular_map", "black"), glm::vec4(0, 0, 0, 255));
+        if(data.contains("specular_map"))
+            specular_map = AssetLoader<Texture2D>::getTexture(data.value<std::string>("specular_map", "black"), glm::vec4(0, 0, 0, 255));
         specular_tint = data.value<glm::vec3>("specular_tint", { 1.0f, 1.0f, 1.0f });
 
-        roughness_map = AssetLoader<Texture2D>::getTexture(data.value<std::string>("roughness_map", "white"), glm::vec4(255, 255, 255, 255));
+        if(data.contains("roughness_map"))
+            roughness_map = AssetLoader<Texture2D>::getTexture(data.value<std::string>("roughness_map", "white"), glm::vec4(255, 255, 255, 255));
         roughness_range = data.value<glm::vec2>("roughness_scale", { 0.0f, 1.0f });
 
-        ambient_occlusion_map = AssetLoader<Texture2D>::getTexture(data.value<std::string>("ambient_occlusion_map", "white"), glm::vec4(255, 255, 255, 255));
+        if(data.contains("ambient_occlusion_map"))
+            ambient_occlusion_map = AssetLoader<Texture2D>::getTexture(data.value<std::string>("ambient_occlusion_map", "white"), glm::vec4(255, 255, 255, 255));
 
-        emissive_map = AssetLoader<Texture2D>::getTexture(data.value<std::string>("emissive_map", "black"), glm::vec4(0, 0, 0, 255));
+        if(data.contains("emissive_map"))
+            emissive_map = AssetLoader<Texture2D>::getTexture(data.value<std::string>("emissive_map", "black"), glm::vec4(0, 0, 0, 255));
         emissive_tint = data.value<glm::vec3>("emissive_tint", { 1.0f, 0.0f, 1.0f });
+
+        alpha_threshold = data.value("alpha_threshold", 0.0f);
+        alphaTested = alpha_threshold > 0.0f;
+    }
+
+    ShaderDefines LitMaterial::getShaderDefines(const nlohmann::json& data) const {
+        ShaderDefines defines = Material::getShaderDefines(data);
+        for(auto [key, define] : {
+                std::pair{"specular_map", "SPECULAR_MAP"}, {"roughness_map", "ROUGHNESS_MAP"},
+                {"ambient_occlusion_map", "AMBIENT_OCCLUSION_MAP"}, {"emissive_map", "EMISSIVE_MAP"}}) {
+            if(data.contains(key)) defines[define] = "";
+        }
+        if(data.value("alpha_threshold", 0.0f) > 0.0f) defines["ALPHA_TEST"] = "";
+        if(data.contains("directional_light_count"))
+            defines["DIRECTIONAL_LIGHT_COUNT"] = std::to_string(data["directional_light_count"].get<int>());
+        if(!data.value("clustered_lights", true)) defines["DIRECTIONAL_ONLY"] = "";
+        return defines;
     }
 }
\ No newline at end of file
@@ -7,6 +7,7 @@
 
 #include <glm/vec4.hpp>
 #include <json/json.hpp>
+#include <cstdint>
 
 namespace our {
 
@@ -17,15 +18,34 @@ namespace our {
     // 3- Whether this material is transparent or not
     // Materials that send uniforms to the shader should inherit from the is material and add the required uniforms
     class Material {
+        // A small number identifying this material (assigned in creation order), used by the renderer to group the draws
+        inline static std::uint32_t createdCount = 0;
+        std::uint32_t sortID = createdCount++;
     public:
         PipelineState pipelineState;
         ShaderProgram* shader;
+        ShaderProgram* instancedShader = nullptr; // The variant of the shader that reads the object matrices from instance attributes (if any)
         bool transparent;
+        bool alphaTested = false; // True if the shader discards some fragments (so its depth can't be drawn by another shader)
+
+        std::uint32_t getSortID() const { return sortID; }
+
+        // Returns true if the depth of this material can be drawn by a depth pre-pass: it must be opaque and write its depth
+        bool canDrawInDepthPrepass() const {
+            return !transparent && !alphaTested && pipelineState.depthTesting.enabled && pipelineState.depthMask;
+        }
         
+        // Returns the shader used to draw instanced (if "instanced" is true) or single meshes
+        ShaderProgram* getShader(bool instanced) const { return instanced ? instancedShader : shader; }
+
         // This function does 2 things: setup the pipeline state and set the shader program to be used
-        virtual void setup() const;
+        // If "instanced" is true, the instanced shader is used (it must not be null)
+        virtual void setup(bool instanced = false) const;
         // This function read a material from a json object
         virtual void deserialize(const nlohmann::json& data);
+        // Returns the defines of the shader variant needed by the material described by the given json object
+        // "deserialize" gets the shader and its instanced variant compiled with these defines (see getShaderVariant)
+        virtual ShaderDefines getShaderDefines(const nlohmann::json& /*data*/) const { return {}; }
     };
 
     // This material adds a uniform for a tint (a color that will be sent to the shader)
@@ -34,7 +54,7 @@ namespace our {
     public:
         glm::vec4 tint;
 
-        void setup() const override;
+        void setup(bool instanced = false) const override;
         void deserialize(const nlohmann::json& data) override;
     };
 
@@ -42,6 +62,7 @@ namespace our {
     // The uniforms are:
     // - "tex" which is a Sampler2D. "texture" and "sampler" will be bound to it.
     // - "alphaThreshold" which defined the alpha limit below which the pixel should be discarded
+    //   (the shader is only specialized with ALPHA_TEST if the threshold is above 0)
     // An example where this material can be used is when the object has a texture
     class TexturedMaterial : public TintedMaterial {
     public:
@@ -49,10 +70,16 @@ namespace our {
         Sampler* sampler;
         float alphaThreshold;
 
-        void setup() const override;
+        void setup(bool instanced = false) const override;
         void deserialize(const nlohmann::json& data) override;
+        ShaderDefines getShaderDefines(const nlohmann::json& data) const override;
     };
 
+    // The shader of this material is specialized for the material (see textured-light.frag):
+    // - The maps other than the albedo are optional. The maps that are not given are null and the shader uses their default
+    //   value instead of reading a texture
+    // - "alpha_threshold" (if above 0) discards the fragments whose albedo alpha is below it
+    // - "directional_light_count" limits the number of directional lights and "clustered_lights": false skips the point and spot lights
     class LitMaterial : public Material {
     public:
 
@@ -61,19 +88,22 @@ namespace our {
         Texture2D* albedo_map;
         glm::vec3 albedo_tint{};
 
-        Texture2D* specular_map;
+        Texture2D* specular_map = nullptr;
         glm::vec3 specular_tint{};
 
-        Texture2D* roughness_map;
+        Texture2D* roughness_map = nullptr;
         glm::vec2 roughness_range{};
 
-        Texture2D* ambient_occlusion_map;
+        Texture2D* ambient_occlusion_map = nullptr;
 
-        Texture2D* emissive_map;
+        Texture2D* emissive_map = nullptr;
         glm::vec3 emissive_tint{};
 
-        void setup() const override;
+        float alpha_threshold = 0.0f;
+
+        void setup(bool instanced = false) const override;
         void deserialize(const nlohmann::json& data) override;
+        ShaderDefines getShaderDefines(const nlohmann::json& data) const override;
     };
 
     // This function returns a new material instance based on the given type
@@ -3,6 +3,7 @@
 #include <glad/gl.h>
 #include <glm/vec4.hpp>
 #include <json/json.hpp>
+#include "../gl-state.hpp"
 
 namespace our {
     // There are some options in the render pipeline that we cannot control via shaders
@@ -40,61 +41,63 @@ namespace our {
 
         // This function should set the OpenGL options to the values specified by this structure
         // For example, if faceCulling.enabled is true, you should call glEnable(GL_CULL_FACE), otherwise, you should call glDisable(GL_CULL_FACE)
+        // The options go through the GL state cache, so consecutive draws with the same options don't call OpenGL again
         void setup() const {
-            configureColorComponents();
-            configureFaceCulling();
-            configureDepthTesting();
-            configureBlending();
+            GLStateCache& state = GLStateCache::getInstance();
+            configureColorComponents(state);
+            configureFaceCulling(state);
+            configureDepthTesting(state);
+            configureBlending(state);
         }
 
-        void configureColorComponents() const
+        void configureColorComponents(GLStateCache& state) const
         {
-            glColorMask(colorMask.r, colorMask.g, colorMask.b, colorMask.a);
+            state.setColorMask(colorMask);
         }
 
-        void configureFaceCulling() const
+        void configureFaceCulling(GLStateCache& state) const
         {
+            state.setFaceCulling(faceCulling.enabled);
             if (faceCulling.enabled)
             {
-                glEnable(GL_CULL_FACE);
-                glCullFace(faceCulling.culledFace);
-                glFrontFace(faceCulling.frontFace);
-            }
-            else
-            {
-                glDisable(GL_CULL_FACE);
+                state.setCulledFace(faceCulling.culledFace);
+                state.setFrontFace(faceCulling.frontFace);
             }
         }
 
-        void configureBlending() const
+        void configureBlending(GLStateCache& state) const
         {
+            state.setBlending(blending.enabled);
             if (blending.enabled)
             {
-                glEnable(GL_BLEND);
-                glBlendEquation(blending.equation);
-                glBlendFunc(blending.sourceFactor, blending.destinationFactor);
-                glBlendColor(blending.constantColor.r, blending.constantColor.g, blending.constantColor.b, blending.constantColor.a);
-            }
-            else
-            {
-                glDisable(GL_BLEND);
+                state.setBlendEquation(blending.equation);
+                state.setBlendFunction(blending.sourceFactor, blending.destinationFactor);
+                state.setBlendColor(blending.constantColor);
             }
         }
 
-        void configureDepthTesting() const
+        void configureDepthTesting(GLStateCache& state) const
         {
+            state.setDepthTesting(depthTesting.enabled);
             if (depthTesting.enabled)
             {
-                glEnable(GL_DEPTH_TEST);
-                glDepthMask(depthMask); // enable or disable writing to depth mask
-                glDepthFunc(depthTesting.function);
-            }
-            else
-            {
-                glDisable(GL_DEPTH_TEST);
+                state.setDepthMask(depthMask); // enable or disable writing to depth mask
+                state.setDepthFunction(depthTesting.function);
             }
         }
 
+        // Sets the options of a depth pre-pass draw: only the depth is written, using the face culling and the depth function
+        // of this state (so the pre-pass keeps the same fragments as the draw that follows it)
+        void setupDepthOnly() const {
+            GLStateCache& state = GLStateCache::getInstance();
+            state.setColorMask(glm::bvec4(false));
+            configureFaceCulling(state);
+            state.setDepthTesting(true);
+            state.setDepthMask(true);
+            state.setDepthFunction(depthTesting.function);
+            state.setBlending(false);
+        }
+
         // Given a json object, this function deserializes a PipelineState structure
         void deserialize(const nlohmann::json& data);
     };
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <glad/gl.h>
+#include <glm/glm.hpp>
+#include <cstddef>
+
+namespace our {
+
+    // The per-instance attributes read by the instanced shaders (one element per drawn instance)
+    // The matrices are read as consecutive attribute locations starting from ATTRIB_LOC_INSTANCE_OBJECT_TO_WORLD
+    struct InstanceData {
+        glm::mat4 objectToWorld;
+        glm::mat3 normalMatrix; // The inverse transpose of objectToWorld (used to transform the normals)
+    };
+
+    // This class defines an OpenGL vertex buffer holding the instance data of a frame
+    // It is refilled every frame: the old storage is orphaned so the driver doesn't wait for the draws that still read it
+    class InstanceBuffer {
+        // The OpenGL object name of this buffer
+        GLuint name = 0;
+        // The size of the storage of the buffer in bytes (it only grows)
+        size_t capacity = 0;
+    public:
+        InstanceBuffer() {
+            glGenBuffers(1, &name);
+        }
+
+        // This deconstructor deletes the underlying OpenGL buffer
+        ~InstanceBuffer() {
+            glDeleteBuffers(1, &name);
+        }
+
+        // Replaces the content of the buffer with the given instances
+        void update(const InstanceData* instances, size_t count) {
+            size_t size = count * sizeof(InstanceData);
+            if(size > capacity) capacity = size;
+            glBindBuffer(GL_ARRAY_BUFFER, name);
+            glBufferData(GL_ARRAY_BUFFER, capacity, nullptr, GL_STREAM_DRAW);
+            glBufferSubData(GL_ARRAY_BUFFER, 0, size, instances);
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+        }
+
+        GLuint getName() const { return name; }
+
+        InstanceBuffer(const InstanceBuffer&) = delete;
+        InstanceBuffer& operator=(const InstanceBuffer&) = delete;
+    };
+
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include "mesh.hpp"
+#include <algorithm>
+#include <unordered_map>
+
+namespace our {
+
+    // Where the geometry of a mesh is stored in a mesh pool (in the form expected by the indirect draw commands)
+    struct MeshPoolEntry {
+        GLuint elementCount;
+        GLuint firstElement;
+        GLint baseVertex;
+    };
+
+    // This class copies meshes into a single vertex buffer and a single element buffer, so the draws of different meshes
+    // can share a vertex array (which a multi-draw call requires). Each mesh is copied on the GPU the first time it is added.
+    // The vertex array only holds the vertex attributes, the instance attributes are left to the owner of the pool.
+    // A pool holds the meshes of a single vertex format, and its elements are always 32-bit (whatever the type of the
+    // element buffer of each mesh) since the draws of a multi-draw call share their element type.
+    class MeshPool {
+        VertexFormat vertexFormat;
+        size_t vertexSize;
+        GLuint VAO = 0, VBO = 0, EBO = 0;
+        // The number of vertices and elements used and allocated in the buffers
+        size_t vertexCount = 0, elementCount = 0;
+        size_t vertexCapacity = 0, elementCapacity = 0;
+        // The meshes in the pool indexed by their sort ID (which is never reused, unlike the address of a deleted mesh)
+        std::unordered_map<std::uint32_t, MeshPoolEntry> entries;
+
+        // Moves the content of "buffer" to a new buffer of "capacity" bytes
+        static void growBuffer(GLuint& buffer, size_t usedSize, size_t capacity) {
+            GLuint grown;
+            glGenBuffers(1, &grown);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, grown);
+            glBufferData(GL_COPY_WRITE_BUFFER, capacity, nullptr, GL_STATIC_DRAW);
+            if(buffer) {
+                glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+                glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, usedSize);
+                glDeleteBuffers(1, &buffer);
+            }
+            buffer = grown;
+        }
+
+        // Makes room for the given number of vertices and elements (the capacities double to keep the copies rare)
+        void reserve(size_t vertices, size_t elements) {
+            bool grown = false;
+            if(vertices > vertexCapacity) {
+                vertexCapacity = std::max(vertices, vertexCapacity * 2);
+                growBuffer(VBO, vertexCount * vertexSize, vertexCapacity * vertexSize);
+                grown = true;
+            }
+            if(elements > elementCapacity) {
+                elementCapacity = std::max(elements, elementCapacity * 2);
+                growBuffer(EBO, elementCount * sizeof(std::uint32_t), elementCapacity * sizeof(std::uint32_t));
+                grown = true;
+            }
+            if(!grown) return;
+            // Point the vertex array at the new buffers
+            GLStateCache::getInstance().bindVertexArray(VAO);
+            glBindBuffer(GL_ARRAY_BUFFER, VBO);
+            Mesh::setVertexAttributes(vertexFormat);
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+            glBindBuffer(GL_ARRAY_BUFFER, UNBIND);
+        }
+
+    public:
+        explicit MeshPool(VertexFormat format = VertexFormat::FLOAT) : vertexFormat(format), vertexSize(getVertexSize(format)) {
+            glGenVertexArrays(1, &VAO);
+        }
+
+        ~MeshPool() {
+            glDeleteVertexArrays(1, &VAO);
+            if(VBO) glDeleteBuffers(1, &VBO);
+            if(EBO) glDeleteBuffers(1, &EBO);
+            GLStateCache::getInstance().invalidate(); // The name may be reused by a new object, so the cache must not trust it
+        }
+
+        // Returns where the geometry of the mesh is stored in the pool (the mesh is copied into the pool if it isn't there yet)
+        // The vertex format of the mesh must be the one of the pool
+        const MeshPoolEntry& add(const Mesh* mesh) {
+            auto it = entries.find(mesh->getSortID());
+            if(it != entries.end()) return it->second;
+            size_t meshVertices = mesh->getVertexCount(), meshElements = mesh->getElementCount();
+            reserve(vertexCount + meshVertices, elementCount + meshElements);
+            glBindBuffer(GL_COPY_READ_BUFFER, mesh->getVertexBuffer());
+            glBindBuffer(GL_COPY_WRITE_BUFFER, VBO);
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, vertexCount * vertexSize, meshVertices * vertexSize);
+            // The element buffer of the mesh may be 16-bit, so the elements are uploaded from its 32-bit copy on the RAM
+            glBindBuffer(GL_COPY_WRITE_BUFFER, EBO);
+            glBufferSubData(GL_COPY_WRITE_BUFFER, elementCount * sizeof(std::uint32_t), meshElements * sizeof(std::uint32_t), mesh->getElements().data());
+            // The elements are copied as they are, so they are offset by the base vertex of the draw
+            MeshPoolEntry entry = {GLuint(meshElements), GLuint(elementCount), GLint(vertexCount)};
+            vertexCount += meshVertices;
+            elementCount += meshElements;
+            return entries.emplace(mesh->getSortID(), entry).first->second;
+        }
+
+        // Binds the vertex array reading all the meshes of the pool
+        void bind() const {
+            GLStateCache::getInstance().bindVertexArray(VAO);
+        }
+
+        GLuint getVertexArray() const { return VAO; }
+        VertexFormat getVertexFormat() const { return vertexFormat; }
+
+        MeshPool(const MeshPool&) = delete;
+        MeshPool& operator=(const MeshPool&) = delete;
+    };
+
+}
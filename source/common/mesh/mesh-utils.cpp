@@ -4,11 +4,14 @@
 #define TINYOBJLOADER_IMPLEMENTATION
 #include <tinyobj/tiny_obj_loader.h>
 
+#include <algorithm>
+#include <functional>
 #include <iostream>
+#include <queue>
 #include <vector>
 #include <unordered_map>
 
-our::Mesh* our::mesh_utils::loadOBJ(const char* filename) {
+our::Mesh* our::mesh_utils::loadOBJ(const char* filename, int lodCount, VertexFormat format) {
 
     // The data that we will use to initialize our mesh
     std::vector<our::Vertex> vertices;
@@ -27,7 +30,7 @@ our::Mesh* our::mesh_utils::loadOBJ(const char* filename) {
 
     if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, filename)) {
         std::cerr << "Failed to load obj file \"" << filename << "\" due to error: " << err << std::endl;
-        return false;
+        return nullptr;
     }
     if (!warn.empty()) {
         std::cout << "WARN while loading obj file \"" << filename << "\": " << warn << std::endl;
@@ -81,5 +84,242 @@ our::Mesh* our::mesh_utils::loadOBJ(const char* filename) {
         }
     }
 
-    return new our::Mesh(vertices, elements);
+    auto mesh = new our::Mesh(vertices, elements, format);
+    if (lodCount > 0) generateLODs(mesh, vertices, elements, lodCount);
+    return mesh;
+}
+
+namespace {
+
+    // The error quadric of a vertex: a symmetric 4x4 matrix (stored as its 10 distinct coefficients) such that
+    // (p, 1) * Q * (p, 1) is the sum of the squared distances between p and the planes added to it
+    struct Quadric {
+        double xx = 0, xy = 0, xz = 0, xw = 0, yy = 0, yz = 0, yw = 0, zz = 0, zw = 0, ww = 0;
+
+        // Adds the plane "dot(normal, p) + d = 0" (the normal must be normalized) scaled by "weight"
+        void addPlane(const glm::dvec3& normal, double d, double weight) {
+            xx += weight * normal.x * normal.x; xy += weight * normal.x * normal.y; xz += weight * normal.x * normal.z;
+            xw += weight * normal.x * d; yy += weight * normal.y * normal.y; yz += weight * normal.y * normal.z;
+            yw += weight * normal.y * d; zz += weight * normal.z * normal.z; zw += weight * normal.z * d;
+            ww += weight * d * d;
+        }
+
+        Quadric& operator+=(const Quadric& other) {
+            xx += other.xx; xy += other.xy; xz += other.xz; xw += other.xw; yy += other.yy;
+            yz += other.yz; yw += other.yw; zz += other.zz; zw += other.zw; ww += other.ww;
+            return *this;
+        }
+
+        double evaluate(const glm::dvec3& p) const {
+            return xx * p.x * p.x + 2 * xy * p.x * p.y + 2 * xz * p.x * p.z + 2 * xw * p.x
+                 + yy * p.y * p.y + 2 * yz * p.y * p.z + 2 * yw * p.y
+                 + zz * p.z * p.z + 2 * zw * p.z + ww;
+        }
+    };
+
+    // A candidate collapse of the vertex "from" into the vertex "to" (it is outdated if either vertex changed since it was made)
+    struct Collapse {
+        double cost;
+        GLuint from, to;
+        std::uint32_t fromVersion, toVersion;
+        bool operator>(const Collapse& other) const { return cost > other.cost; }
+    };
+
+    // The weight of the planes along the borders relative to the planes of the triangles
+    constexpr double BORDER_WEIGHT = 16.0;
+    // A collapse is refused if it turns the normal of a triangle by more than about 75 degrees
+    constexpr double MIN_NORMAL_COSINE = 0.25;
+
+}
+
+void our::mesh_utils::simplify(const std::vector<Vertex>& vertices, const std::vector<GLuint>& elements, size_t targetTriangleCount,
+                               std::vector<Vertex>& simplifiedVertices, std::vector<GLuint>& simplifiedElements) {
+    // The vertices sharing a position are merged, so the simplification sees the surface through the attribute seams
+    std::vector<glm::dvec3> positions;
+    std::vector<GLuint> corners(elements.size()); // The merged vertex of each corner
+    {
+        std::unordered_map<glm::vec3, GLuint> positionIndices;
+        for (size_t corner = 0; corner < elements.size(); corner++) {
+            const glm::vec3& position = vertices[elements[corner]].position;
+            auto [it, inserted] = positionIndices.try_emplace(position, GLuint(positions.size()));
+            if (inserted) positions.emplace_back(position);
+            corners[corner] = it->second;
+        }
+    }
+    size_t vertexCount = positions.size(), triangleCount = elements.size() / 3;
+
+    auto triangleNormal = [&](const glm::dvec3& p0, const glm::dvec3& p1, const glm::dvec3& p2) {
+        return glm::cross(p1 - p0, p2 - p0);
+    };
+
+    // Each vertex gets the planes of its triangles (weighted by their areas) and the triangles around each vertex are listed
+    std::vector<Quadric> quadrics(vertexCount);
+    std::vector<std::vector<GLuint>> vertexTriangles(vertexCount);
+    std::vector<bool> triangleAlive(triangleCount, false);
+    std::unordered_map<std::uint64_t, int> edgeUses;
+    auto edgeKey = [](GLuint a, GLuint b) { return (std::uint64_t(std::min(a, b)) << 32) | std::max(a, b); };
+    size_t aliveCount = 0;
+    for (size_t triangle = 0; triangle < triangleCount; triangle++) {
+        GLuint* v = &corners[3 * triangle];
+        if (v[0] == v[1] || v[1] == v[2] || v[2] == v[0]) continue; // Degenerate triangles are dropped
+        glm::dvec3 normal = triangleNormal(positions[v[0]], positions[v[1]], positions[v[2]]);
+        double length = glm::length(normal);
+        triangleAlive[triangle] = true;
+        aliveCount++;
+        for (int k = 0; k < 3; k++) {
+            vertexTriangles[v[k]].push_back(GLuint(triangle));
+            edgeUses[edgeKey(v[k], v[(k + 1) % 3])]++;
+        }
+        if (length <= 0.0) continue;
+        normal /= length;
+        for (int k = 0; k < 3; k++) quadrics[v[k]].addPlane(normal, -glm::dot(normal, positions[v[0]]), length * 0.5);
+    }
+    // A border edge is only used by one triangle. The plane through the edge perpendicular to its triangle keeps it in place
+    for (size_t triangle = 0; triangle < triangleCount; triangle++) {
+        if (!triangleAlive[triangle]) continue;
+        GLuint* v = &corners[3 * triangle];
+        glm::dvec3 normal = triangleNormal(positions[v[0]], positions[v[1]], positions[v[2]]);
+        for (int k = 0; k < 3; k++) {
+            GLuint a = v[k], b = v[(k + 1) % 3];
+            if (edgeUses[edgeKey(a, b)] != 1) continue;
+            glm::dvec3 edge = positions[b] - positions[a];
+            glm::dvec3 borderNormal = glm::cross(edge, normal);
+            double length = glm::length(borderNormal);
+            if (length <= 0.0) continue;
+            borderNormal /= length;
+            double d = -glm::dot(borderNormal, positions[a]);
+            double weight = BORDER_WEIGHT * glm::dot(edge, edge);
+            quadrics[a].addPlane(borderNormal, d, weight);
+            quadrics[b].addPlane(borderNormal, d, weight);
+        }
+    }
+
+    // The candidate collapses are kept in a min-heap. Instead of updating the entries of a vertex when it changes,
+    // its version is increased and the outdated entries are skipped when they are popped
+    std::vector<std::uint32_t> versions(vertexCount, 0);
+    std::vector<bool> vertexRemoved(vertexCount, false);
+    std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> heap;
+    auto pushCollapse = [&](GLuint from, GLuint to) {
+        Quadric quadric = quadrics[from];
+        quadric += quadrics[to];
+        heap.push({quadric.evaluate(positions[to]), from, to, versions[from], versions[to]});
+    };
+    for (size_t triangle = 0; triangle < triangleCount; triangle++) {
+        if (!triangleAlive[triangle]) continue;
+        GLuint* v = &corners[3 * triangle];
+        for (int k = 0; k < 3; k++) {
+            pushCollapse(v[k], v[(k + 1) % 3]);
+            pushCollapse(v[(k + 1) % 3], v[k]);
+        }
+    }
+
+    auto containsVertex = [&](size_t triangle, GLuint vertex) {
+        return corners[3 * triangle] == vertex || corners[3 * triangle + 1] == vertex || corners[3 * triangle + 2] == vertex;
+    };
+    std::vector<GLuint> fromNeighbors, toNeighbors;
+    auto collectNeighbors = [&](GLuint vertex, std::vector<GLuint>& neighbors) {
+        neighbors.clear();
+        for (GLuint triangle : vertexTriangles[vertex]) {
+            if (!triangleAlive[triangle]) continue;
+            for (int k = 0; k < 3; k++) if (GLuint other = corners[3 * triangle + k]; other != vertex) neighbors.push_back(other);
+        }
+        std::sort(neighbors.begin(), neighbors.end());
+        neighbors.erase(std::unique(neighbors.begin(), neighbors.end()), neighbors.end());
+    };
+
+    while (aliveCount > targetTriangleCount && !heap.empty()) {
+        Collapse collapse = heap.top();
+        heap.pop();
+        GLuint from = collapse.from, to = collapse.to;
+        if (vertexRemoved[from] || vertexRemoved[to] || versions[from] != collapse.fromVersion || versions[to] != collapse.toVersion) continue;
+
+        // The collapse must keep the surface manifold: the only vertices linked to both ends must be the opposite corners
+        // of the triangles on the edge (otherwise the collapse would pinch the surface)
+        collectNeighbors(from, fromNeighbors);
+        collectNeighbors(to, toNeighbors);
+        size_t sharedNeighbors = 0, edgeTriangles = 0;
+        for (GLuint neighbor : fromNeighbors) sharedNeighbors += std::binary_search(toNeighbors.begin(), toNeighbors.end(), neighbor);
+        for (GLuint triangle : vertexTriangles[from]) edgeTriangles += triangleAlive[triangle] && containsVertex(triangle, to);
+        if (edgeTriangles == 0 || sharedNeighbors > edgeTriangles) continue;
+
+        // The triangles that move must not flip or become degenerate
+        bool valid = true;
+        for (GLuint triangle : vertexTriangles[from]) {
+            if (!triangleAlive[triangle] || containsVertex(triangle, to)) continue;
+            glm::dvec3 p[3], moved[3];
+            for (int k = 0; k < 3; k++) {
+                GLuint vertex = corners[3 * triangle + k];
+                p[k] = positions[vertex];
+                moved[k] = vertex == from ? positions[to] : p[k];
+            }
+            glm::dvec3 before = triangleNormal(p[0], p[1], p[2]), after = triangleNormal(moved[0], moved[1], moved[2]);
+            double beforeLength = glm::length(before), afterLength = glm::length(after);
+            if (afterLength <= 1e-12 * beforeLength || glm::dot(before, after) < MIN_NORMAL_COSINE * beforeLength * afterLength) {
+                valid = false;
+                break;
+            }
+        }
+        if (!valid) continue;
+
+        // The triangles on the edge disappear and the others move from "from" to "to"
+        for (GLuint triangle : vertexTriangles[from]) {
+            if (!triangleAlive[triangle]) continue;
+            if (containsVertex(triangle, to)) {
+                triangleAlive[triangle] = false;
+                aliveCount--;
+                continue;
+            }
+            for (int k = 0; k < 3; k++) if (corners[3 * triangle + k] == from) corners[3 * triangle + k] = to;
+            vertexTriangles[to].push_back(triangle);
+        }
+        vertexRemoved[from] = true;
+        vertexTriangles[from].clear();
+        auto& toTriangles = vertexTriangles[to];
+        toTriangles.erase(std::remove_if(toTriangles.begin(), toTriangles.end(), [&](GLuint triangle){ return !triangleAlive[triangle]; }), toTriangles.end());
+        quadrics[to] += quadrics[from];
+
+        // Every collapse involving "to" has a new cost, so they are all pushed again
+        versions[to]++;
+        collectNeighbors(to, toNeighbors);
+        for (GLuint neighbor : toNeighbors) {
+            pushCollapse(neighbor, to);
+            pushCollapse(to, neighbor);
+        }
+    }
+
+    // Each corner keeps the attributes of its original vertex at the position of the vertex it was collapsed into
+    simplifiedVertices.clear();
+    simplifiedElements.clear();
+    std::unordered_map<std::uint64_t, GLuint> outputIndices;
+    for (size_t triangle = 0; triangle < triangleCount; triangle++) {
+        if (!triangleAlive[triangle]) continue;
+        for (int k = 0; k < 3; k++) {
+            size_t corner = 3 * triangle + k;
+            std::uint64_t key = (std::uint64_t(elements[corner]) << 32) | corners[corner];
+            auto [it, inserted] = outputIndices.try_emplace(key, GLuint(simplifiedVertices.size()));
+            if (inserted) {
+                Vertex vertex = vertices[elements[corner]];
+                vertex.position = glm::vec3(positions[corners[corner]]);
+                simplifiedVertices.push_back(vertex);
+            }
+            simplifiedElements.push_back(it->second);
+        }
+    }
+}
+
+void our::mesh_utils::generateLODs(Mesh* mesh, const std::vector<Vertex>& vertices, const std::vector<GLuint>& elements, int count) {
+    size_t triangleCount = elements.size() / 3;
+    std::vector<Vertex> lodVertices;
+    std::vector<GLuint> lodElements;
+    for (int level = 1; level <= count; level++) {
+        size_t target = triangleCount / 2;
+        if (target < MESH_LOD_MIN_TRIANGLE_COUNT) break;
+        // Each LOD is simplified from the original mesh, so the errors of the previous LODs don't add up
+        simplify(vertices, elements, target, lodVertices, lodElements);
+        size_t lodTriangleCount = lodElements.size() / 3;
+        // If the simplification stalled (no valid collapse left), a new LOD would cost memory and save nothing
+        if (lodTriangleCount == 0 || lodTriangleCount * 4 > triangleCount * 3) break;
+        mesh->addLOD(new Mesh(lodVertices, lodElements, mesh->getVertexFormat()));
+        triangleCount = lodTriangleCount;
+    }
 }
\ No newline at end of file
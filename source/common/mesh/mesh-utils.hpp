@@ -2,7 +2,25 @@
 
 #include "mesh.hpp"
 
+// The number of LODs generated for the meshes loaded by the asset loader (unless their description gives another count)
+#define MESH_LOD_DEFAULT_COUNT 3
+// The LODs stop once a mesh has fewer triangles than this (simplifying it further would save nearly nothing)
+#define MESH_LOD_MIN_TRIANGLE_COUNT 64
+
 namespace our::mesh_utils {
-    // Load an ".obj" file into the mesh
-    Mesh* loadOBJ(const char* filename);
-}
\ No newline at end of file
+    // Load an ".obj" file into the mesh, whose vertices are stored in the given format (see VertexFormat)
+    // If "lodCount" is above 0, up to "lodCount" simplified versions of the mesh are generated (see generateLODs)
+    Mesh* loadOBJ(const char* filename, int lodCount = 0, VertexFormat format = VertexFormat::FLOAT);
+
+    // Simplifies a triangle mesh with quadric edge collapses until it has at most "targetTriangleCount" triangles (or no edge
+    // can be collapsed without flipping a triangle). The vertices sharing a position are collapsed together, so the meshes
+    // with hard edges or texture seams are simplified too: each corner keeps the attributes of its original vertex.
+    // The borders of the mesh are kept in place by extra quadrics along them
+    void simplify(const std::vector<Vertex>& vertices, const std::vector<GLuint>& elements, size_t targetTriangleCount,
+                  std::vector<Vertex>& simplifiedVertices, std::vector<GLuint>& simplifiedElements);
+
+    // Adds up to "count" LODs to the mesh built from the given vertices and elements, each with half the triangles of the
+    // previous one. It stops early once the triangles fall below MESH_LOD_MIN_TRIANGLE_COUNT or the simplification stalls
+    // The LODs have the vertex format of the mesh
+    void generateLODs(Mesh* mesh, const std::vector<Vertex>& vertices, const std::vector<GLuint>& elements, int count);
+}
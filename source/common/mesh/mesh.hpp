@@ -1,8 +1,17 @@
 #pragma once
 
 #include <glad/gl.h>
+#include <glm/gtc/matrix_transform.hpp>
 #include "vertex.hpp"
+#include "../gl-state.hpp"
+#include "instance-buffer.hpp"
+#include "ring-buffer.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
 #include <iostream>
+#include <memory>
+#include <vector>
 
 namespace our
 {
@@ -11,6 +20,9 @@ namespace our
 #define ATTRIB_LOC_COLOR 1
 #define ATTRIB_LOC_TEXCOORD 2
 #define ATTRIB_LOC_NORMAL 3
+// The instance attributes: a mat4 (4 locations) followed by a mat3 (3 locations)
+#define ATTRIB_LOC_INSTANCE_OBJECT_TO_WORLD 4
+#define ATTRIB_LOC_INSTANCE_NORMAL_MATRIX 8
 #define NOT_NORMALIZED GL_FALSE
 #define NORMALIZED  GL_TRUE
 #define NO_OFFSET 0
@@ -25,34 +37,163 @@ namespace our
         // We need to remember the number of elements that will be draw by glDrawElements
         GLsizei elementCount;
         GLsizei vertexCount;
+        // The format of the vertices in the vertex buffer and the type of the elements in the element buffer
+        // The elements are 16-bit whenever the vertex count allows it (they are 32-bit otherwise)
+        VertexFormat vertexFormat;
+        GLenum elementType;
+        // The quantized positions (see VertexFormat::QUANTIZED) are decoded by "positionOffset + position * positionScale"
+        glm::vec3 positionOffset = glm::vec3(0.0f);
+        float positionScale = 1.0f;
+        // The bounds of the vertices in the local space (computed once when the mesh is created)
+        glm::vec3 boundsMin = glm::vec3(0.0f), boundsMax = glm::vec3(0.0f);
+        glm::vec3 boundingSphereCenter = glm::vec3(0.0f);
+        float boundingSphereRadius = 0.0f;
+        // A copy of the positions and the elements kept on the RAM, so the mesh can be rasterized on the CPU (see OcclusionCuller)
+        std::vector<glm::vec3> positions;
+        std::vector<std::uint32_t> elements;
+        // Whether the instance attributes were enabled in the vertex array (done by the first instanced draw)
+        bool instanceAttributesEnabled = false;
+        // The storage of the ring buffer the instance attributes point at (0 if they point somewhere else)
+        std::uint32_t instanceAttributesStorage = 0;
+        // A small number identifying this mesh (assigned in creation order), used by the renderer to group the draws
+        inline static std::uint32_t createdCount = 0;
+        std::uint32_t sortID = createdCount++;
+        // The simplified versions of this mesh from the finest (LOD 1) to the coarsest (see mesh_utils::generateLODs)
+        std::vector<std::unique_ptr<Mesh>> lods;
+
+        void computeBounds(const std::vector<Vertex> &vertices)
+        {
+            if (vertices.empty()) return;
+            boundsMin = boundsMax = vertices[0].position;
+            for (const Vertex& vertex : vertices) {
+                boundsMin = glm::min(boundsMin, vertex.position);
+                boundsMax = glm::max(boundsMax, vertex.position);
+            }
+            boundingSphereCenter = (boundsMin + boundsMax) * 0.5f;
+            float radiusSquared = 0.0f;
+            for (const Vertex& vertex : vertices) {
+                glm::vec3 offset = vertex.position - boundingSphereCenter;
+                radiusSquared = glm::max(radiusSquared, glm::dot(offset, offset));
+            }
+            boundingSphereRadius = glm::sqrt(radiusSquared);
+        }
+
+        // Points the instance attributes of the vertex array (which must be bound) at the instances of "buffer" starting at "offset"
+        void setInstanceAttributes(GLuint buffer, size_t offset)
+        {
+            glBindBuffer(GL_ARRAY_BUFFER, buffer);
+            if (!instanceAttributesEnabled) {
+                // The attributes advance once per instance instead of once per vertex (this is stored in the vertex array)
+                for (GLuint column = 0; column < 4; column++) {
+                    glEnableVertexAttribArray(ATTRIB_LOC_INSTANCE_OBJECT_TO_WORLD + column);
+                    glVertexAttribDivisor(ATTRIB_LOC_INSTANCE_OBJECT_TO_WORLD + column, 1);
+                }
+                for (GLuint column = 0; column < 3; column++) {
+                    glEnableVertexAttribArray(ATTRIB_LOC_INSTANCE_NORMAL_MATRIX + column);
+                    glVertexAttribDivisor(ATTRIB_LOC_INSTANCE_NORMAL_MATRIX + column, 1);
+                }
+            }
+            instanceAttributesEnabled = true;
+            for (GLuint column = 0; column < 4; column++) {
+                size_t columnOffset = offset + offsetof(InstanceData, objectToWorld) + column * sizeof(glm::vec4);
+                glVertexAttribPointer(ATTRIB_LOC_INSTANCE_OBJECT_TO_WORLD + column, 4, GL_FLOAT, NOT_NORMALIZED, sizeof(InstanceData), (void *)columnOffset);
+            }
+            for (GLuint column = 0; column < 3; column++) {
+                size_t columnOffset = offset + offsetof(InstanceData, normalMatrix) + column * sizeof(glm::vec3);
+                glVertexAttribPointer(ATTRIB_LOC_INSTANCE_NORMAL_MATRIX + column, 3, GL_FLOAT, NOT_NORMALIZED, sizeof(InstanceData), (void *)columnOffset);
+            }
+            glBindBuffer(GL_ARRAY_BUFFER, UNBIND);
+        }
 
     public:
         // The constructor takes two vectors:
         // - vertices which contain the vertex data.
         // - elements which contain the indices of the vertices out of which each rectangle will be constructed.
-        // The mesh class does not keep a these data on the RAM. Instead, it should create
+        // and the format in which the vertices are stored on the VRAM (see VertexFormat).
+        // The mesh class only keeps the positions and the elements on the RAM. Otherwise, it should create
         // a vertex buffer to store the vertex data on the VRAM,
         // an element buffer to store the element data on the VRAM,
         // a vertex array object to define how to read the vertex & element buffer during rendering
-        Mesh(const std::vector<Vertex> &vertices, const std::vector<unsigned int> &elements)
+        Mesh(const std::vector<Vertex> &vertices, const std::vector<unsigned int> &elements, VertexFormat format = VertexFormat::FLOAT)
         {
             // remember to store the number of elements in "elementCount" since you will need it for drawing
             // For the attribute locations, use the constants defined above: ATTRIB_LOC_POSITION, ATTRIB_LOC_COLOR, etc
             elementCount = elements.size();
             vertexCount = vertices.size();
+            vertexFormat = format;
+            elementType = chooseElementType(vertexCount);
+            computeBounds(vertices);
+            this->positions.reserve(vertices.size());
+            for (const Vertex& vertex : vertices) this->positions.push_back(vertex.position);
+            this->elements.assign(elements.begin(), elements.end());
 
             // Generating, binding and loading data for all needed buffers
             glGenVertexArrays(1, &VAO);
             glGenBuffers(1, &VBO);
             glGenBuffers(1, &EBO);
 
-            glBindVertexArray(VAO);
+            GLStateCache::getInstance().bindVertexArray(VAO);
 
             glBindBuffer(GL_ARRAY_BUFFER, VBO);
-            glBufferData(GL_ARRAY_BUFFER, vertexCount * sizeof(Vertex), vertices.data(), GL_STATIC_DRAW);
+            if (format == VertexFormat::PACKED) {
+                std::vector<PackedVertex> packed(vertices.size());
+                std::transform(vertices.begin(), vertices.end(), packed.begin(), packVertex);
+                glBufferData(GL_ARRAY_BUFFER, vertexCount * sizeof(PackedVertex), packed.data(), GL_STATIC_DRAW);
+            } else if (format == VertexFormat::QUANTIZED) {
+                // A flat mesh still needs a scale above 0 to be decoded
+                positionOffset = boundsMin;
+                positionScale = std::max(glm::max(boundsMax.x - boundsMin.x, glm::max(boundsMax.y - boundsMin.y, boundsMax.z - boundsMin.z)), 1e-6f);
+                std::vector<QuantizedVertex> quantized(vertices.size());
+                for (size_t index = 0; index < vertices.size(); index++)
+                    quantized[index] = quantizeVertex(vertices[index], positionOffset, positionScale);
+                glBufferData(GL_ARRAY_BUFFER, vertexCount * sizeof(QuantizedVertex), quantized.data(), GL_STATIC_DRAW);
+            } else {
+                glBufferData(GL_ARRAY_BUFFER, vertexCount * sizeof(Vertex), vertices.data(), GL_STATIC_DRAW);
+            }
 
             glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-            glBufferData(GL_ELEMENT_ARRAY_BUFFER, elementCount * sizeof(unsigned int), elements.data(), GL_STATIC_DRAW);
+            if (elementType == GL_UNSIGNED_SHORT) {
+                std::vector<std::uint16_t> shortElements = packShortElements(elements);
+                glBufferData(GL_ELEMENT_ARRAY_BUFFER, elementCount * sizeof(std::uint16_t), shortElements.data(), GL_STATIC_DRAW);
+            } else {
+                glBufferData(GL_ELEMENT_ARRAY_BUFFER, elementCount * sizeof(std::uint32_t), elements.data(), GL_STATIC_DRAW);
+            }
+
+            setVertexAttributes(format);
+
+            // Unbinding all buffers
+            GLStateCache::getInstance().bindVertexArray(UNBIND);
+            glBindBuffer(GL_ARRAY_BUFFER, UNBIND);
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, UNBIND);
+        }
+
+        // Specifies the layout of the vertex attributes in the buffer bound to GL_ARRAY_BUFFER for the bound vertex array
+        // It is shared with the vertex arrays that read many meshes from a single buffer (see MeshPool)
+        static void setVertexAttributes(VertexFormat format = VertexFormat::FLOAT)
+        {
+            if (format != VertexFormat::FLOAT) {
+                // The packed attributes are converted to floats by the vertex fetch, so the shaders don't depend on the format
+                GLsizei stride = GLsizei(getVertexSize(format));
+                size_t colorOffset;
+                if (format == VertexFormat::QUANTIZED) {
+                    // Positions in [0, 1] (the object matrix applies the offset and the scale of the mesh)
+                    glVertexAttribPointer(ATTRIB_LOC_POSITION, 3, GL_UNSIGNED_SHORT, NORMALIZED, stride, (void *)offsetof(QuantizedVertex, position));
+                    colorOffset = offsetof(QuantizedVertex, color);
+                } else {
+                    glVertexAttribPointer(ATTRIB_LOC_POSITION, 3, GL_FLOAT, NOT_NORMALIZED, stride, (void *)offsetof(PackedVertex, position));
+                    colorOffset = offsetof(PackedVertex, color);
+                }
+                // The other attributes follow the color in both formats
+                size_t textureOffset = colorOffset + sizeof(Color);
+                size_t normalOffset = textureOffset + sizeof(std::uint32_t);
+                glVertexAttribPointer(ATTRIB_LOC_COLOR, 4, GL_UNSIGNED_BYTE, NORMALIZED, stride, (void *)colorOffset);
+                glVertexAttribPointer(ATTRIB_LOC_TEXCOORD, 2, GL_HALF_FLOAT, NOT_NORMALIZED, stride, (void *)textureOffset);
+                // A packed type always has 4 components, the 4th one is dropped by the "vec3 normal" input
+                glVertexAttribPointer(ATTRIB_LOC_NORMAL, 4, GL_INT_2_10_10_10_REV, NORMALIZED, stride, (void *)normalOffset);
+                for (GLuint location : {ATTRIB_LOC_POSITION, ATTRIB_LOC_COLOR, ATTRIB_LOC_TEXCOORD, ATTRIB_LOC_NORMAL})
+                    glEnableVertexAttribArray(location);
+                return;
+            }
 
             // Positions
             glVertexAttribPointer(ATTRIB_LOC_POSITION, 3, GL_FLOAT, NOT_NORMALIZED, sizeof(Vertex), (void *)NO_OFFSET);
@@ -73,19 +214,86 @@ namespace our
             // Normals
             glVertexAttribPointer(ATTRIB_LOC_NORMAL, 3, GL_FLOAT, NOT_NORMALIZED, sizeof(Vertex), (void *)(locationOffset + colorOffset + textureOffset));
             glEnableVertexAttribArray(ATTRIB_LOC_NORMAL);
+        }
 
-            // Unbinding all buffers
-            glBindVertexArray(UNBIND);
-            glBindBuffer(GL_ARRAY_BUFFER, UNBIND);
-            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, UNBIND);
+        std::uint32_t getSortID() const { return sortID; }
+
+        VertexFormat getVertexFormat() const { return vertexFormat; }
+        // The type of the elements in the element buffer (GL_UNSIGNED_SHORT or GL_UNSIGNED_INT)
+        GLenum getElementType() const { return elementType; }
+
+        // Returns the type of the elements of a mesh with the given number of vertices
+        // 16-bit elements can index 65536 vertices (0 to 65535), so they halve the element buffer of most meshes
+        static GLenum chooseElementType(size_t vertexCount) { return vertexCount <= 65536 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT; }
+        // Converts the elements of a mesh whose element type is GL_UNSIGNED_SHORT to 16 bits
+        static std::vector<std::uint16_t> packShortElements(const std::vector<unsigned int>& elements) {
+            return std::vector<std::uint16_t>(elements.begin(), elements.end());
         }
 
+        // Returns true if the positions in the vertex buffer are quantized. They must then be drawn with the object matrix
+        // multiplied by getPositionDecoding(). The decoding is a translation and a uniform scale, so the normal matrix is unchanged
+        bool hasQuantizedPositions() const { return vertexFormat == VertexFormat::QUANTIZED; }
+        glm::mat4 getPositionDecoding() const {
+            return glm::scale(glm::translate(glm::mat4(1.0f), positionOffset), glm::vec3(positionScale));
+        }
+        // The local space bounding sphere in the space of the quantized positions (the same as the bounding sphere otherwise)
+        glm::vec4 getEncodedBoundingSphere() const {
+            return glm::vec4((boundingSphereCenter - positionOffset) / positionScale, boundingSphereRadius / positionScale);
+        }
+
+        // The buffers holding the vertices and the elements of the mesh (so they can be copied to shared buffers)
+        GLuint getVertexBuffer() const { return VBO; }
+        GLuint getElementBuffer() const { return EBO; }
+        GLsizei getVertexCount() const { return vertexCount; }
+        GLsizei getElementCount() const { return elementCount; }
+
+        // The local space axis aligned bounding box of the mesh
+        const glm::vec3& getBoundsMin() const { return boundsMin; }
+        const glm::vec3& getBoundsMax() const { return boundsMax; }
+        // The local space bounding sphere of the mesh (centered on the bounding box)
+        const glm::vec3& getBoundingSphereCenter() const { return boundingSphereCenter; }
+        float getBoundingSphereRadius() const { return boundingSphereRadius; }
+        // The positions of the vertices and the elements (3 per triangle) of the mesh
+        const std::vector<glm::vec3>& getPositions() const { return positions; }
+        const std::vector<std::uint32_t>& getElements() const { return elements; }
+
+        // Adds a simplified version of this mesh after the existing ones (the mesh takes its ownership)
+        void addLOD(Mesh* lod) { lods.emplace_back(lod); }
+        // Returns the number of levels of detail of this mesh (the mesh itself is the level 0)
+        size_t getLODCount() const { return lods.size() + 1; }
+        // Returns the mesh of the given level of detail (the level is clamped to the coarsest one)
+        Mesh* getLOD(size_t level) { return level == 0 || lods.empty() ? this : lods[std::min(level, lods.size()) - 1].get(); }
+
         // this function should render the mesh
+        // The vertex array is left bound, so drawing the same mesh again doesn't rebind it
         void draw()
         {
-            glBindVertexArray(VAO);
-            glDrawElements(GL_TRIANGLES, elementCount, GL_UNSIGNED_INT, (void*) NO_OFFSET);
-            glBindVertexArray(0);
+            GLStateCache::getInstance().bindVertexArray(VAO);
+            glDrawElements(GL_TRIANGLES, elementCount, elementType, (void*) NO_OFFSET);
+        }
+
+        // this function renders "instanceCount" instances of the mesh in a single draw call
+        // The instance attributes are read from "buffer" starting at the instance "firstInstance" (see InstanceData)
+        void drawInstanced(const InstanceBuffer& buffer, size_t firstInstance, GLsizei instanceCount)
+        {
+            GLStateCache::getInstance().bindVertexArray(VAO);
+            // OpenGL 3.3 has no base instance, so the attributes are pointed at the first instance of the batch
+            setInstanceAttributes(buffer.getName(), firstInstance * sizeof(InstanceData));
+            instanceAttributesStorage = 0;
+            glDrawElementsInstanced(GL_TRIANGLES, elementCount, elementType, (void*) NO_OFFSET, instanceCount);
+        }
+
+        // this function renders "instanceCount" instances whose data starts at the element "firstInstance" of the ring buffer
+        // The attributes point at the start of the buffer and the draw selects its data with a base instance, so nothing
+        // is specified per draw (the attributes are only set again when the storage of the buffer changes)
+        void drawInstanced(const RingBuffer& buffer, size_t firstInstance, GLsizei instanceCount)
+        {
+            GLStateCache::getInstance().bindVertexArray(VAO);
+            if (instanceAttributesStorage != buffer.getStorageID()) {
+                setInstanceAttributes(buffer.getName(), NO_OFFSET);
+                instanceAttributesStorage = buffer.getStorageID();
+            }
+            glDrawElementsInstancedBaseInstance(GL_TRIANGLES, elementCount, elementType, (void*) NO_OFFSET, instanceCount, GLuint(firstInstance));
         }
 
         // this function should delete the vertex & element buffers and the vertex array object
@@ -94,6 +302,7 @@ namespace our
             glDeleteVertexArrays(1, &VAO);
             glDeleteBuffers(1, &VBO);
             glDeleteBuffers(1, &EBO);
+            GLStateCache::getInstance().invalidate(); // The name may be reused by a new object, so the cache must not trust it
         }
 
         Mesh(Mesh const &) = delete;
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <glad/gl.h>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+// The number of frames that can use the ring buffer at the same time (the CPU writes a region while the GPU reads the others)
+#define RING_BUFFER_REGION_COUNT 3
+
+namespace our {
+
+    // This class defines a streaming vertex buffer that stays mapped for its whole life (OpenGL 4.4 persistent mapping).
+    // The buffer is split into one region per frame in flight: every frame writes its data directly into the next region
+    // then puts a fence after the draws that read it. A region is only written again once its fence is signaled, so the CPU
+    // never waits for the GPU unless it gets more than RING_BUFFER_REGION_COUNT frames ahead and no storage is ever reallocated.
+    // The data is made of elements of a fixed stride, so a draw can find its data from an element index (its base instance).
+    class RingBuffer {
+        // The OpenGL object name of this buffer and a pointer to its storage
+        GLuint name = 0;
+        std::uint8_t* mapped = nullptr;
+        // The size of an element and the number of elements in each region
+        size_t stride, capacity;
+        // The fence of the draws that read each region (null if the region is free)
+        GLsync fences[RING_BUFFER_REGION_COUNT] = {};
+        // The region of the current frame
+        int region = 0;
+        // A number identifying the storage of this buffer (it changes whenever the storage is recreated)
+        inline static std::uint32_t createdCount = 0;
+        std::uint32_t storageID = 0;
+
+        void createStorage() {
+            glGenBuffers(1, &name);
+            glBindBuffer(GL_ARRAY_BUFFER, name);
+            GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            GLsizeiptr size = GLsizeiptr(stride * capacity * RING_BUFFER_REGION_COUNT);
+            glBufferStorage(GL_ARRAY_BUFFER, size, nullptr, flags);
+            mapped = static_cast<std::uint8_t*>(glMapBufferRange(GL_ARRAY_BUFFER, 0, size, flags));
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+            storageID = ++createdCount;
+        }
+
+        void destroyStorage() {
+            for(GLsync& fence : fences) {
+                if(fence) glDeleteSync(fence);
+                fence = nullptr;
+            }
+            glBindBuffer(GL_ARRAY_BUFFER, name);
+            glUnmapBuffer(GL_ARRAY_BUFFER);
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+            glDeleteBuffers(1, &name);
+        }
+
+    public:
+        // Returns true if the context supports persistent mapping (OpenGL 4.4), which also gives the base instance draws (OpenGL 4.2)
+        static bool isSupported() { return GLAD_GL_VERSION_4_4; }
+
+        // Creates a buffer with room for "capacity" elements of "stride" bytes per frame
+        RingBuffer(size_t stride, size_t capacity) : stride(stride), capacity(std::max<size_t>(capacity, 1)) {
+            createStorage();
+        }
+
+        // This deconstructor unmaps and deletes the underlying OpenGL buffer
+        ~RingBuffer() {
+            destroyStorage();
+        }
+
+        // Moves to the region of a new frame and returns a pointer where "count" elements can be written
+        // It waits if the GPU is still reading the region. If the region is too small, the storage is recreated with a bigger size
+        // (the old storage is deleted, but OpenGL keeps it alive until the draws reading it are done)
+        void* map(size_t count) {
+            region = (region + 1) % RING_BUFFER_REGION_COUNT;
+            if(count > capacity) {
+                destroyStorage();
+                capacity = std::max(count, capacity * 2);
+                createStorage();
+            }
+            if(GLsync& fence = fences[region]; fence) {
+                // The commands are flushed by the first wait, so the fence is guaranteed to be signaled eventually
+                GLbitfield waitFlags = GL_SYNC_FLUSH_COMMANDS_BIT;
+                while(glClientWaitSync(fence, waitFlags, 1000000) == GL_TIMEOUT_EXPIRED) waitFlags = 0;
+                glDeleteSync(fence);
+                fence = nullptr;
+            }
+            return mapped + getFirstElement() * stride;
+        }
+
+        // Should be called after the draws that read the current region, so it is not written again before they are done
+        void fence() {
+            if(fences[region]) glDeleteSync(fences[region]);
+            fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        }
+
+        // Returns the index of the first element of the current region in the whole buffer
+        size_t getFirstElement() const { return size_t(region) * capacity; }
+
+        GLuint getName() const { return name; }
+        size_t getStride() const { return stride; }
+        std::uint32_t getStorageID() const { return storageID; }
+
+        RingBuffer(const RingBuffer&) = delete;
+        RingBuffer& operator=(const RingBuffer&) = delete;
+    };
+
+}
@@ -1,7 +1,9 @@
 #pragma once
 
 #include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
 #include <glm/gtx/hash.hpp>
+#include <cstdint>
 
 namespace our {
 
@@ -24,6 +26,56 @@ namespace our {
         }
     };
 
+    // How the vertices of a mesh are stored on the VRAM (the vertex shaders read all of them the same way)
+    enum class VertexFormat {
+        FLOAT,      // Vertex as it is (36 bytes)
+        PACKED,     // PackedVertex: float positions, half float texture coordinates and 10-bit normals (24 bytes)
+        QUANTIZED   // QuantizedVertex: same as PACKED with 16-bit positions relative to the bounds of the mesh (20 bytes)
+    };
+
+    struct PackedVertex {
+        glm::vec3 position;
+        Color color;
+        std::uint32_t tex_coord;    // 2 half floats
+        std::uint32_t normal;       // 3 signed normalized 10-bit components (GL_INT_2_10_10_10_REV)
+    };
+    static_assert(sizeof(PackedVertex) == 24, "PackedVertex must not be padded");
+
+    struct QuantizedVertex {
+        glm::u16vec3 position;      // The position in the bounds of the mesh, where 0 and 65535 are the minimum and the maximum
+        std::uint16_t padding;      // Keeps the next attributes aligned to 4 bytes
+        Color color;
+        std::uint32_t tex_coord;
+        std::uint32_t normal;
+    };
+    static_assert(sizeof(QuantizedVertex) == 20, "QuantizedVertex must not be padded");
+
+    // Returns the size in bytes of a vertex in the given format
+    inline size_t getVertexSize(VertexFormat format) {
+        switch(format) {
+            case VertexFormat::PACKED: return sizeof(PackedVertex);
+            case VertexFormat::QUANTIZED: return sizeof(QuantizedVertex);
+            default: return sizeof(Vertex);
+        }
+    }
+
+    inline PackedVertex packVertex(const Vertex& vertex) {
+        return {
+            vertex.position,
+            vertex.color,
+            glm::packHalf2x16(vertex.tex_coord),
+            glm::packSnorm3x10_1x2(glm::vec4(glm::clamp(vertex.normal, -1.0f, 1.0f), 0.0f))
+        };
+    }
+
+    // Quantizes the position of the vertex relative to the bounds starting at "offset" with a size of "scale" along every axis
+    // (the same scale is used along the 3 axes, so the mesh can be decoded by a uniform scale which keeps the normals as they are)
+    inline QuantizedVertex quantizeVertex(const Vertex& vertex, const glm::vec3& offset, float scale) {
+        PackedVertex packed = packVertex(vertex);
+        glm::vec3 normalized = glm::clamp((vertex.position - offset) / scale, 0.0f, 1.0f);
+        return { glm::u16vec3(glm::round(normalized * 65535.0f)), 0, packed.color, packed.tex_coord, packed.normal };
+    }
+
 }
 
 // We plan to use struct Vertex as a key for a map so we need to define a hash function for it
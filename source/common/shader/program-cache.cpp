@@ -0,0 +1,118 @@
+#include "program-cache.hpp"
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+
+namespace {
+    // The directory of the cache (empty if the cache is disabled)
+    std::filesystem::path cacheDirectory;
+    // The vendor, renderer and version strings of the driver
+    std::string driverString;
+    // Whether the driver supports program binaries in at least one format
+    bool binariesSupported = false;
+    our::program_cache::Statistics statistics;
+
+    // A 64-bit FNV-1a hash, which is more than enough to tell a few hundred programs apart
+    constexpr std::uint64_t FNV_OFFSET_BASIS = 14695981039346656037ull;
+    constexpr std::uint64_t FNV_PRIME = 1099511628211ull;
+
+    std::uint64_t hash(std::uint64_t value, const void* data, size_t size) {
+        auto bytes = static_cast<const std::uint8_t*>(data);
+        for(size_t index = 0; index < size; ++index) {
+            value ^= bytes[index];
+            value *= FNV_PRIME;
+        }
+        return value;
+    }
+
+    std::filesystem::path getPath(const std::string& key) {
+        return cacheDirectory / (key + ".bin");
+    }
+}
+
+void our::program_cache::initialize(const std::string& directory) {
+    cacheDirectory = directory;
+    driverString.clear();
+    for(GLenum name : {GL_VENDOR, GL_RENDERER, GL_VERSION}) {
+        if(auto value = reinterpret_cast<const char*>(glGetString(name))) driverString += value;
+        driverString += '\n';
+    }
+    binariesSupported = false;
+    statistics = Statistics();
+    if(GLAD_GL_VERSION_4_1 || GLAD_GL_ARB_get_program_binary) {
+        GLint formatCount = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+        binariesSupported = formatCount > 0;
+    }
+}
+
+bool our::program_cache::isEnabled() {
+    return binariesSupported && !cacheDirectory.empty();
+}
+
+std::string our::program_cache::makeKey(const std::vector<std::pair<GLenum, std::string>>& stages) {
+    std::uint64_t value = hash(FNV_OFFSET_BASIS, driverString.data(), driverString.size());
+    for(auto& [type, source] : stages) {
+        // The size is hashed with each source, so moving text from one stage to the next changes the key
+        std::uint64_t size = source.size();
+        value = hash(value, &type, sizeof(type));
+        value = hash(value, &size, sizeof(size));
+        value = hash(value, source.data(), source.size());
+    }
+    char key[17];
+    std::snprintf(key, sizeof(key), "%016llx", static_cast<unsigned long long>(value));
+    return key;
+}
+
+const our::program_cache::Statistics& our::program_cache::getStatistics() {
+    return statistics;
+}
+
+bool our::program_cache::load(GLuint program, const std::string& key) {
+    // The program is counted as built until its binary is accepted by the driver
+    statistics.built++;
+    if(!isEnabled()) return false;
+    std::ifstream file(getPath(key), std::ios::binary);
+    if(!file) return false;
+    // The file starts with the format of the binary, followed by the binary itself
+    GLenum format;
+    if(!file.read(reinterpret_cast<char*>(&format), sizeof(format))) return false;
+    std::vector<char> binary((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    if(binary.empty()) return false;
+    glProgramBinary(program, format, binary.data(), GLsizei(binary.size()));
+    GLint status = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &status);
+    if(status != GL_TRUE) return false;
+    statistics.built--;
+    statistics.loaded++;
+    return true;
+}
+
+void our::program_cache::save(GLuint program, const std::string& key) {
+    if(!isEnabled()) return;
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if(length <= 0) return;
+    std::vector<char> binary(length);
+    GLenum format;
+    glGetProgramBinary(program, length, &length, &format, binary.data());
+    if(length <= 0) return;
+
+    std::error_code ec;
+    std::filesystem::create_directories(cacheDirectory, ec);
+    if(ec) return;
+    // The binary is written to a temporary file then renamed, so a reader never sees a partially written binary
+    auto path = getPath(key), temporaryPath = path;
+    temporaryPath += ".tmp";
+    {
+        std::ofstream file(temporaryPath, std::ios::binary);
+        if(!file) return;
+        file.write(reinterpret_cast<const char*>(&format), sizeof(format));
+        file.write(binary.data(), length);
+        if(!file) return;
+    }
+    std::filesystem::rename(temporaryPath, path, ec);
+    if(ec) std::filesystem::remove(temporaryPath, ec);
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <glad/gl.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace our::program_cache {
+
+    // Sets the directory where the linked program binaries are stored and reads the driver strings that are part of every key
+    // An empty directory disables the cache. It should be called once the OpenGL context is created
+    void initialize(const std::string& directory);
+
+    // Returns true if the cache is enabled and the driver can save and load program binaries (OpenGL 4.1 or ARB_get_program_binary)
+    bool isEnabled();
+
+    // Returns a key identifying a program built from the given stages (a stage is a shader type and its complete source)
+    // The driver strings are part of the key, so a driver update never loads the binaries of an older driver
+    std::string makeKey(const std::vector<std::pair<GLenum, std::string>>& stages);
+
+    // Loads the binary saved under the given key into the program and returns true if the driver accepted it
+    // A rejected binary leaves the program unlinked, so it can still be built from source
+    bool load(GLuint program, const std::string& key);
+
+    // The number of programs loaded from the cache and of programs that had to be built from source since "initialize"
+    struct Statistics {
+        size_t loaded = 0, built = 0;
+    };
+    const Statistics& getStatistics();
+
+    // Saves the binary of the given linked program under the given key
+    // The program should be linked with GL_PROGRAM_BINARY_RETRIEVABLE_HINT set, or some drivers will return no binary
+    void save(GLuint program, const std::string& key);
+
+}
@@ -0,0 +1,59 @@
+#include "shader-preprocessor.hpp"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+namespace {
+
+    // Returns true if "line" (ignoring its leading spaces) starts with the given directive, and puts the rest of the line in "rest"
+    bool matchDirective(const std::string& line, const char* directive, std::string& rest) {
+        size_t start = line.find_first_not_of(" \t");
+        if(start == std::string::npos || line.compare(start, std::char_traits<char>::length(directive), directive) != 0) return false;
+        rest = line.substr(start + std::char_traits<char>::length(directive));
+        return true;
+    }
+
+    bool expand(const std::filesystem::path& path, const our::ShaderDefines& defines, std::string& source, std::vector<std::string>& files) {
+        std::ifstream file(path);
+        if(!file){
+            std::cerr << "ERROR: Couldn't open shader file: " << path.string() << std::endl;
+            return false;
+        }
+        int fileIndex = int(files.size());
+        files.push_back(path.string());
+
+        std::string line, rest;
+        for(int lineNumber = 1; std::getline(file, line); ++lineNumber) {
+            if(fileIndex == 0 && matchDirective(line, "#version", rest)) {
+                // The defines must come after "#version", which must be the first directive of the shader
+                source += line + '\n';
+                for(auto& [name, value] : defines) source += "#define " + name + " " + value + '\n';
+                source += "#line " + std::to_string(lineNumber + 1) + " 0\n";
+            } else if(matchDirective(line, "#include", rest)) {
+                size_t open = rest.find('"'), close = rest.rfind('"');
+                if(open == std::string::npos || close == open) {
+                    std::cerr << "ERROR: Invalid include in " << path.string() << "(" << lineNumber << "): " << line << std::endl;
+                    return false;
+                }
+                auto includedPath = (path.parent_path() / rest.substr(open + 1, close - open - 1)).lexically_normal();
+                if(std::find(files.begin(), files.end(), includedPath.string()) == files.end()) {
+                    source += "#line 1 " + std::to_string(files.size()) + '\n';
+                    if(!expand(includedPath, defines, source, files)) return false;
+                }
+                source += "#line " + std::to_string(lineNumber + 1) + " " + std::to_string(fileIndex) + '\n';
+            } else {
+                source += line + '\n';
+            }
+        }
+        return true;
+    }
+
+}
+
+bool our::shader_preprocessor::preprocess(const std::string& filename, const ShaderDefines& defines, std::string& source, std::vector<std::string>& files) {
+    source.clear();
+    files.clear();
+    return expand(std::filesystem::path(filename).lexically_normal(), defines, source, files);
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace our {
+
+    // The macros defined before compiling a shader (name -> value, the value may be empty)
+    // It is ordered, so two equal sets of defines always give the same source (and the same program cache key)
+    using ShaderDefines = std::map<std::string, std::string>;
+
+    namespace shader_preprocessor {
+
+        // Reads the given shader file and returns its source with:
+        // - every '#include "path"' replaced by the content of the file (the path is relative to the including file).
+        //   Each file is included at most once per shader, so the shared files need no include guards
+        // - the given defines added right after the "#version" line
+        // - "#line" directives so the compiler reports the line numbers of the original files. The source string number
+        //   of a file is its index in "files" (the main file is 0), which receives the paths of all the files read
+        // Returns false (and prints the error) if a file couldn't be read
+        bool preprocess(const std::string& filename, const ShaderDefines& defines, std::string& source, std::vector<std::string>& files);
+
+    }
+
+}
@@ -1,61 +1,138 @@
 #include "shader.hpp"
+#include "program-cache.hpp"
 
 #include <cassert>
 #include <iostream>
-#include <fstream>
 #include <string>
 
 //Forward definition for error checking functions
 std::string checkForShaderCompilationErrors(GLuint shader);
 std::string checkForLinkingErrors(GLuint program);
 
-bool our::ShaderProgram::attach(const std::string &filename, GLenum type) const {
-    // Here, we open the file and read a string from it containing the GLSL code of our shader
-    std::ifstream file(filename);
-    if(!file){
-        std::cerr << "ERROR: Couldn't open shader file: " << filename << std::endl;
-        return false;
-    }
-    std::string sourceString = std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
-    const char* sourceCStr = sourceString.c_str();
-    file.close();
-
-    GLuint shaderID = glCreateShader(type);
-
-    // send the source code to the shader and compile it
-    glShaderSource(shaderID, 1, &sourceCStr, nullptr);
-    glCompileShader(shaderID);
-    
-    if(std::string error = checkForShaderCompilationErrors(shaderID); error.size() != 0){
-        std::cerr << "ERROR IN " << filename << std::endl;
-        std::cerr << error << std::endl;
-        glDeleteShader(shaderID);
-        return false;
-    }
+bool our::ShaderProgram::attach(const std::string &filename, GLenum type, const ShaderDefines &defines) {
+    // Here, we read the GLSL code of our shader with the content of its includes
+    std::string sourceString;
+    std::vector<std::string> files;
+    if(!shader_preprocessor::preprocess(filename, defines, sourceString, files)) return false;
 
-    
-    // attach the shader to the program then delete the shader
-    glAttachShader(program, shaderID);
-    glDeleteShader(shaderID);
-
-    //We return true since the compilation succeeded
+    // The source is kept until the program is linked, since it is not compiled at all if the program is found in the cache
+    stageFiles.push_back(std::move(files));
+    stageSources.emplace_back(type, std::move(sourceString));
     return true;
 }
 
+bool our::ShaderProgram::link() {
+    beginLink();
+    return finishLink();
+}
 
+void our::ShaderProgram::beginLink() {
+    cacheKey = program_cache::makeKey(stageSources);
+    if(program_cache::load(program, cacheKey)) return;
 
-bool our::ShaderProgram::link() const {
-    // call opengl to link the program identified by this->program 
+    // The binary is missing or was rejected by the driver, so the program is built from source
+    for(auto& [type, source] : stageSources) {
+        const char* sourceCStr = source.c_str();
+        GLuint shaderID = glCreateShader(type);
+        // send the source code to the shader and compile it (the status is only read by "finishLink", so this doesn't wait)
+        glShaderSource(shaderID, 1, &sourceCStr, nullptr);
+        glCompileShader(shaderID);
+        glAttachShader(program, shaderID);
+        stageShaders.push_back(shaderID);
+    }
+    if(program_cache::isEnabled()) glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    // call opengl to link the program identified by this->program
     glLinkProgram(program);
+}
 
-    if(auto error = checkForLinkingErrors(program); error.size() != 0){
-        std::cerr << "LINKING ERROR" << std::endl;
-        std::cerr << error << std::endl;
-        return false;
+bool our::ShaderProgram::finishLink() {
+    bool builtFromSource = !stageShaders.empty();
+    bool linked = true;
+    if(builtFromSource) {
+        // The compilation errors are checked first since they explain the linking error that follows them
+        for(size_t stage = 0; stage < stageShaders.size(); ++stage) {
+            if(std::string error = checkForShaderCompilationErrors(stageShaders[stage]); error.size() != 0){
+                const auto& files = stageFiles[stage];
+                std::cerr << "ERROR IN " << files.front() << std::endl;
+                // The errors give the source string number of their file
+                for(size_t index = 1; index < files.size(); ++index) std::cerr << "  source string " << index << ": " << files[index] << std::endl;
+                std::cerr << error << std::endl;
+                linked = false;
+            }
+        }
+        if(linked) {
+            if(auto error = checkForLinkingErrors(program); error.size() != 0){
+                std::cerr << "LINKING ERROR" << std::endl;
+                std::cerr << error << std::endl;
+                linked = false;
+            }
+        }
+        // The shaders are no longer needed once the program is linked
+        for(GLuint shaderID : stageShaders) {
+            glDetachShader(program, shaderID);
+            glDeleteShader(shaderID);
+        }
+        stageShaders.clear();
     }
+    stageFiles.clear();
+    stageSources.clear();
+    if(!linked) return false;
+
+    if(builtFromSource) program_cache::save(program, cacheKey);
+    cacheUniformLocations();
+    bindUniformBlock(FRAME_UNIFORM_BLOCK_NAME, FRAME_UNIFORM_BINDING);
+    bindSampler(LIGHT_DATA_SAMPLER_NAME, LIGHT_DATA_TEXTURE_UNIT);
+    bindSampler(LIGHT_CLUSTERS_SAMPLER_NAME, LIGHT_CLUSTERS_TEXTURE_UNIT);
+    bindSampler(LIGHT_INDICES_SAMPLER_NAME, LIGHT_INDICES_TEXTURE_UNIT);
     return true;
 }
 
+void our::ShaderProgram::cacheUniformLocations() {
+    uniformLocations.clear();
+    handleLocations.clear();
+    GLint count = 0, maxLength = 0;
+    glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+    std::string name(maxLength, '\0');
+    for(GLint index = 0; index < count; ++index){
+        GLsizei length = 0;
+        GLint size = 0;
+        GLenum type;
+        glGetActiveUniform(program, index, maxLength, &length, &size, &type, name.data());
+        std::string uniformName = name.substr(0, length);
+        GLint location = glGetUniformLocation(program, uniformName.c_str());
+        if(location < 0) continue; // Uniforms inside uniform blocks have no location
+        uniformLocations[uniformName] = location;
+        // An array of basic types is reported once as "name[0]", so we add "name" and every element "name[i]"
+        if(size_t bracket = uniformName.rfind("[0]"); bracket != std::string::npos && bracket + 3 == uniformName.size()){
+            std::string arrayName = uniformName.substr(0, bracket);
+            uniformLocations[arrayName] = location;
+            for(GLint element = 1; element < size; ++element){
+                std::string elementName = arrayName + "[" + std::to_string(element) + "]";
+                uniformLocations[elementName] = glGetUniformLocation(program, elementName.c_str());
+            }
+        }
+    }
+}
+
+// The table of the names of all the uniform handles (a handle is an index in this table)
+static std::vector<std::string>& getHandleNames() {
+    static std::vector<std::string> names;
+    return names;
+}
+
+our::UniformHandle::UniformHandle(const std::string &name) {
+    static std::unordered_map<std::string, size_t> indices;
+    auto& names = getHandleNames();
+    auto [it, inserted] = indices.emplace(name, names.size());
+    if(inserted) names.push_back(name);
+    index = it->second;
+}
+
+const std::string& our::UniformHandle::getName() const {
+    return getHandleNames()[index];
+}
+
 ////////////////////////////////////////////////////////////////////
 // Function to check for compilation and linking error in shaders //
 ////////////////////////////////////////////////////////////////////
@@ -1,62 +1,166 @@
 #ifndef SHADER_HPP
 #define SHADER_HPP
 
+#include <cstdint>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 #include <glad/gl.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include "shared-bindings.hpp"
+#include "shader-preprocessor.hpp"
+#include "../gl-state.hpp"
+
 namespace our {
 
+    // A uniform handle is a pre-resolved uniform name. It is created once (usually as a static variable) and can then be used
+    // to set the uniform of any shader program without any string work: each program caches the location of each handle
+    // in an array indexed by the handle.
+    class UniformHandle {
+        size_t index; // The index of the name in the table of all the uniform names used through handles
+    public:
+        explicit UniformHandle(const std::string& name);
+
+        // Returns the index of this handle (the handles are numbered from 0 in their creation order)
+        size_t getIndex() const { return index; }
+        // Returns the uniform name of this handle
+        const std::string& getName() const;
+    };
+
     class ShaderProgram {
 
     private:
         //Shader Program Handle (OpenGL object name)
         GLuint program;
+        // A small number identifying this program (assigned in creation order), used by the renderer to group the draws
+        inline static std::uint32_t createdCount = 0;
+        std::uint32_t sortID = createdCount++;
+        // The locations of all the active uniforms (filled once after linking)
+        std::unordered_map<std::string, GLint> uniformLocations;
+        // The locations of the uniforms that were accessed through handles (indexed by the handle index)
+        std::vector<GLint> handleLocations;
+
+        // The value stored in "handleLocations" for the handles whose location hasn't been looked up yet
+        static constexpr GLint UNRESOLVED_LOCATION = -2;
+
+        // The stages attached since the last link: the files read for each of them and their (type, source) pairs
+        std::vector<std::vector<std::string>> stageFiles;
+        std::vector<std::pair<GLenum, std::string>> stageSources;
+        // The shaders compiled by "beginLink" (empty if the program was loaded from the binary cache)
+        std::vector<GLuint> stageShaders;
+        // The key of the program in the binary cache (computed by "beginLink")
+        std::string cacheKey;
+
+        // Reads the names of all the active uniforms and caches their locations
+        void cacheUniformLocations();
 
     public:
         ShaderProgram(){ program = glCreateProgram(); }
-        ~ShaderProgram(){ if(program != 0) glDeleteProgram(program); }
+        ~ShaderProgram(){
+            if(program != 0) glDeleteProgram(program);
+            GLStateCache::getInstance().invalidate(); // The name may be reused by a new program, so the cache must not trust it
+        }
+
+        // Reads the source of a shader stage from the given file, resolving its includes and adding the given defines
+        // (see shader_preprocessor::preprocess). The source is only compiled when the program is linked (if no binary of the
+        // same sources is found in the program cache). Returns false if a file couldn't be read
+        bool attach(const std::string &filename, GLenum type, const ShaderDefines &defines = {});
+
+        // Builds the program from the attached stages. It is "beginLink" followed by "finishLink"
+        bool link();
 
-        bool attach(const std::string &filename, GLenum type) const;
+        // Starts building the program: it loads the binary of the program from the cache or sends the compile and link commands
+        // without waiting for them. If the driver supports GL_KHR_parallel_shader_compile, the work runs on the driver threads,
+        // so starting the links of many programs before finishing any of them lets their compiles overlap
+        void beginLink();
 
-        bool link() const;
+        // Waits for the program started by "beginLink" and reports the errors. A program built from source is saved to the cache
+        bool finishLink();
+
+        // Binds the uniform block with the given name to the given binding point (does nothing if the program has no such block)
+        // The shared blocks (like FRAME_UNIFORM_BLOCK_NAME) are bound to their fixed binding points by "link"
+        void bindUniformBlock(const std::string &blockName, GLuint binding) const {
+            GLuint index = glGetUniformBlockIndex(program, blockName.c_str());
+            if(index != GL_INVALID_INDEX) glUniformBlockBinding(program, index, binding);
+        }
+
+        // Makes the sampler with the given name read from the given texture unit (does nothing if the program has no such sampler)
+        // The shared samplers (like LIGHT_DATA_SAMPLER_NAME) are bound to their fixed texture units by "link"
+        void bindSampler(const std::string &samplerName, GLint unit) {
+            GLint location = getUniformLocation(samplerName);
+            if(location < 0) return;
+            use();
+            set(location, unit);
+        }
 
         void use() { 
-            glUseProgram(program);
+            GLStateCache::getInstance().useProgram(program);
+        }
+
+        std::uint32_t getSortID() const { return sortID; }
+
+        // Returns the location of the given uniform (or -1 if the program has no active uniform with this name)
+        // The location is read from the cache filled after linking, so OpenGL is never queried
+        GLint getUniformLocation(const std::string &name) const {
+            auto it = uniformLocations.find(name);
+            return it != uniformLocations.end() ? it->second : -1;
         }
 
-        GLuint getUniformLocation(const std::string &name) {
-            return glGetUniformLocation(program, name.c_str());
+        // Returns the location of the uniform of the given handle. Only the first call for each handle looks up the name
+        GLint getUniformLocation(const UniformHandle &handle) {
+            size_t index = handle.getIndex();
+            if(index >= handleLocations.size()) handleLocations.resize(index + 1, UNRESOLVED_LOCATION);
+            GLint& location = handleLocations[index];
+            if(location == UNRESOLVED_LOCATION) location = getUniformLocation(handle.getName());
+            return location;
         }
 
-        void set(const std::string &uniform, GLfloat value) {
-            glUniform1f(getUniformLocation(uniform), value);
+        void set(const std::string &uniform, GLfloat value) { set(getUniformLocation(uniform), value); }
+        void set(const std::string &uniform, GLuint value) { set(getUniformLocation(uniform), value); }
+        void set(const std::string &uniform, GLint value) { set(getUniformLocation(uniform), value); }
+        void set(const std::string &uniform, glm::vec2 value) { set(getUniformLocation(uniform), value); }
+        void set(const std::string &uniform, glm::vec3 value) { set(getUniformLocation(uniform), value); }
+        void set(const std::string &uniform, glm::vec4 value) { set(getUniformLocation(uniform), value); }
+        void set(const std::string &uniform, const glm::mat4 &matrix, GLboolean transpose = false) { set(getUniformLocation(uniform), matrix, transpose); }
+
+        void set(const UniformHandle &uniform, GLfloat value) { set(getUniformLocation(uniform), value); }
+        void set(const UniformHandle &uniform, GLuint value) { set(getUniformLocation(uniform), value); }
+        void set(const UniformHandle &uniform, GLint value) { set(getUniformLocation(uniform), value); }
+        void set(const UniformHandle &uniform, glm::vec2 value) { set(getUniformLocation(uniform), value); }
+        void set(const UniformHandle &uniform, glm::vec3 value) { set(getUniformLocation(uniform), value); }
+        void set(const UniformHandle &uniform, glm::vec4 value) { set(getUniformLocation(uniform), value); }
+        void set(const UniformHandle &uniform, const glm::mat4 &matrix, GLboolean transpose = false) { set(getUniformLocation(uniform), matrix, transpose); }
+
+        // These functions set a uniform given its location (a location of -1 is silently ignored by OpenGL)
+        void set(GLint location, GLfloat value) {
+            glUniform1f(location, value);
         }
 
-        void set(const std::string &uniform, GLuint value) {
-            glUniform1ui(getUniformLocation(uniform), value);
+        void set(GLint location, GLuint value) {
+            glUniform1ui(location, value);
         }
 
-        void set(const std::string &uniform, GLint value) {
-            glUniform1i(getUniformLocation(uniform), value);
+        void set(GLint location, GLint value) {
+            glUniform1i(location, value);
         }
 
-        void set(const std::string &uniform, glm::vec2 value) {
-            glUniform2f(getUniformLocation(uniform), value.x, value.y);
+        void set(GLint location, glm::vec2 value) {
+            glUniform2f(location, value.x, value.y);
         }
 
-        void set(const std::string &uniform, glm::vec3 value) {
-            glUniform3f(getUniformLocation(uniform), value.x, value.y, value.z);
+        void set(GLint location, glm::vec3 value) {
+            glUniform3f(location, value.x, value.y, value.z);
         }
 
-        void set(const std::string &uniform, glm::vec4 value) {
-            glUniform4f(getUniformLocation(uniform), value.x, value.y, value.z, value.w);
+        void set(GLint location, glm::vec4 value) {
+            glUniform4f(location, value.x, value.y, value.z, value.w);
         }
 
-        void set(const std::string &uniform, glm::mat4 matrix, GLboolean transpose = false) {
-            glUniformMatrix4fv(getUniformLocation(uniform), 1, transpose, glm::value_ptr(matrix));
+        void set(GLint location, const glm::mat4 &matrix, GLboolean transpose = false) {
+            glUniformMatrix4fv(location, 1, transpose, glm::value_ptr(matrix));
         }
 
         ShaderProgram(ShaderProgram const &) = delete;
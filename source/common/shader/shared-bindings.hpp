@@ -0,0 +1,20 @@
+#pragma once
+
+// The fixed binding points of the resources shared by all the shaders
+// GLSL 3.30 can't set the binding of a block or a sampler in the shader, so each program binds them to these points after linking
+
+// The uniform block holding the data shared by all the draws of a frame (camera, directional lights and cluster grid parameters)
+#define FRAME_UNIFORM_BINDING 0
+#define FRAME_UNIFORM_BLOCK_NAME "FrameData"
+
+// The buffer textures of the clustered lighting (the last texture units, so they never collide with the material textures)
+#define LIGHT_DATA_TEXTURE_UNIT 13
+#define LIGHT_DATA_SAMPLER_NAME "light_data"
+#define LIGHT_CLUSTERS_TEXTURE_UNIT 14
+#define LIGHT_CLUSTERS_SAMPLER_NAME "light_clusters"
+#define LIGHT_INDICES_TEXTURE_UNIT 15
+#define LIGHT_INDICES_SAMPLER_NAME "light_indices"
+
+// The storage buffers of the GPU culling compute shader (GLSL 4.30 sets these bindings in the shader itself)
+#define GPU_CULLING_OBJECT_BINDING 0
+#define GPU_CULLING_COMMAND_BINDING 1
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <glad/gl.h>
+#include <cstddef>
+
+namespace our {
+
+    // This class defines an OpenGL buffer used as a GL_UNIFORM_BUFFER
+    // It holds data shared by many draw calls (and many shader programs) which is uploaded once instead of once per program
+    class UniformBuffer {
+        // The OpenGL object name of this buffer
+        GLuint name = 0;
+        // The size of the buffer in bytes
+        size_t size;
+    public:
+        // This constructor creates an uninitialized buffer of the given size
+        explicit UniformBuffer(size_t size) : size(size) {
+            glGenBuffers(1, &name);
+            glBindBuffer(GL_UNIFORM_BUFFER, name);
+            glBufferData(GL_UNIFORM_BUFFER, size, nullptr, GL_DYNAMIC_DRAW);
+            glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        }
+
+        // This deconstructor deletes the underlying OpenGL buffer
+        ~UniformBuffer() {
+            glDeleteBuffers(1, &name);
+        }
+
+        // Replaces the first "dataSize" bytes of the buffer
+        // The old storage is orphaned first, so the driver doesn't wait for the draws of the previous frame that still read it
+        void update(const void* data, size_t dataSize) {
+            glBindBuffer(GL_UNIFORM_BUFFER, name);
+            glBufferData(GL_UNIFORM_BUFFER, size, nullptr, GL_DYNAMIC_DRAW);
+            glBufferSubData(GL_UNIFORM_BUFFER, 0, dataSize < size ? dataSize : size, data);
+            glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        }
+
+        // Binds the whole buffer to the given uniform block binding point
+        void bind(GLuint binding) const {
+            glBindBufferBase(GL_UNIFORM_BUFFER, binding, name);
+        }
+
+        size_t getSize() const { return size; }
+
+        UniformBuffer(const UniformBuffer&) = delete;
+        UniformBuffer& operator=(const UniformBuffer&) = delete;
+    };
+
+}
@@ -4,96 +4,343 @@
 #include "../components/camera.hpp"
 #include "../components/mesh-renderer.hpp"
 #include "../components/light.hpp"
+#include "../jobs/job-system.hpp"
+#include "../shader/uniform-buffer.hpp"
+#include "../shader/shared-bindings.hpp"
+#include "../texture/texture-buffer.hpp"
+#include "light-clusters.hpp"
+#include "render-queue.hpp"
+#include "../mesh/instance-buffer.hpp"
+#include "../mesh/ring-buffer.hpp"
+#include "frustum-culling.hpp"
+#include "occlusion-culling.hpp"
+#include "gpu-scene.hpp"
+#include "mesh-lod.hpp"
 
 #include <glad/gl.h>
 #include <vector>
 #include <algorithm>
+#include <memory>
+#include <cstddef>
 #include <stdlib.h>
 
-#define TRANSPOSE true
+// The number of mesh renderers processed by each job while building the render commands
+#define RENDER_COMMAND_GRAIN_SIZE 1024
+
+// The minimum number of consecutive commands with the same mesh and material that are drawn as a single instanced draw call
+// when the instance data goes through the InstanceBuffer (with the RingBuffer, every command with an instanced shader is instanced)
+#define INSTANCING_MIN_COUNT 2
+// The number of instances per frame that the RingBuffer holds when it is created (it grows if a frame needs more)
+#define INSTANCE_RING_INITIAL_CAPACITY 1024
+
+// The shaders of the depth pre-pass (they only output the position, so every opaque material shares them)
+// The instanced program is built from the same vertex shader with INSTANCED defined
+#define DEPTH_PREPASS_VERTEX_SHADER_PATH "assets/shaders/depth.vert"
+#define DEPTH_PREPASS_FRAGMENT_SHADER_PATH "assets/shaders/depth.frag"
+
+// The maximum number of directional lights (it must match MAX_DIRECTIONAL_LIGHT_COUNT in frame-data.glsl)
+// The point and spot lights are not limited since they go through the light clusters
+#define MAX_DIRECTIONAL_LIGHT_COUNT 8
 
 namespace our
 {
-    
-    // The render command stores command that tells the renderer that it should draw
-    // the given mesh at the given localToWorld matrix using the given material
-    // The renderer will fill this struct using the mesh renderer components
-    struct RenderCommand {
-        glm::mat4 localToWorld;
-        glm::vec3 center;
-        Mesh* mesh;
-        Material* material;
-    };
 
     struct LightCommand {
         glm::mat4 localToWorld;
         LightComponent* light;
     };
 
+    // A light as it is laid out in the frame uniform block (std140) and in the light data buffer texture (4 RGBA32F texels)
+    // The members are ordered so that every vec3 is followed by a scalar that fills the rest of its 16 bytes
+    struct alignas(16) LightData {
+        glm::vec3 color;
+        GLint type;
+        glm::vec3 position;
+        GLfloat attenuationConstant;
+        glm::vec3 direction;
+        GLfloat attenuationLinear;
+        GLfloat attenuationQuadratic;
+        GLfloat innerAngle, outerAngle;
+        GLfloat range;
+    };
+    static_assert(sizeof(LightData) == 64, "LightData must match the std140 layout of the Light struct in frame-data.glsl");
+
+    // The data shared by all the draws of a frame as it is laid out in the frame uniform block (std140)
+    // It is uploaded once per frame and bound to FRAME_UNIFORM_BINDING
+    struct FrameData {
+        glm::mat4 viewProjection;
+        glm::vec3 cameraPosition;
+        GLint directionalLightCount;
+        glm::vec3 cameraForward;
+        GLfloat clusterDepthScale; // A fragment at the view depth "d" is in the slice "floor(log(d) * clusterDepthScale + clusterDepthBias)"
+        glm::vec2 viewportStart;
+        glm::vec2 clusterTileSize; // The size of the screen tile of a cluster in pixels
+        GLfloat clusterDepthBias;
+        GLint clusterCountX, clusterCountY, clusterCountZ;
+        LightData directionalLights[MAX_DIRECTIONAL_LIGHT_COUNT];
+    };
+    static_assert(sizeof(FrameData) == 128 + 64 * MAX_DIRECTIONAL_LIGHT_COUNT, "FrameData must match the std140 layout of the FrameData block in frame-data.glsl");
+
+    // The number of mesh renderers culled during the last frame
+    struct CullingStats {
+        std::uint64_t meshRenderers = 0; // All the mesh renderers of the world
+        std::uint64_t frustumCulled = 0; // The mesh renderers outside the view frustum
+        std::uint64_t occlusionCulled = 0; // The mesh renderers in the view frustum but hidden behind the occluders
+        std::uint64_t gpuDriven = 0; // The mesh renderers culled and drawn by the GPU scene (they are not in the other counters)
+        OcclusionStats occlusion; // The occluders rasterized by the occlusion culling (zero if it is disabled)
+    };
+
     // A forward renderer is a renderer that draw the object final color directly to the framebuffer
     // In other words, the fragment shader in the material should output the color that we should see on the screen
     // This is different from more complex renderers that could draw intermediate data to a framebuffer before computing the final color
     // In this project, we only need to implement a forward renderer
     class ForwardRenderer {
-        // These are two vectors in which we will store the opaque and the transparent commands.
+        // These are two queues in which we will store the opaque and the transparent commands.
         // We define them here (instead of being local to the "render" function) as an optimization to prevent reallocating them every frame
-        std::vector<RenderCommand> opaqueCommands;
-        std::vector<RenderCommand> transparentCommands;
+        RenderQueue opaqueCommands;
+        RenderQueue transparentCommands;
         std::vector<LightCommand> lightCommands;
-    public:
-        // This function should be called every frame to draw the given world
-        // Both viewportStart and viewportSize are using to define the area on the screen where we will draw the scene
-        // viewportStart is the lower left corner of the viewport (in pixels)
-        // viewportSize is the width & height of the viewport (in pixels). It is also used to compute the aspect ratio
-        void render(World* world, glm::ivec2 viewportStart, glm::ivec2 viewportSize){
-            // First of all, we search for a camera and for all the mesh renderers
-            CameraComponent* camera = nullptr;
-            opaqueCommands.clear();
-            transparentCommands.clear();
-            for(auto entity : world->getEntities()){
-                // If we hadn't found a camera yet, we look for a camera in this entity
-                if(!camera) camera = entity->getComponent<CameraComponent>();
-                // If this entity has a mesh renderer component
-                if(auto meshRenderer = entity->getComponent<MeshRendererComponent>(); meshRenderer){
+
+        // The commands built by a single job. Each job fills its own buffer so the jobs never write to shared vectors.
+        struct CommandBuffer {
+            std::vector<RenderCommand> opaqueCommands;
+            std::vector<RenderCommand> transparentCommands;
+            // The mesh renderers of the job with their world space bounding spheres, which are culled together before building the commands
+            std::vector<std::pair<Entity*, MeshRendererComponent*>> candidates;
+            std::vector<glm::vec4> boundingSpheres;
+            std::vector<std::uint8_t> visible;
+            std::uint64_t frustumCulled, occlusionCulled;
+        };
+        // One buffer per job (kept between frames to reuse their memory)
+        std::vector<CommandBuffer> commandBuffers;
+
+        // The data shared by all the draws of the frame and the buffer it is uploaded to
+        // The buffer is created by the first frame since the renderer may be constructed before the OpenGL context
+        FrameData frameData;
+        std::unique_ptr<UniformBuffer> frameUniforms;
+
+        // The point and spot lights (in world space) with their bounding spheres, and the clusters they are binned into
+        std::vector<LightData> clusteredLights;
+        std::vector<LightBounds> clusteredLightBounds;
+        LightClusterGrid lightClusters;
+        // The buffer textures that hold the clustered lights, the (offset, count) of each cluster and the light lists of the clusters
+        std::unique_ptr<TextureBuffer> lightDataBuffer, lightClustersBuffer, lightIndicesBuffer;
+
+        // A run of consecutive commands of a queue drawn together
+        struct DrawBatch {
+            size_t first, count; // The range of the commands in the sorted queue
+            size_t firstInstance; // The first instance of the batch in the instance buffer (only for instanced batches)
+            bool instanced;
+        };
+        std::vector<DrawBatch> opaqueBatches, transparentBatches;
+        // The instance data of all the instanced batches of the frame is written directly into a persistently mapped ring buffer
+        // if the context supports it (OpenGL 4.4). Otherwise, it is gathered in "instances" then streamed to the instance buffer.
+        std::unique_ptr<RingBuffer> instanceRing;
+        std::vector<InstanceData> instances;
+        std::unique_ptr<InstanceBuffer> instanceBuffer;
+
+        // The optional CPU occlusion culling, which hides the objects behind the mesh renderers flagged as occluders
+        bool occlusionCulling = false;
+        OcclusionCuller occlusionCuller;
+        CullingStats cullingStats;
+
+        // The optional GPU driven path (OpenGL 4.3), which culls and draws the opaque mesh renderers it accepts without the CPU
+        // (see GPUScene). It is created by the first frame that uses it since it holds OpenGL objects.
+        bool gpuCulling = false;
+        std::unique_ptr<GPUScene> gpuScene;
+
+        // The optional depth pre-pass: the depth of the opaque meshes is drawn first with a trivial shader, then their color
+        // is drawn with an equal depth test, so the expensive fragment shaders only run once per pixel
+        bool depthPrepass = false;
+        std::unique_ptr<ShaderProgram> depthProgram, instancedDepthProgram;
+
+        // Multiplies the projected sizes at which the meshes switch to their simplified LODs (see LODSelector)
+        float lodScale = 1.0f;
+
+        // The handles of the uniforms set for every draw (so no uniform name is looked up while drawing)
+        inline static const UniformHandle objectToWorldUniform{"object_to_world"};
+        inline static const UniformHandle objectToWorldInvTransposeUniform{"object_to_world_inv_transpose"};
+
+        // Builds the opaque and transparent commands of all the mesh renderers in parallel then merges them in the entity order
+        // The mesh renderers whose bounding sphere is outside the frustum are skipped, and so are the ones hidden behind the occluders
+        // if "occlusion" is not null (the occluders themselves are never tested)
+        // If "gpuDriven" is true, the mesh renderers accepted by the GPU scene are skipped since the GPU scene draws them
+        // The sort key of each command is computed from its view depth along "cameraForward"
+        void collectRenderCommands(World* world, const frustum_culling::Frustum& frustum, const OcclusionCuller* occlusion, bool gpuDriven,
+                                   const LODSelector& lod, const glm::vec3& cameraPosition, const glm::vec3& cameraForward, float far){
+            auto meshRenderers = world->view<MeshRendererComponent>();
+            size_t count = meshRenderers.size();
+            size_t bufferCount = (count + RENDER_COMMAND_GRAIN_SIZE - 1) / RENDER_COMMAND_GRAIN_SIZE;
+            if(commandBuffers.size() < bufferCount) commandBuffers.resize(bufferCount);
+
+            JobSystem::getInstance().parallelFor(count, RENDER_COMMAND_GRAIN_SIZE, [&](size_t begin, size_t end){
+                CommandBuffer& buffer = commandBuffers[begin / RENDER_COMMAND_GRAIN_SIZE];
+                buffer.opaqueCommands.clear();
+                buffer.transparentCommands.clear();
+                buffer.candidates.clear();
+                buffer.boundingSpheres.clear();
+                buffer.frustumCulled = buffer.occlusionCulled = 0;
+                meshRenderers.forEachInRange(begin, end, [&](Entity* entity, MeshRendererComponent* meshRenderer){
+                    if(gpuDriven && GPUScene::accepts(meshRenderer)) return;
+                    const Mesh* mesh = meshRenderer->mesh;
+                    buffer.candidates.emplace_back(entity, meshRenderer);
+                    buffer.boundingSpheres.push_back(frustum_culling::transformSphere(
+                        entity->getLocalToWorldMatrix(), mesh->getBoundingSphereCenter(), mesh->getBoundingSphereRadius()));
+                });
+                // All the spheres of the job are tested at once (4 at a time with SIMD)
+                buffer.visible.resize(buffer.candidates.size());
+                frustum_culling::testSpheres(frustum, buffer.boundingSpheres.size(), buffer.boundingSpheres.data(), buffer.visible.data());
+                for(size_t index = 0; index < buffer.candidates.size(); index++){
+                    if(!buffer.visible[index]) { buffer.frustumCulled++; continue; }
+                    auto [entity, meshRenderer] = buffer.candidates[index];
+                    if(occlusion && !meshRenderer->occluder && !occlusion->isVisible(entity->getLocalToWorldMatrix(),
+                            meshRenderer->mesh->getBoundsMin(), meshRenderer->mesh->getBoundsMax())) {
+                        buffer.occlusionCulled++;
+                        continue;
+                    }
                     // We construct a command from it
                     RenderCommand command;
-                    command.localToWorld = meshRenderer->getOwner()->getLocalToWorldMatrix();
-                    command.center = glm::vec3(command.localToWorld * glm::vec4(0, 0, 0, 1));
-                    command.mesh = meshRenderer->mesh;
+                    command.localToWorld = entity->getLocalToWorldMatrix();
+                    command.normalMatrix = entity->getNormalMatrix();
+                    command.center = glm::vec3(command.localToWorld[3]);
+                    command.mesh = lod.select(meshRenderer, buffer.boundingSpheres[index]);
+                    // The quantized positions are decoded by the object matrix (the depth pre-pass uses the same matrix)
+                    if(command.mesh->hasQuantizedPositions()) command.localToWorld *= command.mesh->getPositionDecoding();
                     command.material = meshRenderer->material;
+                    float depth = glm::dot(command.center - cameraPosition, cameraForward);
+                    std::uint32_t layer = std::min<std::uint32_t>(meshRenderer->layer, RENDER_LAYER_COUNT - 1);
                     // if it is transparent, we add it to the transparent commands list
                     if(command.material->transparent){
-                        transparentCommands.push_back(command);
+                        command.sortKey = makeTransparentSortKey(layer, command.material, depth);
+                        buffer.transparentCommands.push_back(command);
                     } else {
                     // Otherwise, we add it to the opaque command list
-                        opaqueCommands.push_back(command);
+                        command.sortKey = makeOpaqueSortKey(layer, command.material, command.mesh, depth, far);
+                        buffer.opaqueCommands.push_back(command);
                     }
                 }
-                // If this entity has a light component
-                if (auto light = entity->getComponent<LightComponent>(); light) {
-                    LightCommand command;
-                    command.light = light;
-                    command.localToWorld = light->getOwner()->getLocalToWorldMatrix();
-                    lightCommands.push_back(command);
-                }
+            });
+
+            // The buffers are merged in order, so the commands are in the same order as if they were built on a single thread
+            size_t opaqueCount = 0, transparentCount = 0;
+            for(size_t index = 0; index < bufferCount; ++index){
+                opaqueCount += commandBuffers[index].opaqueCommands.size();
+                transparentCount += commandBuffers[index].transparentCommands.size();
+            }
+            opaqueCommands.reserve(opaqueCount);
+            transparentCommands.reserve(transparentCount);
+            cullingStats.meshRenderers = count;
+            cullingStats.frustumCulled = cullingStats.occlusionCulled = cullingStats.gpuDriven = 0;
+            for(size_t index = 0; index < bufferCount; ++index){
+                CommandBuffer& buffer = commandBuffers[index];
+                opaqueCommands.append(buffer.opaqueCommands.begin(), buffer.opaqueCommands.end());
+                transparentCommands.append(buffer.transparentCommands.begin(), buffer.transparentCommands.end());
+                cullingStats.frustumCulled += buffer.frustumCulled;
+                cullingStats.occlusionCulled += buffer.occlusionCulled;
             }
+        }
 
+        // Rasterizes the occluders in the view frustum into the depth buffer of the occlusion culler
+        void rasterizeOccluders(World* world, const frustum_culling::Frustum& frustum, const glm::mat4& VP){
+            occlusionCuller.beginFrame(VP);
+            world->forEach<MeshRendererComponent>([&](Entity* entity, MeshRendererComponent* meshRenderer){
+                if(!meshRenderer->occluder) return;
+                const Mesh* mesh = meshRenderer->mesh;
+                const glm::mat4& localToWorld = entity->getLocalToWorldMatrix();
+                glm::vec4 sphere = frustum_culling::transformSphere(localToWorld, mesh->getBoundingSphereCenter(), mesh->getBoundingSphereRadius());
+                std::uint8_t visible;
+                frustum_culling::testSpheres(frustum, 1, &sphere, &visible);
+                if(!visible) return;
+                occlusionCuller.addOccluder(localToWorld, mesh->getPositions().data(), mesh->getElements().data(), mesh->getElements().size());
+            });
+            occlusionCuller.rasterizeOccluders();
+            cullingStats.occlusion = occlusionCuller.getStats();
+        }
+    public:
+        // Reads the options of the renderer from a json object (the "renderer" object of the scene config):
+        // - "occlusionCulling": if true, the mesh renderers hidden behind the occluders are not drawn (false by default)
+        // - "gpuCulling": if true and the context supports OpenGL 4.3, the opaque mesh renderers are culled by a compute shader
+        //   and drawn with one multi-draw call per material (false by default)
+        // - "depthPrepass": if true, the depth of the opaque meshes is drawn before their color (false by default)
+        // - "lodScale": multiplies the projected sizes at which the meshes switch to their simplified LODs (1 by default,
+        //   a bigger value switches earlier and 0 always draws the full meshes)
+        void configure(const nlohmann::json& config){
+            occlusionCulling = config.value("occlusionCulling", false);
+            gpuCulling = config.value("gpuCulling", false);
+            depthPrepass = config.value("depthPrepass", false);
+            lodScale = config.value("lodScale", 1.0f);
+        }
+
+        // Returns the number of mesh renderers culled during the last frame
+        const CullingStats& getCullingStats() const { return cullingStats; }
+
+
+        // This function should be called every frame to draw the given world
+        // Both viewportStart and viewportSize are using to define the area on the screen where we will draw the scene
+        // viewportStart is the lower left corner of the viewport (in pixels)
+        // viewportSize is the width & height of the viewport (in pixels). It is also used to compute the aspect ratio
+        void render(World* world, glm::ivec2 viewportStart, glm::ivec2 viewportSize){
+            // The OpenGL state could have been changed since the last frame, so the cached state is reset (and its counters are saved)
+            GLStateCache::getInstance().beginFrame();
+
+            // First of all, we update the cached local to world matrices of the entities that moved since the last frame
+            world->updateTransforms();
+
+            // Then, we search for a camera and for all the mesh renderers
+            CameraComponent* camera = nullptr;
+            opaqueCommands.clear();
+            transparentCommands.clear();
+            // We take the first camera we find
+            world->forEach<CameraComponent>([&](Entity* /*entity*/, CameraComponent* cameraComponent){
+                if(!camera) camera = cameraComponent;
+            });
             // If there is no camera, we return (we cannot render without a camera)
             if(camera == nullptr) return;
 
+            const glm::mat4& cameraLocalToWorld = camera->getOwner()->getLocalToWorldMatrix();
             glm::vec4 localFowardDirection(0.0, 0.0, -1.0, 0.0);
-            glm::vec3 cameraForward = glm::vec3(camera->getOwner()->getLocalToWorldMatrix() * localFowardDirection);
+            glm::vec3 cameraForward = glm::normalize(glm::vec3(cameraLocalToWorld * localFowardDirection));
+            glm::vec3 cameraPosition = glm::vec3(cameraLocalToWorld * glm::vec4(0.0, 0.0, 0.0, 1.0));
+
+            // get the camera ViewProjection matrix
+            glm::mat4 view = camera->getViewMatrix();
+            glm::mat4 projection = camera->getProjectionMatrix(viewportSize);
+            glm::mat4 VP = projection * view;
 
-            std::sort(transparentCommands.begin(), transparentCommands.end(), [cameraForward](const RenderCommand& first, const RenderCommand& second){
-                glm::vec4 firstCoord(glm::vec4(first.center, 1.0));
-                glm::vec4 secondCoord(glm::vec4(second.center, 1.0));
-                glm::vec4 firstSecondVec(secondCoord - firstCoord);
+            // The occluders are rasterized first so the objects they hide can be culled while building the commands
+            frustum_culling::Frustum frustum = frustum_culling::extractFrustum(VP);
+            if(occlusionCulling) rasterizeOccluders(world, frustum, VP);
+            else cullingStats.occlusion = OcclusionStats();
 
-                return glm::dot(firstSecondVec, glm::vec4(cameraForward, 0)) < 0;
+            // For each visible mesh renderer component, we construct a command (this is split into jobs since it is independent for each entity)
+            bool gpuDriven = gpuCulling && GPUScene::isSupported();
+            // The distant meshes are drawn with fewer triangles (see LODSelector)
+            LODSelector lod(cameraPosition, projection, lodScale);
+            collectRenderCommands(world, frustum, occlusionCulling ? &occlusionCuller : nullptr, gpuDriven, lod, cameraPosition, cameraForward, camera->far);
+            // The GPU scene only uploads the objects that changed then culls all of them in a compute shader
+            if(gpuDriven){
+                if(!gpuScene) gpuScene = std::make_unique<GPUScene>();
+                cullingStats.gpuDriven = gpuScene->update(world, lod);
+                gpuScene->cull(frustum);
+            }
+            // For each light component
+            lightCommands.clear();
+            world->forEach<LightComponent>([&](Entity* entity, LightComponent* light){
+                LightCommand command;
+                command.light = light;
+                command.localToWorld = entity->getLocalToWorldMatrix();
+                lightCommands.push_back(command);
             });
 
-            // get the camera ViewProjection matrix
-            glm::mat4 VP = camera->getProjectionMatrix(viewportSize)* camera->getViewMatrix();
+            // The opaque commands are grouped by shader, material and mesh (front to back inside each group)
+            // and the transparent commands are ordered from back to front
+            opaqueCommands.sort();
+            transparentCommands.sort();
+
+            // upload the camera and the lights once for the whole frame
+            updateFrameUniforms(VP, cameraPosition, cameraForward, viewportStart, viewportSize);
+            // bin the point and spot lights into the clusters of the view frustum and upload the cluster lists
+            updateLightClusters(view, projection, camera->near, camera->far);
 
             // set the OpenGL viewport using viewportStart and viewportSize
             glViewport(viewportStart.x, viewportStart.y, viewportSize.x, viewportSize.y);
@@ -102,57 +349,277 @@ namespace our
             glClearDepth(1.0f); // depth = 1
 
             // set the color mask to true and the depth mask to true (to ensure the glClear will affect the framebuffer)
-            glColorMask(true, true, true, true);
-            glDepthMask(true);
+            GLStateCache& state = GLStateCache::getInstance();
+            state.setColorMask(glm::bvec4(true));
+            state.setDepthMask(true);
 
             // clear the color and depth buffers
             glClear(GL_COLOR_BUFFER_BIT);
             glClear(GL_DEPTH_BUFFER_BIT);
 
             // opaque commands should be drawn before transparent ones (order is important)
-            drawCommands(opaqueCommands, VP, camera, lightCommands);
-            drawCommands(transparentCommands, VP, camera, lightCommands);
+            // the consecutive commands sharing a mesh and a material are drawn as instances (the instances of a draw are rasterized
+            // in order, so this keeps the back to front order of the transparent commands)
+            uploadInstances();
+            // The objects of the GPU scene are all in layer 0, so they are drawn after the opaque batches of layer 0
+            // and before the ones of the upper layers to keep the order of the layers
+            size_t upperLayerBatch = gpuDriven ? findFirstUpperLayerBatch(opaqueCommands, opaqueBatches) : opaqueBatches.size();
+            if(depthPrepass){
+                drawDepthPrepass(opaqueCommands, opaqueBatches, 0, upperLayerBatch);
+                if(gpuDriven) gpuScene->drawDepth(*instancedDepthProgram);
+                drawDepthPrepass(opaqueCommands, opaqueBatches, upperLayerBatch, opaqueBatches.size());
+            }
+            drawBatches(opaqueCommands, opaqueBatches, 0, upperLayerBatch, depthPrepass);
+            if(gpuDriven) gpuScene->draw(depthPrepass);
+            drawBatches(opaqueCommands, opaqueBatches, upperLayerBatch, opaqueBatches.size(), depthPrepass);
+            drawBatches(transparentCommands, transparentBatches, 0, transparentBatches.size(), false);
+            // The region of the ring buffer written by this frame is not reused before the GPU finished these draws
+            if (instanceRing) instanceRing->fence();
+        }
+
+        // This releases the OpenGL objects of the renderer. It should be called while the OpenGL context still exists
+        // The objects are created again if the renderer is used afterwards
+        void destroy(){
+            frameUniforms.reset();
+            lightDataBuffer.reset();
+            lightClustersBuffer.reset();
+            lightIndicesBuffer.reset();
+            instanceBuffer.reset();
+            instanceRing.reset();
+            gpuScene.reset();
+            depthProgram.reset();
+            instancedDepthProgram.reset();
+        }
+
+        // Converts the light to world space using the transform of its entity
+        static LightData getLightData(const LightCommand& lightCommand)
+        {
+            const LightComponent* component = lightCommand.light;
+            LightData light;
+            light.type = static_cast<GLint>(component->lightType);
+            light.color = component->color;
+            light.position = glm::vec3(lightCommand.localToWorld * glm::vec4(component->position, 1.0f));
+            light.direction = glm::normalize(glm::mat3(lightCommand.localToWorld) * component->direction);
+            light.attenuationConstant = component->attenuation.x;
+            light.attenuationLinear = component->attenuation.y;
+            light.attenuationQuadratic = component->attenuation.z;
+            light.innerAngle = component->coneAngles.x;
+            light.outerAngle = component->coneAngles.y;
+            light.range = component->lightType == LightType::DIRECTIONAL ? 0.0f : component->getRange();
+            return light;
+        }
+
+        // Fills the frame uniform block with the camera, the cluster grid parameters and the directional lights
+        // then uploads it and binds it to FRAME_UNIFORM_BINDING. The point and spot lights are kept for the light clusters.
+        void updateFrameUniforms(const glm::mat4& VP, const glm::vec3& cameraPosition, const glm::vec3& cameraForward,
+                                 glm::ivec2 viewportStart, glm::ivec2 viewportSize)
+        {
+            frameData.viewProjection = VP;
+            frameData.cameraPosition = cameraPosition;
+            frameData.cameraForward = cameraForward;
+            frameData.viewportStart = glm::vec2(viewportStart);
+            frameData.clusterTileSize = glm::vec2(viewportSize) / glm::vec2(LIGHT_CLUSTER_COUNT_X, LIGHT_CLUSTER_COUNT_Y);
+            frameData.clusterCountX = LIGHT_CLUSTER_COUNT_X;
+            frameData.clusterCountY = LIGHT_CLUSTER_COUNT_Y;
+            frameData.clusterCountZ = LIGHT_CLUSTER_COUNT_Z;
+            // The directional lights light every fragment, so they are passed in a single array to the fragment shader
+            GLint count = 0;
+            clusteredLights.clear();
+            clusteredLightBounds.clear();
+            for (const auto& lightCommand : lightCommands)
+            {
+                LightData light = getLightData(lightCommand);
+                if (lightCommand.light->lightType != LightType::DIRECTIONAL) {
+                    if (light.range <= 0) continue; // The light is too dark to be seen
+                    clusteredLights.push_back(light);
+                    clusteredLightBounds.push_back({light.position, light.range});
+                } else if (count < MAX_DIRECTIONAL_LIGHT_COUNT) {
+                    frameData.directionalLights[count++] = light;
+                }
+            }
+            frameData.directionalLightCount = count;
+        }
+
+        // Bins the point and spot lights into the clusters then uploads the lights and the cluster lists to the buffer textures
+        // This also uploads the frame uniform block since it holds the depth parameters of the clusters
+        void updateLightClusters(const glm::mat4& view, const glm::mat4& projection, float near, float far)
+        {
+            lightClusters.build(clusteredLightBounds, view, projection, near, far);
+            frameData.clusterDepthScale = lightClusters.getDepthScale();
+            frameData.clusterDepthBias = lightClusters.getDepthBias();
+
+            if (!frameUniforms) {
+                frameUniforms = std::make_unique<UniformBuffer>(sizeof(FrameData));
+                lightDataBuffer = std::make_unique<TextureBuffer>(GL_RGBA32F);
+                lightClustersBuffer = std::make_unique<TextureBuffer>(GL_RG32UI);
+                lightIndicesBuffer = std::make_unique<TextureBuffer>(GL_R32UI);
+            }
+            // Only the directional lights in use are uploaded
+            frameUniforms->update(&frameData, offsetof(FrameData, directionalLights) + frameData.directionalLightCount * sizeof(LightData));
+            frameUniforms->bind(FRAME_UNIFORM_BINDING);
+
+            const auto& clusters = lightClusters.getClusters();
+            const auto& lightIndices = lightClusters.getLightIndices();
+            lightDataBuffer->update(clusteredLights.data(), clusteredLights.size() * sizeof(LightData));
+            lightClustersBuffer->update(clusters.data(), clusters.size() * sizeof(glm::uvec2));
+            lightIndicesBuffer->update(lightIndices.data(), lightIndices.size() * sizeof(std::uint32_t));
+            lightDataBuffer->bind(LIGHT_DATA_TEXTURE_UNIT);
+            lightClustersBuffer->bind(LIGHT_CLUSTERS_TEXTURE_UNIT);
+            lightIndicesBuffer->bind(LIGHT_INDICES_TEXTURE_UNIT);
+        }
+
+        // Splits the sorted commands into batches: the runs of commands with the same mesh and material become instanced batches
+        // if the material has an instanced shader and the run has at least "minInstanceCount" commands
+        // Since the commands are sorted by shader, material and mesh, all the opaque commands that can share a draw call are consecutive
+        // Returns the number of instances after the batches (their instances are numbered from "firstInstance")
+        static size_t batchCommands(const RenderQueue& renderCommands, std::vector<DrawBatch>& batches, size_t firstInstance, size_t minInstanceCount)
+        {
+            batches.clear();
+            size_t count = renderCommands.size();
+            for (size_t first = 0; first < count;)
+            {
+                const RenderCommand& command = renderCommands[first];
+                size_t end = first + 1;
+                // A batch never spans two layers, so the batches of a layer can be drawn apart from the others
+                std::uint32_t layer = sort_key::layer(command.sortKey);
+                while (end < count && renderCommands[end].mesh == command.mesh && renderCommands[end].material == command.material &&
+                       sort_key::layer(renderCommands[end].sortKey) == layer) end++;
+                if (command.material->instancedShader && end - first >= minInstanceCount) {
+                    batches.push_back({first, end - first, firstInstance, true});
+                    firstInstance += end - first;
+                } else {
+                    batches.push_back({first, end - first, 0, false});
+                }
+                first = end;
+            }
+            return firstInstance;
         }
 
-        void drawCommands(std::vector<RenderCommand>& renderCommands, glm::mat4& VP, CameraComponent*& camera, std::vector<LightCommand>& lightCommands)
+        // Returns the index of the first batch that is not in layer 0 (or the number of batches if they are all in layer 0)
+        static size_t findFirstUpperLayerBatch(const RenderQueue& renderCommands, const std::vector<DrawBatch>& batches)
         {
-            for (auto renderCommand : renderCommands)
+            size_t index = 0;
+            while (index < batches.size() && sort_key::layer(renderCommands[batches[index].first].sortKey) == 0) index++;
+            return index;
+        }
+
+        // Writes the instance data of the instanced batches at their instance index in "destination"
+        static void writeInstances(const RenderQueue& renderCommands, const std::vector<DrawBatch>& batches, InstanceData* destination)
+        {
+            for (const DrawBatch& batch : batches)
             {
-                renderCommand.material->setup();
-                setVertexShaderUniforms(renderCommand, VP, camera);
-                setFragmentShaderUniforms(lightCommands, renderCommand);
-                renderCommand.mesh->draw();
+                if (!batch.instanced) continue;
+                for (size_t index = 0; index < batch.count; index++)
+                {
+                    const RenderCommand& command = renderCommands[batch.first + index];
+                    destination[batch.firstInstance + index] = {command.localToWorld, command.normalMatrix};
+                }
             }
         }
-        void setVertexShaderUniforms(our::RenderCommand& renderCommand, glm::mat4& VP, our::CameraComponent*& camera)
+
+        // Batches the opaque and transparent commands then uploads the instance data of all the instanced batches at once
+        // With the ring buffer, even a single command is drawn as an instance since it costs no uniform call
+        void uploadInstances()
         {
-            renderCommand.material->shader->set("object_to_world", renderCommand.localToWorld);
-            renderCommand.material->shader->set("view_projection", VP);
-            glm::vec4 eye(0.0, 0.0, 0.0, 1.0);
-            glm::vec3 cameraPosition = glm::vec3(camera->getOwner()->getLocalToWorldMatrix() * eye);
-            renderCommand.material->shader->set("camera_position", cameraPosition);
-            renderCommand.material->shader->set("object_to_world_inv_transpose", glm::inverse(renderCommand.localToWorld), TRANSPOSE);
-        }
-        void setFragmentShaderUniforms(std::vector<our::LightCommand>& lightCommands, our::RenderCommand& renderCommand)
+            bool persistentMapping = RingBuffer::isSupported();
+            size_t minInstanceCount = persistentMapping ? 1 : INSTANCING_MIN_COUNT;
+            size_t instanceCount = batchCommands(opaqueCommands, opaqueBatches, 0, minInstanceCount);
+            instanceCount = batchCommands(transparentCommands, transparentBatches, instanceCount, minInstanceCount);
+            if (instanceCount == 0) return;
+            if (persistentMapping) {
+                if (!instanceRing) instanceRing = std::make_unique<RingBuffer>(sizeof(InstanceData), INSTANCE_RING_INITIAL_CAPACITY);
+                InstanceData* destination = static_cast<InstanceData*>(instanceRing->map(instanceCount));
+                writeInstances(opaqueCommands, opaqueBatches, destination);
+                writeInstances(transparentCommands, transparentBatches, destination);
+            } else {
+                instances.resize(instanceCount);
+                writeInstances(opaqueCommands, opaqueBatches, instances.data());
+                writeInstances(transparentCommands, transparentBatches, instances.data());
+                if (!instanceBuffer) instanceBuffer = std::make_unique<InstanceBuffer>();
+                instanceBuffer->update(instances.data(), instances.size());
+            }
+        }
+
+        // Draws the instances of an instanced batch from the ring buffer or the instance buffer (the program must be in use)
+        void drawInstancedBatch(const RenderQueue& renderCommands, const DrawBatch& batch)
+        {
+            Mesh* mesh = renderCommands[batch.first].mesh;
+            if (instanceRing) mesh->drawInstanced(*instanceRing, instanceRing->getFirstElement() + batch.firstInstance, GLsizei(batch.count));
+            else mesh->drawInstanced(*instanceBuffer, batch.firstInstance, GLsizei(batch.count));
+        }
+
+        // Draws the batches from "begin" to "end" (excluded)
+        // If "depthPrepassed" is true, the batches whose material can be drawn by the depth pre-pass are drawn with an equal
+        // depth test and no depth writes since their depth is already in the depth buffer
+        void drawBatches(const RenderQueue& renderCommands, const std::vector<DrawBatch>& batches, size_t begin, size_t end, bool depthPrepassed)
         {
-            // we use single pass forward ligting, that's why we pass all lights in a single array to fragment shader
-            int i = 0;
-            for (auto lightCommand : lightCommands)
+            GLStateCache& state = GLStateCache::getInstance();
+            for (size_t batchIndex = begin; batchIndex < end; batchIndex++)
             {
-                renderCommand.material->shader->set("lights[" + std::to_string(i) + "].type", static_cast<int>(lightCommand.light->lightType));
-                renderCommand.material->shader->set("lights[" + std::to_string(i) + "].color", lightCommand.light->color);
-                renderCommand.material->shader->set("lights[" + std::to_string(i) + "].position", lightCommand.light->position);
-                renderCommand.material->shader->set("lights[" + std::to_string(i) + "].direction", glm::normalize(lightCommand.light->direction));
-                renderCommand.material->shader->set("lights[" + std::to_string(i) + "].attenuation_constant", lightCommand.light->attenuation.x);
-                renderCommand.material->shader->set("lights[" + std::to_string(i) + "].attenuation_linear", lightCommand.light->attenuation.y);
-                renderCommand.material->shader->set("lights[" + std::to_string(i) + "].attenuation_quadratic", lightCommand.light->attenuation.z);
-                renderCommand.material->shader->set("lights[" + std::to_string(i) + "].inner_angle", lightCommand.light->coneAngles.x);
-                renderCommand.material->shader->set("lights[" + std::to_string(i) + "].outer_angle", lightCommand.light->coneAngles.y);
-                i++;
+                const DrawBatch& batch = batches[batchIndex];
+                const Material* material = renderCommands[batch.first].material;
+                bool depthEqual = depthPrepassed && material->canDrawInDepthPrepass();
+                if (batch.instanced) {
+                    material->setup(true);
+                    if (depthEqual) { state.setDepthFunction(GL_EQUAL); state.setDepthMask(false); }
+                    drawInstancedBatch(renderCommands, batch);
+                    continue;
+                }
+                for (size_t index = batch.first; index < batch.first + batch.count; index++)
+                {
+                    const RenderCommand& renderCommand = renderCommands[index];
+                    renderCommand.material->setup();
+                    if (depthEqual) { state.setDepthFunction(GL_EQUAL); state.setDepthMask(false); }
+                    setObjectUniforms(renderCommand);
+                    renderCommand.mesh->draw();
+                }
             }
-            renderCommand.material->shader->set("light_count", i);
         }
-        ;
+
+        // Draws the depth of the opaque batches from "begin" to "end" (excluded) whose material can be drawn by the depth pre-pass
+        // (nothing is written to the color)
+        void drawDepthPrepass(const RenderQueue& renderCommands, const std::vector<DrawBatch>& batches, size_t begin, size_t end)
+        {
+            if (!depthProgram) {
+                depthProgram = std::make_unique<ShaderProgram>();
+                depthProgram->attach(DEPTH_PREPASS_VERTEX_SHADER_PATH, GL_VERTEX_SHADER);
+                depthProgram->attach(DEPTH_PREPASS_FRAGMENT_SHADER_PATH, GL_FRAGMENT_SHADER);
+                depthProgram->beginLink();
+                instancedDepthProgram = std::make_unique<ShaderProgram>();
+                instancedDepthProgram->attach(DEPTH_PREPASS_VERTEX_SHADER_PATH, GL_VERTEX_SHADER, {{"INSTANCED", ""}});
+                instancedDepthProgram->attach(DEPTH_PREPASS_FRAGMENT_SHADER_PATH, GL_FRAGMENT_SHADER);
+                instancedDepthProgram->beginLink();
+                depthProgram->finishLink();
+                instancedDepthProgram->finishLink();
+            }
+            for (size_t batchIndex = begin; batchIndex < end; batchIndex++)
+            {
+                const DrawBatch& batch = batches[batchIndex];
+                const Material* material = renderCommands[batch.first].material;
+                if (!material->canDrawInDepthPrepass()) continue;
+                material->pipelineState.setupDepthOnly();
+                if (batch.instanced) {
+                    instancedDepthProgram->use();
+                    drawInstancedBatch(renderCommands, batch);
+                    continue;
+                }
+                depthProgram->use();
+                for (size_t index = batch.first; index < batch.first + batch.count; index++)
+                {
+                    const RenderCommand& renderCommand = renderCommands[index];
+                    depthProgram->set(objectToWorldUniform, renderCommand.localToWorld);
+                    renderCommand.mesh->draw();
+                }
+            }
+        }
+
+        // Only the object matrices change between draws, everything else comes from the frame uniform block
+        void setObjectUniforms(const our::RenderCommand& renderCommand)
+        {
+            renderCommand.material->shader->set(objectToWorldUniform, renderCommand.localToWorld);
+            // The normal matrix is cached with the local to world matrix, so there is no need to invert a matrix per draw
+            renderCommand.material->shader->set(objectToWorldInvTransposeUniform, glm::mat4(renderCommand.normalMatrix));
+        }
 
     };
 
@@ -21,6 +21,9 @@ namespace our
 {
     class PlayerControllerSystem {
         Application* app; // The application in which the state runs
+        EntityHandle player; // The handle of the player entity found in a previous frame
+        glm::vec3 previousPosition; // The position of the player at the end of the previous update (the start of the collision sweep)
+        bool hasPreviousPosition = false;
         int score = 0;
     
     private:
@@ -49,13 +52,19 @@ namespace our
             if(!(playerEntity && playerController)) return false;
 
             Entity* playerOwnerEntity = playerEntity->getOwner();
-            glm::vec3& playerPosition = playerOwnerEntity->localTransform.position;
+            glm::vec3& playerPosition = playerOwnerEntity->editLocalTransform().position;
+
+            // the player is swept from its previous position, so a long frame can't make it pass through an obstacle
+            glm::vec3 sweepStart = hasPreviousPosition ? previousPosition : playerPosition;
+            CollisionHit hit;
+            bool collided = obstacleCollisionSystem->sweepSphere(sweepStart, playerPosition, playerEntity->radius, hit);
 
             // the game ends when the player wins (reaches finish line) or loses (collides)
-            if (isEndGame(obstacleCollisionSystem, playerEntity->radius, playerPosition))
+            if (collided || playerPosition.z <= FINISH_LINE)
             {
-                if (obstacleCollisionSystem->isCollision(playerEntity->radius, playerPosition)) {
+                if (collided) {
                     win = false;
+                    playerPosition = glm::mix(sweepStart, playerPosition, hit.time); // we stop the ball where it touched the obstacle
                 }
                 stopMoving(); // we stop moving the ball right or left even if the user presses D or A on keyboard
                 movementSystem->endGame(); // we tell the movement system that the game has ended to stop linear movement (of camera & ball) and angluar rotation (of ball)
@@ -68,13 +77,15 @@ namespace our
                 glm::vec3 right = getRightDirection(playerOwnerEntity);
                 updatePosition(playerController, playerPosition, right, deltaTime);
             }           
+            previousPosition = playerPosition;
+            hasPreviousPosition = true;
 
             return stopGame;
         }
 
         glm::vec3 getRightDirection(our::Entity*& playerOwnerEntity)
         {
-            glm::mat4 matrix = playerOwnerEntity->localTransform.toMat4(); // player model matrix relative to parent
+            glm::mat4 matrix = playerOwnerEntity->getLocalTransform().toMat4(); // player model matrix relative to parent
             return glm::vec3(matrix * glm::vec4(1, 0, 0, 0)); // compute right relative to parent
         }
 
@@ -110,18 +121,23 @@ namespace our
         }
 
         void findPlayerAndController(World* world, MeshRendererComponent* &playerToSet, FreePlayerControllerComponent* &controllerToSet) {
-            for (auto entity : world->getEntities()) {
+            // we first check if the player found in a previous frame still exists (the handle is null in the first frame)
+            if (Entity* entity = world->get(player); entity) {
                 playerToSet = entity->getComponent<MeshRendererComponent>();
-                if (playerToSet) {
-                    playerToSet = playerToSet->isPlayer() ? playerToSet : nullptr;
-                }
                 controllerToSet = entity->getComponent<FreePlayerControllerComponent>();
-                if (playerToSet && controllerToSet) break; // we have to find both to break
+                if (playerToSet && controllerToSet && playerToSet->isPlayer()) return;
             }
-        }
-
-        bool isEndGame(our::ObstacleCollisionSystem* &obstacleCollisionSystem, float playerRadius, glm::vec3 playerPosition) {
-            return obstacleCollisionSystem->isCollision(playerRadius, playerPosition) || playerPosition.z <= FINISH_LINE;
+            playerToSet = nullptr;
+            controllerToSet = nullptr;
+            // only the entities holding both components are visited
+            world->forEach<MeshRendererComponent, FreePlayerControllerComponent>(
+                [&](Entity* entity, MeshRendererComponent* meshRenderer, FreePlayerControllerComponent* controller) {
+                    if (!playerToSet && meshRenderer->isPlayer()) {
+                        playerToSet = meshRenderer;
+                        controllerToSet = controller;
+                        player = entity->getHandle();
+                    }
+                });
         }
 
         bool isWin() {
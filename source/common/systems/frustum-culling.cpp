@@ -0,0 +1,81 @@
+#include "frustum-culling.hpp"
+
+#ifdef FRUSTUM_CULLING_SSE
+#include <xmmintrin.h>
+#endif
+
+namespace our::frustum_culling {
+
+    Frustum extractFrustum(const glm::mat4& viewProjection) {
+        // Each plane is the sum or the difference of the last row of the matrix and one of the other rows (Gribb & Hartmann)
+        glm::mat4 rows = glm::transpose(viewProjection);
+        Frustum frustum;
+        frustum.planes[0] = rows[3] + rows[0];
+        frustum.planes[1] = rows[3] - rows[0];
+        frustum.planes[2] = rows[3] + rows[1];
+        frustum.planes[3] = rows[3] - rows[1];
+        frustum.planes[4] = rows[3] + rows[2];
+        frustum.planes[5] = rows[3] - rows[2];
+        for(glm::vec4& plane : frustum.planes) plane /= glm::length(glm::vec3(plane));
+        return frustum;
+    }
+
+    // Tests a single sphere against all the planes
+    // The distance is summed in the same order as the SSE version, so both versions give the same result for every sphere
+    static std::uint8_t testSphere(const Frustum& frustum, const glm::vec4& sphere) {
+        for(const glm::vec4& plane : frustum.planes) {
+            float distance = (plane.x * sphere.x + plane.y * sphere.y) + (plane.z * sphere.z + plane.w);
+            if(!(distance >= -sphere.w)) return 0;
+        }
+        return 1;
+    }
+
+    void testSpheresScalar(const Frustum& frustum, size_t count, const glm::vec4* spheres, std::uint8_t* visible) {
+        for(size_t index = 0; index < count; index++) visible[index] = testSphere(frustum, spheres[index]);
+    }
+
+#ifdef FRUSTUM_CULLING_SSE
+
+    void testSpheres(const Frustum& frustum, size_t count, const glm::vec4* spheres, std::uint8_t* visible) {
+        // Broadcast the components of each plane once
+        __m128 planeX[6], planeY[6], planeZ[6], planeW[6];
+        for(int plane = 0; plane < 6; plane++) {
+            planeX[plane] = _mm_set1_ps(frustum.planes[plane].x);
+            planeY[plane] = _mm_set1_ps(frustum.planes[plane].y);
+            planeZ[plane] = _mm_set1_ps(frustum.planes[plane].z);
+            planeW[plane] = _mm_set1_ps(frustum.planes[plane].w);
+        }
+        const __m128 zero = _mm_setzero_ps();
+        size_t index = 0;
+        for(; index + 4 <= count; index += 4) {
+            // Transpose the 4 spheres so each register holds one component of the 4 spheres
+            __m128 x = _mm_loadu_ps(&spheres[index].x);
+            __m128 y = _mm_loadu_ps(&spheres[index + 1].x);
+            __m128 z = _mm_loadu_ps(&spheres[index + 2].x);
+            __m128 r = _mm_loadu_ps(&spheres[index + 3].x);
+            _MM_TRANSPOSE4_PS(x, y, z, r);
+            __m128 negativeRadius = _mm_sub_ps(zero, r);
+            __m128 inside = _mm_cmpeq_ps(zero, zero); // All bits set
+            for(int plane = 0; plane < 6; plane++) {
+                __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planeX[plane], x), _mm_mul_ps(planeY[plane], y)),
+                                             _mm_add_ps(_mm_mul_ps(planeZ[plane], z), planeW[plane]));
+                inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negativeRadius));
+            }
+            int mask = _mm_movemask_ps(inside);
+            visible[index] = mask & 1;
+            visible[index + 1] = (mask >> 1) & 1;
+            visible[index + 2] = (mask >> 2) & 1;
+            visible[index + 3] = (mask >> 3) & 1;
+        }
+        for(; index < count; index++) visible[index] = testSphere(frustum, spheres[index]);
+    }
+
+#else
+
+    void testSpheres(const Frustum& frustum, size_t count, const glm::vec4* spheres, std::uint8_t* visible) {
+        testSpheresScalar(frustum, count, spheres, visible);
+    }
+
+#endif
+
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+
+// The culling uses SSE when the target supports it (always the case on x86-64), otherwise it falls back to scalar code
+#if !defined(FRUSTUM_CULLING_SCALAR) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+    #define FRUSTUM_CULLING_SSE
+#endif
+
+// These functions test bounding volumes against the view frustum of a camera
+// The SSE version tests 4 spheres at a time (one per SIMD lane) against each plane.
+namespace our::frustum_culling {
+
+    // The 6 planes of a view frustum (left, right, bottom, top, near, far) in world space
+    // Each plane is (normal, distance) with a unit normal pointing inside, so a point p is inside if "dot(normal, p) + distance >= 0"
+    struct Frustum {
+        glm::vec4 planes[6];
+    };
+
+    // Extracts the planes of the frustum from a view projection matrix (works for perspective and orthographic projections)
+    Frustum extractFrustum(const glm::mat4& viewProjection);
+
+    // Tests "count" spheres given as (center, radius) and sets "visible[i]" to 1 if the sphere i touches the frustum, 0 otherwise
+    // The test is conservative: a sphere near a corner of the frustum may be reported as visible while it is outside
+    void testSpheres(const Frustum& frustum, size_t count, const glm::vec4* spheres, std::uint8_t* visible);
+
+    // The same as "testSpheres" but one sphere at a time without SIMD (it is always compiled, so the SSE version can be checked against it)
+    void testSpheresScalar(const Frustum& frustum, size_t count, const glm::vec4* spheres, std::uint8_t* visible);
+
+    // Returns the world space bounding sphere (center, radius) of a local space sphere transformed by the given affine matrix
+    // The radius is scaled by the largest scale of the matrix, so the sphere stays conservative for non uniform scales
+    inline glm::vec4 transformSphere(const glm::mat4& matrix, const glm::vec3& center, float radius) {
+        float scale = glm::max(glm::dot(glm::vec3(matrix[0]), glm::vec3(matrix[0])),
+                      glm::max(glm::dot(glm::vec3(matrix[1]), glm::vec3(matrix[1])), glm::dot(glm::vec3(matrix[2]), glm::vec3(matrix[2]))));
+        return glm::vec4(glm::vec3(matrix * glm::vec4(center, 1.0f)), radius * glm::sqrt(scale));
+    }
+
+}
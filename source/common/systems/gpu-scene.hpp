@@ -0,0 +1,244 @@
+#pragma once
+
+#include "../ecs/world.hpp"
+#include "../components/mesh-renderer.hpp"
+#include "../mesh/mesh-pool.hpp"
+#include "../shader/shader.hpp"
+#include "../shader/shared-bindings.hpp"
+#include "frustum-culling.hpp"
+#include "mesh-lod.hpp"
+
+#include <glad/gl.h>
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <vector>
+
+// The compute shader that culls the objects and writes their draw commands
+#define GPU_CULLING_SHADER_PATH "assets/shaders/gpu-culling.comp"
+// The number of objects processed by each work group (it must match local_size_x in the compute shader)
+#define GPU_CULLING_GROUP_SIZE 64
+
+namespace our
+{
+
+    // An object as it is laid out in the object buffer (std430). The compute shader reads its bounds and draw range
+    // while the instanced vertex shaders read its matrices as instance attributes (selected by the base instance of the draw)
+    struct GPUObject {
+        glm::mat4 objectToWorld;
+        glm::vec4 normalMatrix[3]; // The columns of the inverse transpose of objectToWorld (the 4th component is unused)
+        glm::vec4 boundingSphere; // The local space (center, radius) of the mesh (in the space of its quantized positions if it has them)
+        GLuint elementCount, firstElement;
+        GLint baseVertex;
+        GLuint padding;
+    };
+    static_assert(sizeof(GPUObject) == 144, "GPUObject must match the std430 layout of the Object struct in the culling shader");
+
+    // The command read by glMultiDrawElementsIndirect (its layout is fixed by OpenGL)
+    struct DrawElementsIndirectCommand {
+        GLuint count, instanceCount, firstIndex;
+        GLint baseVertex;
+        GLuint baseInstance;
+    };
+
+    // This class draws the opaque mesh renderers without issuing a draw call per object (OpenGL 4.3).
+    // The objects are kept in a storage buffer where only the objects that changed are uploaded each frame.
+    // A compute shader tests every object against the view frustum and writes its indirect draw command,
+    // then all the objects sharing a material are drawn by a single glMultiDrawElementsIndirect.
+    // All the meshes are copied to a mesh pool since a multi-draw call reads all its draws from a single vertex array.
+    // There is a pool per vertex format, so the objects are grouped by material and by the vertex format of their mesh.
+    class GPUScene {
+        // The objects drawn with a material whose meshes have the same vertex format (they are consecutive in the object buffer)
+        struct Group {
+            Material* material;
+            VertexFormat format;
+            std::vector<std::pair<const Entity*, const Mesh*>> objects; // Filled every frame
+            size_t firstObject;
+        };
+        // What an object of the buffer was built from, to find which objects must be uploaded again
+        struct ObjectKey {
+            const Entity* entity = nullptr;
+            std::uint32_t mesh = 0; // The sort ID of the mesh
+            bool operator==(const ObjectKey& other) const { return entity == other.entity && mesh == other.mesh; }
+        };
+
+        // The mesh pools indexed by the vertex format of their meshes
+        MeshPool meshPools[3] = {MeshPool(VertexFormat::FLOAT), MeshPool(VertexFormat::PACKED), MeshPool(VertexFormat::QUANTIZED)};
+        std::unique_ptr<ShaderProgram> cullingProgram;
+        // The storage buffers of the objects and of their draw commands, and the number of objects they have room for
+        GLuint objectBuffer = 0, commandBuffer = 0;
+        size_t capacity = 0;
+
+        std::vector<Group> groups; // The groups are kept between frames (even when empty) so the object order stays stable
+        std::map<std::pair<const Material*, VertexFormat>, size_t> groupIndices;
+        std::vector<GPUObject> objects; // A copy of the object buffer
+        std::vector<ObjectKey> objectKeys;
+
+        // Makes room for "count" objects in the buffers. Returns true if the buffers were recreated (their content is lost)
+        bool reserve(size_t count) {
+            if(count <= capacity) return false;
+            capacity = std::max(count, capacity * 2);
+            if(objectBuffer) glDeleteBuffers(1, &objectBuffer);
+            if(commandBuffer) glDeleteBuffers(1, &commandBuffer);
+            glGenBuffers(1, &objectBuffer);
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, objectBuffer);
+            glBufferData(GL_SHADER_STORAGE_BUFFER, capacity * sizeof(GPUObject), nullptr, GL_DYNAMIC_DRAW);
+            glGenBuffers(1, &commandBuffer);
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, commandBuffer);
+            glBufferData(GL_SHADER_STORAGE_BUFFER, capacity * sizeof(DrawElementsIndirectCommand), nullptr, GL_DYNAMIC_DRAW);
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+            // The instanced shaders read the matrices of the object selected by the base instance of each draw
+            glBindBuffer(GL_ARRAY_BUFFER, objectBuffer);
+            for (const MeshPool& meshPool : meshPools) {
+                meshPool.bind();
+                for (GLuint column = 0; column < 4; column++) {
+                    size_t offset = offsetof(GPUObject, objectToWorld) + column * sizeof(glm::vec4);
+                    glEnableVertexAttribArray(ATTRIB_LOC_INSTANCE_OBJECT_TO_WORLD + column);
+                    glVertexAttribDivisor(ATTRIB_LOC_INSTANCE_OBJECT_TO_WORLD + column, 1);
+                    glVertexAttribPointer(ATTRIB_LOC_INSTANCE_OBJECT_TO_WORLD + column, 4, GL_FLOAT, GL_FALSE, sizeof(GPUObject), (void *)offset);
+                }
+                for (GLuint column = 0; column < 3; column++) {
+                    size_t offset = offsetof(GPUObject, normalMatrix) + column * sizeof(glm::vec4);
+                    glEnableVertexAttribArray(ATTRIB_LOC_INSTANCE_NORMAL_MATRIX + column);
+                    glVertexAttribDivisor(ATTRIB_LOC_INSTANCE_NORMAL_MATRIX + column, 1);
+                    glVertexAttribPointer(ATTRIB_LOC_INSTANCE_NORMAL_MATRIX + column, 3, GL_FLOAT, GL_FALSE, sizeof(GPUObject), (void *)offset);
+                }
+            }
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+            return true;
+        }
+
+        // Fills the object at the given index from its entity and mesh
+        void writeObject(size_t index, const Entity* entity, const Mesh* mesh) {
+            const MeshPoolEntry& entry = meshPools[int(mesh->getVertexFormat())].add(mesh);
+            GPUObject& object = objects[index];
+            object.objectToWorld = entity->getLocalToWorldMatrix();
+            // The matrix decodes the quantized positions, so the culling shader gets the sphere in their space
+            if(mesh->hasQuantizedPositions()) object.objectToWorld *= mesh->getPositionDecoding();
+            const glm::mat3& normalMatrix = entity->getNormalMatrix();
+            for(int column = 0; column < 3; column++) object.normalMatrix[column] = glm::vec4(normalMatrix[column], 0.0f);
+            object.boundingSphere = mesh->getEncodedBoundingSphere();
+            object.elementCount = entry.elementCount;
+            object.firstElement = entry.firstElement;
+            object.baseVertex = entry.baseVertex;
+            object.padding = 0;
+        }
+
+    public:
+        // Returns true if the context supports compute shaders, storage buffers and multi-draw indirect (OpenGL 4.3)
+        static bool isSupported() { return GLAD_GL_VERSION_4_3; }
+
+        // Returns true if the mesh renderer can be drawn by the GPU scene: it must be opaque, in the default layer
+        // (the layers are drawn in order by the render queues) and its material must have an instanced shader
+        static bool accepts(const MeshRendererComponent* meshRenderer) {
+            const Material* material = meshRenderer->material;
+            return !material->transparent && material->instancedShader && meshRenderer->layer == 0;
+        }
+
+        // Collects the accepted mesh renderers of the world and uploads the objects that changed since the last frame
+        // (a new object, another mesh or a matrix recomputed by the last transform update). Returns the number of objects.
+        // The mesh of each object is the LOD picked by "lod", so an object is uploaded again when it switches to another LOD
+        size_t update(World* world, const LODSelector& lod) {
+            for(Group& group : groups) group.objects.clear();
+            world->forEach<MeshRendererComponent>([&](Entity* entity, MeshRendererComponent* meshRenderer){
+                if(!accepts(meshRenderer)) return;
+                const Mesh* mesh = meshRenderer->mesh;
+                VertexFormat format = mesh->getVertexFormat();
+                auto [it, inserted] = groupIndices.try_emplace({meshRenderer->material, format}, groups.size());
+                if(inserted) groups.push_back({meshRenderer->material, format, {}, 0});
+                glm::vec4 sphere = frustum_culling::transformSphere(entity->getLocalToWorldMatrix(), mesh->getBoundingSphereCenter(), mesh->getBoundingSphereRadius());
+                groups[it->second].objects.emplace_back(entity, lod.select(meshRenderer, sphere));
+            });
+
+            size_t count = 0;
+            for(Group& group : groups) {
+                group.firstObject = count;
+                count += group.objects.size();
+            }
+            bool uploadAll = reserve(count);
+            objects.resize(count);
+            objectKeys.resize(count);
+
+            // Only the range between the first and the last changed object is uploaded
+            size_t dirtyBegin = count, dirtyEnd = 0;
+            for(const Group& group : groups) {
+                for(size_t index = 0; index < group.objects.size(); index++) {
+                    auto [entity, mesh] = group.objects[index];
+                    size_t objectIndex = group.firstObject + index;
+                    ObjectKey key = {entity, mesh->getSortID()};
+                    if(!uploadAll && key == objectKeys[objectIndex] && !entity->hasLocalToWorldChanged()) continue;
+                    objectKeys[objectIndex] = key;
+                    writeObject(objectIndex, entity, mesh);
+                    dirtyBegin = std::min(dirtyBegin, objectIndex);
+                    dirtyEnd = objectIndex + 1;
+                }
+            }
+            if(dirtyBegin < dirtyEnd) {
+                glBindBuffer(GL_SHADER_STORAGE_BUFFER, objectBuffer);
+                glBufferSubData(GL_SHADER_STORAGE_BUFFER, dirtyBegin * sizeof(GPUObject), (dirtyEnd - dirtyBegin) * sizeof(GPUObject), objects.data() + dirtyBegin);
+                glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+            }
+            return count;
+        }
+
+        // Runs the culling compute shader, which writes the draw commands of all the objects (the culled ones get no instance)
+        void cull(const frustum_culling::Frustum& frustum) {
+            if(objects.empty()) return;
+            if(!cullingProgram) {
+                cullingProgram = std::make_unique<ShaderProgram>();
+                cullingProgram->attach(GPU_CULLING_SHADER_PATH, GL_COMPUTE_SHADER);
+                cullingProgram->link();
+            }
+            cullingProgram->use();
+            glUniform4fv(cullingProgram->getUniformLocation("frustum_planes[0]"), 6, &frustum.planes[0].x);
+            cullingProgram->set("object_count", GLuint(objects.size()));
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, GPU_CULLING_OBJECT_BINDING, objectBuffer);
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, GPU_CULLING_COMMAND_BINDING, commandBuffer);
+            glDispatchCompute(GLuint((objects.size() + GPU_CULLING_GROUP_SIZE - 1) / GPU_CULLING_GROUP_SIZE), 1, 1);
+            // The draws read the commands as indirect arguments
+            glMemoryBarrier(GL_COMMAND_BARRIER_BIT);
+        }
+
+        // Draws all the objects with one multi-draw call per material
+        // If "depthPrepassed" is true, the depth of the materials that can be drawn by a depth pre-pass is already in the
+        // depth buffer (see "drawDepth"), so they are drawn with an equal depth test and no depth writes
+        void draw(bool depthPrepassed) {
+            if(objects.empty()) return;
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+            for(const Group& group : groups) {
+                if(group.objects.empty()) continue;
+                group.material->setup(true);
+                if(depthPrepassed && group.material->canDrawInDepthPrepass()) {
+                    GLStateCache::getInstance().setDepthFunction(GL_EQUAL);
+                    GLStateCache::getInstance().setDepthMask(false);
+                }
+                meshPools[int(group.format)].bind();
+                size_t offset = group.firstObject * sizeof(DrawElementsIndirectCommand);
+                glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)offset, GLsizei(group.objects.size()), 0);
+            }
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        }
+
+        // Draws the depth of the objects whose material can be drawn by a depth pre-pass using the given instanced program
+        void drawDepth(ShaderProgram& program) {
+            if(objects.empty()) return;
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+            for(const Group& group : groups) {
+                if(group.objects.empty() || !group.material->canDrawInDepthPrepass()) continue;
+                group.material->pipelineState.setupDepthOnly();
+                program.use();
+                meshPools[int(group.format)].bind();
+                size_t offset = group.firstObject * sizeof(DrawElementsIndirectCommand);
+                glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)offset, GLsizei(group.objects.size()), 0);
+            }
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        }
+
+        ~GPUScene() {
+            if(objectBuffer) glDeleteBuffers(1, &objectBuffer);
+            if(commandBuffer) glDeleteBuffers(1, &commandBuffer);
+        }
+    };
+
+}
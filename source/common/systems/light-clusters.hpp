@@ -0,0 +1,217 @@
+#pragma once
+
+#include "../jobs/job-system.hpp"
+
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+// The number of clusters along each axis of the view frustum
+// x and y split the viewport into tiles while z splits the depth range exponentially (so near clusters are thin and far ones are thick)
+#define LIGHT_CLUSTER_COUNT_X 16
+#define LIGHT_CLUSTER_COUNT_Y 9
+#define LIGHT_CLUSTER_COUNT_Z 24
+// The maximum number of lights in a single cluster (the extra lights are ignored by the cluster, see "LightClusterStatistics")
+#define LIGHT_CLUSTER_MAX_LIGHTS 256
+
+namespace our
+{
+
+    // The sphere (in world space) that bounds the volume lit by a light
+    struct LightBounds {
+        glm::vec3 center;
+        float radius; // It can be infinite for a light with no attenuation
+    };
+
+    // The counters of the last build of a light cluster grid
+    // If "droppedLights" is not zero, some lights are missing from the clusters they touch (so they don't light all their volume)
+    struct LightClusterStatistics {
+        size_t lights = 0; // The number of lights given to the build
+        size_t maxLightsPerCluster = 0; // The largest number of lights touching a single cluster (including the dropped ones)
+        size_t overflowingClusters = 0; // The number of clusters touched by more than LIGHT_CLUSTER_MAX_LIGHTS lights
+        size_t droppedLights = 0; // The number of lights left out of the clusters they touch (summed over the overflowing clusters)
+    };
+
+    // This class bins the lights into a grid of clusters (froxels) that splits the view frustum.
+    // Each cluster gets the list of the lights whose bounding sphere touches it, so a fragment only evaluates the lights of its own
+    // cluster and the cost of shading doesn't grow with the number of lights in the scene.
+    // The lists are packed into two flat arrays: "clusters" holds the (offset, count) of each cluster in "lightIndices".
+    class LightClusterGrid {
+        // The view space bounding box of a cluster
+        struct ClusterBounds {
+            glm::vec3 min, max;
+        };
+
+        std::vector<ClusterBounds> clusterBounds; // The bounds of all the clusters (only recomputed when the projection changes)
+        glm::mat4 boundsProjection = glm::mat4(0.0f); // The projection for which "clusterBounds" was computed
+        float boundsNear = 0, boundsFar = 0;
+
+        std::vector<std::vector<std::uint32_t>> clusterLights; // The lights of each cluster (kept between frames to reuse their memory)
+        std::vector<glm::uvec2> clusters; // The (offset, count) of the lights of each cluster in "lightIndices"
+        std::vector<std::uint32_t> lightIndices; // The light lists of all the clusters one after the other
+        float depthScale = 0, depthBias = 0; // The slice of a view depth is "floor(log(depth) * depthScale + depthBias)"
+
+        // The view space sphere of a light and the range of slices it touches
+        struct ViewLight {
+            glm::vec3 center;
+            float radius;
+            int firstSlice, lastSlice;
+        };
+        std::vector<ViewLight> viewLights;
+
+        std::vector<LightClusterStatistics> sliceStatistics; // The overflow counters of each slice (each slice is binned by one job)
+        LightClusterStatistics statistics; // The counters of the last build
+        bool overflowReported = false; // The overflow is only reported once, since it would otherwise be reported every frame
+
+        // Returns the index of the cluster at the given coordinates
+        static size_t getClusterIndex(int x, int y, int z) {
+            return (size_t(z) * LIGHT_CLUSTER_COUNT_Y + y) * LIGHT_CLUSTER_COUNT_X + x;
+        }
+
+        // Returns the slice containing the given view depth (clamped to the grid)
+        int getSlice(float depth) const {
+            if(!(depth > boundsNear)) return 0;
+            float slice = std::floor(std::log(depth) * depthScale + depthBias);
+            return (int)std::min(std::max(slice, 0.0f), float(LIGHT_CLUSTER_COUNT_Z - 1));
+        }
+
+        // Computes the view space bounding box of each cluster from the corners of its tile on the near and far planes
+        // This works for both perspective and orthographic projections
+        void computeClusterBounds(const glm::mat4& projection, float near, float far) {
+            boundsProjection = projection;
+            boundsNear = near;
+            boundsFar = far;
+            float depthRatio = std::log(far / near);
+            depthScale = LIGHT_CLUSTER_COUNT_Z / depthRatio;
+            depthBias = -LIGHT_CLUSTER_COUNT_Z * std::log(near) / depthRatio;
+
+            glm::mat4 inverseProjection = glm::inverse(projection);
+            auto unproject = [&](float x, float y, float z) {
+                glm::vec4 point = inverseProjection * glm::vec4(x, y, z, 1.0f);
+                return glm::vec3(point) / point.w;
+            };
+            clusterBounds.resize(size_t(LIGHT_CLUSTER_COUNT_X) * LIGHT_CLUSTER_COUNT_Y * LIGHT_CLUSTER_COUNT_Z);
+            for(int y = 0; y < LIGHT_CLUSTER_COUNT_Y; y++){
+                for(int x = 0; x < LIGHT_CLUSTER_COUNT_X; x++){
+                    // The 4 edges of the tile going from the near plane to the far plane
+                    glm::vec3 nearCorners[4], farCorners[4];
+                    for(int corner = 0; corner < 4; corner++){
+                        float u = -1.0f + 2.0f * float(x + (corner & 1)) / LIGHT_CLUSTER_COUNT_X;
+                        float v = -1.0f + 2.0f * float(y + (corner >> 1)) / LIGHT_CLUSTER_COUNT_Y;
+                        nearCorners[corner] = unproject(u, v, -1.0f);
+                        farCorners[corner] = unproject(u, v, 1.0f);
+                    }
+                    for(int z = 0; z < LIGHT_CLUSTER_COUNT_Z; z++){
+                        ClusterBounds& bounds = clusterBounds[getClusterIndex(x, y, z)];
+                        bounds.min = glm::vec3(INFINITY);
+                        bounds.max = glm::vec3(-INFINITY);
+                        for(int side = 0; side < 2; side++){
+                            float depth = near * std::pow(far / near, float(z + side) / LIGHT_CLUSTER_COUNT_Z);
+                            for(int corner = 0; corner < 4; corner++){
+                                const glm::vec3& from = nearCorners[corner];
+                                const glm::vec3& to = farCorners[corner];
+                                glm::vec3 point = from + (to - from) * ((-depth - from.z) / (to.z - from.z));
+                                bounds.min = glm::min(bounds.min, point);
+                                bounds.max = glm::max(bounds.max, point);
+                            }
+                        }
+                    }
+                }
+            }
+        }
+
+        // Adds the lights touching the clusters of the given slice to their lists
+        void binSlice(int z) {
+            LightClusterStatistics& sliceStats = sliceStatistics[z];
+            sliceStats = LightClusterStatistics();
+            for(int y = 0; y < LIGHT_CLUSTER_COUNT_Y; y++){
+                for(int x = 0; x < LIGHT_CLUSTER_COUNT_X; x++){
+                    size_t cluster = getClusterIndex(x, y, z);
+                    const ClusterBounds& bounds = clusterBounds[cluster];
+                    auto& lights = clusterLights[cluster];
+                    lights.clear();
+                    size_t touching = 0; // The lights that touch the cluster (even if there is no room left for them)
+                    for(size_t index = 0; index < viewLights.size(); index++){
+                        const ViewLight& light = viewLights[index];
+                        if(z < light.firstSlice || z > light.lastSlice) continue;
+                        // The sphere touches the box if the closest point of the box is inside the sphere
+                        glm::vec3 offset = glm::clamp(light.center, bounds.min, bounds.max) - light.center;
+                        if(glm::dot(offset, offset) > light.radius * light.radius) continue;
+                        if(++touching <= LIGHT_CLUSTER_MAX_LIGHTS) lights.push_back(std::uint32_t(index));
+                    }
+                    sliceStats.maxLightsPerCluster = std::max(sliceStats.maxLightsPerCluster, touching);
+                    if(touching > LIGHT_CLUSTER_MAX_LIGHTS){
+                        sliceStats.overflowingClusters++;
+                        sliceStats.droppedLights += touching - LIGHT_CLUSTER_MAX_LIGHTS;
+                    }
+                }
+            }
+        }
+
+    public:
+        static constexpr size_t CLUSTER_COUNT = size_t(LIGHT_CLUSTER_COUNT_X) * LIGHT_CLUSTER_COUNT_Y * LIGHT_CLUSTER_COUNT_Z;
+
+        // Rebuilds the light lists of all the clusters for the given camera
+        // "near" and "far" are the distances of the camera planes which must match the given projection
+        // The slices are binned in parallel on the job system
+        void build(const std::vector<LightBounds>& lights, const glm::mat4& view, const glm::mat4& projection, float near, float far) {
+            if(projection != boundsProjection || near != boundsNear || far != boundsFar) computeClusterBounds(projection, near, far);
+
+            // Move the lights to the view space and find the slices they touch (the lights out of the depth range are dropped)
+            viewLights.clear();
+            for(const LightBounds& light : lights){
+                glm::vec3 center = glm::vec3(view * glm::vec4(light.center, 1.0f));
+                float depth = -center.z;
+                if(depth + light.radius < near || depth - light.radius > far) {
+                    viewLights.push_back({center, -1.0f, 1, 0}); // Keep the index of the light but never touch a slice
+                    continue;
+                }
+                viewLights.push_back({center, light.radius, getSlice(depth - light.radius), getSlice(depth + light.radius)});
+            }
+
+            clusterLights.resize(CLUSTER_COUNT);
+            sliceStatistics.resize(LIGHT_CLUSTER_COUNT_Z);
+            JobSystem::getInstance().parallelFor(LIGHT_CLUSTER_COUNT_Z, 1, [this](size_t begin, size_t end){
+                for(size_t z = begin; z < end; z++) binSlice(int(z));
+            });
+
+            // Pack the lists in the cluster order
+            clusters.resize(CLUSTER_COUNT);
+            lightIndices.clear();
+            for(size_t cluster = 0; cluster < CLUSTER_COUNT; cluster++){
+                const auto& list = clusterLights[cluster];
+                clusters[cluster] = glm::uvec2(std::uint32_t(lightIndices.size()), std::uint32_t(list.size()));
+                lightIndices.insert(lightIndices.end(), list.begin(), list.end());
+            }
+
+            statistics = LightClusterStatistics();
+            statistics.lights = lights.size();
+            for(const LightClusterStatistics& sliceStats : sliceStatistics){
+                statistics.maxLightsPerCluster = std::max(statistics.maxLightsPerCluster, sliceStats.maxLightsPerCluster);
+                statistics.overflowingClusters += sliceStats.overflowingClusters;
+                statistics.droppedLights += sliceStats.droppedLights;
+            }
+            if(statistics.overflowingClusters > 0 && !overflowReported){
+                overflowReported = true;
+                std::cerr << "WARN: " << statistics.overflowingClusters << " light clusters are touched by more than " << LIGHT_CLUSTER_MAX_LIGHTS
+                    << " lights (up to " << statistics.maxLightsPerCluster << "), " << statistics.droppedLights
+                    << " lights were left out of these clusters (this is only reported once)" << std::endl;
+            }
+        }
+
+        // Returns the counters of the last build (including the lights that didn't fit in their clusters)
+        const LightClusterStatistics& getStatistics() const { return statistics; }
+
+        // Returns the (offset, count) of the light list of each cluster
+        const std::vector<glm::uvec2>& getClusters() const { return clusters; }
+        // Returns the light lists of all the clusters (the indices refer to the lights given to "build")
+        const std::vector<std::uint32_t>& getLightIndices() const { return lightIndices; }
+        // The shader finds the slice of a fragment using "floor(log(depth) * depthScale + depthBias)"
+        float getDepthScale() const { return depthScale; }
+        float getDepthBias() const { return depthBias; }
+    };
+
+}
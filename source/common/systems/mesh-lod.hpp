@@ -0,0 +1,65 @@
+#pragma once
+
+#include "../components/mesh-renderer.hpp"
+
+#include <glm/glm.hpp>
+#include <algorithm>
+
+// The projected size (see LODSelector::getProjectedSize) below which a mesh is drawn with its LOD 1
+// Each next LOD has half the triangles of the previous one, so it is used below half the size of the previous one
+#define MESH_LOD_SCREEN_SIZE 0.25f
+// A mesh only switches to another LOD once its projected size is this fraction past the threshold between the two LODs,
+// so a mesh staying around a threshold doesn't switch back and forth every frame
+#define MESH_LOD_HYSTERESIS 0.1f
+
+namespace our {
+
+    // This picks the level of detail of the mesh renderers from the size of their bounding sphere on the screen
+    struct LODSelector {
+        glm::vec3 cameraPosition;
+        float projectionScale = 1.0f; // The element [1][1] of the projection matrix (the cotangent of half the vertical field of view)
+        bool perspective = true;
+        float thresholdScale = 1.0f; // Multiplies all the thresholds (0 always draws the full meshes)
+
+        LODSelector() = default;
+        LODSelector(const glm::vec3& cameraPosition, const glm::mat4& projection, float thresholdScale)
+            : cameraPosition(cameraPosition), projectionScale(projection[1][1]), perspective(projection[3][3] == 0.0f), thresholdScale(thresholdScale) {}
+
+        // Returns the diameter of the given world space sphere (center, radius) on the screen divided by the viewport height
+        float getProjectedSize(const glm::vec4& sphere) const {
+            float size = sphere.w * projectionScale;
+            if(perspective) size /= std::max(glm::distance(glm::vec3(sphere), cameraPosition), sphere.w);
+            return size;
+        }
+
+        // Returns the projected size below which the given LOD (1 or more) is used
+        float getThreshold(size_t level) const {
+            return thresholdScale * MESH_LOD_SCREEN_SIZE / float(1u << (level - 1));
+        }
+
+        // Returns the LOD (out of "lodCount" levels) to use for the given projected size if "currentLevel" was used in the last frame
+        // The level only changes once the size is past the threshold between the two levels by the hysteresis
+        size_t selectLevel(size_t currentLevel, size_t lodCount, float size) const {
+            if(lodCount <= 1 || thresholdScale <= 0.0f) return 0;
+            size_t level = std::min(currentLevel, lodCount - 1);
+            while(level > 0 && size > getThreshold(level) * (1.0f + MESH_LOD_HYSTERESIS)) level--;
+            while(level + 1 < lodCount && size < getThreshold(level + 1) * (1.0f - MESH_LOD_HYSTERESIS)) level++;
+            return level;
+        }
+
+        // Picks the LOD of the mesh renderer whose world space bounding sphere is given and returns the mesh to draw
+        // The chosen level is stored in the component, so the next frame only leaves it past the hysteresis
+        Mesh* select(MeshRendererComponent* meshRenderer, const glm::vec4& sphere) const {
+            Mesh* mesh = meshRenderer->mesh;
+            size_t lodCount = mesh->getLODCount();
+            if(lodCount == 1 || thresholdScale <= 0.0f) {
+                meshRenderer->lodLevel = 0;
+                return mesh;
+            }
+            size_t level = selectLevel(meshRenderer->lodLevel, lodCount, getProjectedSize(sphere));
+            meshRenderer->lodLevel = std::uint8_t(level);
+            return mesh->getLOD(level);
+        }
+    };
+
+}
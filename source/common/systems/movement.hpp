@@ -18,17 +18,15 @@ namespace our
 
         // This should be called every frame to update all entities containing a MovementComponent. 
         void update(World* world, float deltaTime) {
-            // For each entity in the world
-            for(auto entity : world->getEntities()){
-                // Get the movement component if it exists
-                MovementComponent* movement = entity->getComponent<MovementComponent>();
-                // If the movement component exists
-                if(movement && !stopGame){
-                    // Change the position and rotation based on the linear & angular velocity and delta time.
-                    entity->localTransform.position += deltaTime * movement->linearVelocity;
-                    entity->localTransform.rotation += deltaTime * movement->angularVelocity;
-                }
-            }
+            if(stopGame) return;
+            // For each entity holding a movement component (every entity is independent, so they are processed in parallel chunks)
+            world->forEachParallel<MovementComponent>([deltaTime](Entity* entity, MovementComponent* movement){
+                // Change the position and rotation based on the linear & angular velocity and delta time.
+                Transform& transform = entity->editLocalTransform();
+                transform.position += deltaTime * movement->linearVelocity;
+                // (if the transform stores its rotation as a quaternion, the rotation is applied to the quaternion)
+                transform.rotate(deltaTime * movement->angularVelocity);
+            });
         }
 
         void endGame() {
@@ -1,37 +1,150 @@
 #pragma once
 #include <stdlib.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
 #include <vector>
 #include <glm/glm.hpp>
 
-#define OBSTACLES_COUNT 9
+// The size of a cell of the broadphase grid. It should be around the size of an obstacle
+#define OBSTACLE_GRID_CELL_SIZE 4.0f
+
 namespace our
 {
 
+    // The result of a collision query
+    struct CollisionHit {
+        size_t obstacle; // The index of the obstacle that was hit (as returned by "addObstacle")
+        float time; // The fraction of the sweep at which the spheres first touched (0 at "from", 1 at "to")
+    };
+
+    // This system detects the collisions between the player and the obstacles. In our game design, both of them are spheres.
+    // The obstacles are stored in a uniform grid (a hash map from cell coordinates to the obstacles overlapping the cell),
+    // so a query only tests the obstacles near the player instead of all the obstacles of the track.
+    // The player is tested with a swept sphere from its previous to its current position, so it can't tunnel through
+    // an obstacle in a long frame.
     class ObstacleCollisionSystem {
-        
+        struct Obstacle {
+            glm::vec3 position;
+            float radius;
+        };
 
-    public:
-        std::vector<float> obstacleRadius;
-        std::vector<glm::vec3> obstaclePosition;
+        std::vector<Obstacle> obstacles;
+        std::unordered_map<std::uint64_t, std::vector<size_t>> cells; // The obstacles overlapping each cell of the grid
+        std::vector<std::uint32_t> lastVisit; // The last query that tested each obstacle (so an obstacle in many cells is tested once)
+        std::uint32_t queryCount = 0;
+
+        // Returns the coordinates of the cell containing the given point
+        static glm::ivec3 getCell(const glm::vec3& point) {
+            return glm::ivec3(glm::floor(point / OBSTACLE_GRID_CELL_SIZE));
+        }
 
+        // Packs the cell coordinates into a single key (21 bits per axis)
+        static std::uint64_t getCellKey(const glm::ivec3& cell) {
+            const std::uint64_t mask = (1u << 21) - 1;
+            return (std::uint64_t(cell.x) & mask) | ((std::uint64_t(cell.y) & mask) << 21) | ((std::uint64_t(cell.z) & mask) << 42);
+        }
+
+        // Adds (or removes) the given obstacle to (or from) all the cells overlapped by its bounding box
+        void insertInCells(size_t index) {
+            const Obstacle& obstacle = obstacles[index];
+            glm::ivec3 minCell = getCell(obstacle.position - obstacle.radius), maxCell = getCell(obstacle.position + obstacle.radius);
+            for (int x = minCell.x; x <= maxCell.x; x++)
+                for (int y = minCell.y; y <= maxCell.y; y++)
+                    for (int z = minCell.z; z <= maxCell.z; z++)
+                        cells[getCellKey({x, y, z})].push_back(index);
+        }
+        void removeFromCells(size_t index) {
+            const Obstacle& obstacle = obstacles[index];
+            glm::ivec3 minCell = getCell(obstacle.position - obstacle.radius), maxCell = getCell(obstacle.position + obstacle.radius);
+            for (int x = minCell.x; x <= maxCell.x; x++)
+                for (int y = minCell.y; y <= maxCell.y; y++)
+                    for (int z = minCell.z; z <= maxCell.z; z++) {
+                        auto& cell = cells[getCellKey({x, y, z})];
+                        for (size_t i = 0; i < cell.size(); i++) {
+                            if (cell[i] == index) { cell[i] = cell.back(); cell.pop_back(); break; }
+                        }
+                    }
+        }
+
+        // Returns the first time in [0, 1] at which a sphere moving from "from" to "to" touches the given obstacle (or a negative value if it doesn't)
+        static float sweepTest(const glm::vec3& from, const glm::vec3& to, float radius, const Obstacle& obstacle) {
+            // Solve |from + t * direction - center| = radius + obstacleRadius for the smallest t
+            glm::vec3 direction = to - from;
+            glm::vec3 offset = from - obstacle.position;
+            float radiusSum = radius + obstacle.radius;
+            float c = glm::dot(offset, offset) - radiusSum * radiusSum;
+            if (c <= 0) return 0; // The spheres are already touching at the start of the sweep
+            float a = glm::dot(direction, direction);
+            float b = glm::dot(offset, direction);
+            if (a == 0 || b >= 0) return -1; // Not moving, or moving away from the obstacle
+            float discriminant = b * b - a * c;
+            if (discriminant < 0) return -1; // The path misses the obstacle
+            float time = (-b - std::sqrt(discriminant)) / a;
+            return time <= 1 ? time : -1;
+        }
+
+    public:
         // store obstacle position and dimensions to be able to detect collision with player
-        void addObstacle(float radius, glm::vec3 position) {
-            obstacleRadius.push_back(radius);
-            obstaclePosition.push_back(position);
+        // Returns the index of the obstacle which is used to update it and to identify it in a CollisionHit
+        size_t addObstacle(float radius, glm::vec3 position) {
+            obstacles.push_back({position, radius});
+            lastVisit.push_back(queryCount);
+            insertInCells(obstacles.size() - 1);
+            return obstacles.size() - 1;
         }
 
-        bool isCollision(float playerRadius, glm::vec3 playerPosition) {
-            // loop over all obstacles to detect collision with any of them
-            for (int i = 0; i < OBSTACLES_COUNT; i++) {
-                // we use the sphere collision as in our game design both the player and the obstacles are spheres
-                // sphere collision is detected if the summation of the radii <= distance between both centers
-                float dist = glm::distance(playerPosition, obstaclePosition[i]);
-                if (dist <= playerRadius + obstacleRadius[i]) {
-                    return true; // return true if the player collided with any of the obstacles
-                }
+        // Moves (or resizes) an obstacle that was already added
+        void updateObstacle(size_t index, float radius, glm::vec3 position) {
+            removeFromCells(index);
+            obstacles[index] = {position, radius};
+            insertInCells(index);
+        }
+
+        // Removes all the obstacles
+        void clear() {
+            obstacles.clear();
+            cells.clear();
+            lastVisit.clear();
+        }
+
+        // Returns the number of obstacles
+        size_t getObstacleCount() const { return obstacles.size(); }
+
+        // Sweeps a sphere of the given radius from "from" to "to" and finds the first obstacle it touches
+        // Returns true if an obstacle was hit and fills "hit" with the obstacle and the time of the contact
+        bool sweepSphere(glm::vec3 from, glm::vec3 to, float radius, CollisionHit& hit) {
+            if (++queryCount == 0) { // When the counter wraps around, the visit marks are reset
+                std::fill(lastVisit.begin(), lastVisit.end(), 0);
+                queryCount = 1;
             }
-            return false;
+            bool found = false;
+            // Only the cells overlapped by the bounding box of the sweep are visited
+            glm::ivec3 minCell = getCell(glm::min(from, to) - radius), maxCell = getCell(glm::max(from, to) + radius);
+            for (int x = minCell.x; x <= maxCell.x; x++)
+                for (int y = minCell.y; y <= maxCell.y; y++)
+                    for (int z = minCell.z; z <= maxCell.z; z++) {
+                        auto cell = cells.find(getCellKey({x, y, z}));
+                        if (cell == cells.end()) continue;
+                        for (size_t index : cell->second) {
+                            if (lastVisit[index] == queryCount) continue;
+                            lastVisit[index] = queryCount;
+                            float time = sweepTest(from, to, radius, obstacles[index]);
+                            if (time >= 0 && (!found || time < hit.time)) {
+                                hit = {index, time};
+                                found = true;
+                            }
+                        }
+                    }
+            return found;
+        }
+
+        // Returns true if a sphere of the given radius at the given position touches any obstacle
+        bool isCollision(float playerRadius, glm::vec3 playerPosition) {
+            CollisionHit hit;
+            return sweepSphere(playerPosition, playerPosition, playerRadius, hit);
         }
     };
 
-}
\ No newline at end of file
+}
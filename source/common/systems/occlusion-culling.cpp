@@ -0,0 +1,236 @@
+#include "occlusion-culling.hpp"
+#include "../jobs/job-system.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#ifdef OCCLUSION_CULLING_SSE
+#include <emmintrin.h>
+#endif
+
+namespace our {
+
+    OcclusionCuller::OcclusionCuller() {
+        // The depth pyramid goes down to a single texel
+        glm::ivec2 size(OCCLUSION_BUFFER_WIDTH, OCCLUSION_BUFFER_HEIGHT);
+        while(true) {
+            levelSizes.push_back(size);
+            levels.emplace_back(size_t(size.x) * size.y, 1.0f);
+            if(size.x == 1 && size.y == 1) break;
+            size = glm::max(size / 2, glm::ivec2(1));
+        }
+    }
+
+    void OcclusionCuller::beginFrame(const glm::mat4& viewProjection) {
+        this->viewProjection = viewProjection;
+        occluders.clear();
+        std::fill(levels[0].begin(), levels[0].end(), 1.0f);
+    }
+
+    void OcclusionCuller::addOccluder(const glm::mat4& localToWorld, const glm::vec3* positions, const std::uint32_t* elements, size_t elementCount) {
+        occluders.push_back({viewProjection * localToWorld, positions, elements, elementCount});
+    }
+
+    void OcclusionCuller::setupOccluder(size_t index) {
+        const Occluder& occluder = occluders[index];
+        std::vector<Triangle>& triangles = occluderTriangles[index];
+        std::vector<glm::vec4>& clip = clipPositions[index];
+        triangles.clear();
+
+        // Only the vertices used by the elements are needed, but the meshes rarely have unused vertices
+        std::uint32_t vertexCount = 0;
+        for(size_t element = 0; element < occluder.elementCount; element++) vertexCount = std::max(vertexCount, occluder.elements[element] + 1);
+        clip.resize(vertexCount);
+        for(std::uint32_t vertex = 0; vertex < vertexCount; vertex++) clip[vertex] = occluder.transform * glm::vec4(occluder.positions[vertex], 1.0f);
+
+        const glm::vec2 screenScale(OCCLUSION_BUFFER_WIDTH * 0.5f, OCCLUSION_BUFFER_HEIGHT * 0.5f);
+        // Converts a clip space position to pixel coordinates and a window depth
+        auto toScreen = [&](const glm::vec4& position) {
+            glm::vec3 ndc = glm::vec3(position) / position.w;
+            return glm::vec3((glm::vec2(ndc) + 1.0f) * screenScale, ndc.z * 0.5f + 0.5f);
+        };
+
+        // Sets up a triangle given in pixel coordinates (both windings are accepted since the occluders are not backface culled)
+        auto addTriangle = [&](glm::vec3 v0, glm::vec3 v1, glm::vec3 v2) {
+            float area = (v1.x - v0.x) * (v2.y - v0.y) - (v1.y - v0.y) * (v2.x - v0.x);
+            if(!(std::abs(area) > 0.0f)) return;
+            if(area < 0) { std::swap(v1, v2); area = -area; }
+            Triangle triangle;
+            // The pixels are sampled at their centers, so the rectangle covers the pixels whose center may be inside the triangle
+            triangle.minX = std::max(0, int(std::ceil(std::min({v0.x, v1.x, v2.x}) - 0.5f)));
+            triangle.maxX = std::min(OCCLUSION_BUFFER_WIDTH - 1, int(std::floor(std::max({v0.x, v1.x, v2.x}) - 0.5f)));
+            triangle.minY = std::max(0, int(std::ceil(std::min({v0.y, v1.y, v2.y}) - 0.5f)));
+            triangle.maxY = std::min(OCCLUSION_BUFFER_HEIGHT - 1, int(std::floor(std::max({v0.y, v1.y, v2.y}) - 0.5f)));
+            if(triangle.minX > triangle.maxX || triangle.minY > triangle.maxY) return;
+            const glm::vec3* vertices[3] = {&v0, &v1, &v2};
+            for(int edge = 0; edge < 3; edge++) {
+                const glm::vec3& from = *vertices[edge];
+                const glm::vec3& to = *vertices[(edge + 1) % 3];
+                triangle.edgeA[edge] = from.y - to.y;
+                triangle.edgeB[edge] = to.x - from.x;
+                triangle.edgeC[edge] = from.x * to.y - from.y * to.x;
+            }
+            triangle.depthA = ((v1.z - v0.z) * (v2.y - v0.y) - (v1.y - v0.y) * (v2.z - v0.z)) / area;
+            triangle.depthB = ((v1.x - v0.x) * (v2.z - v0.z) - (v1.z - v0.z) * (v2.x - v0.x)) / area;
+            triangle.depthC = v0.z - triangle.depthA * v0.x - triangle.depthB * v0.y;
+            triangles.push_back(triangle);
+        };
+
+        for(size_t element = 0; element + 2 < occluder.elementCount; element += 3) {
+            glm::vec4 corners[3] = {clip[occluder.elements[element]], clip[occluder.elements[element + 1]], clip[occluder.elements[element + 2]]};
+            // Skip the triangles that are completely outside one of the side planes
+            bool outside = false;
+            for(int axis = 0; axis < 2 && !outside; axis++) {
+                outside = (corners[0][axis] > corners[0].w && corners[1][axis] > corners[1].w && corners[2][axis] > corners[2].w) ||
+                          (corners[0][axis] < -corners[0].w && corners[1][axis] < -corners[1].w && corners[2][axis] < -corners[2].w);
+            }
+            if(outside) continue;
+            // Clip the triangle against the near plane (z >= -w), which gives a polygon of up to 4 vertices
+            glm::vec4 polygon[4];
+            int polygonSize = 0;
+            for(int corner = 0; corner < 3; corner++) {
+                const glm::vec4& current = corners[corner];
+                const glm::vec4& next = corners[(corner + 1) % 3];
+                float currentDistance = current.z + current.w, nextDistance = next.z + next.w;
+                if(currentDistance >= 0) polygon[polygonSize++] = current;
+                if((currentDistance >= 0) != (nextDistance >= 0))
+                    polygon[polygonSize++] = current + (next - current) * (currentDistance / (currentDistance - nextDistance));
+            }
+            if(polygonSize < 3) continue;
+            glm::vec3 screen[4];
+            for(int corner = 0; corner < polygonSize; corner++) screen[corner] = toScreen(polygon[corner]);
+            addTriangle(screen[0], screen[1], screen[2]);
+            if(polygonSize == 4) addTriangle(screen[0], screen[2], screen[3]);
+        }
+    }
+
+    void OcclusionCuller::rasterizeRows(int firstRow, int lastRow) {
+        float* depthBuffer = levels[0].data();
+        for(const std::vector<Triangle>& triangles : occluderTriangles) {
+            for(const Triangle& triangle : triangles) {
+                int minY = std::max(triangle.minY, firstRow), maxY = std::min(triangle.maxY, lastRow);
+                if(minY > maxY) continue;
+                int minX = triangle.minX & ~3; // The pixels are processed in aligned groups of 4
+#ifdef OCCLUSION_CULLING_SSE
+                const __m128 offsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+                const __m128 zero = _mm_setzero_ps();
+                __m128 edgeA[3], edgeB[3], edgeC[3];
+                for(int edge = 0; edge < 3; edge++) {
+                    edgeA[edge] = _mm_set1_ps(triangle.edgeA[edge]);
+                    edgeB[edge] = _mm_set1_ps(triangle.edgeB[edge]);
+                    edgeC[edge] = _mm_set1_ps(triangle.edgeC[edge]);
+                }
+                const __m128 depthA = _mm_set1_ps(triangle.depthA), depthB = _mm_set1_ps(triangle.depthB), depthC = _mm_set1_ps(triangle.depthC);
+                for(int y = minY; y <= maxY; y++) {
+                    float* row = depthBuffer + size_t(y) * OCCLUSION_BUFFER_WIDTH;
+                    __m128 pixelY = _mm_set1_ps(y + 0.5f);
+                    for(int x = minX; x <= triangle.maxX; x += 4) {
+                        __m128 pixelX = _mm_add_ps(_mm_set1_ps(float(x)), offsets);
+                        __m128 inside = _mm_cmpeq_ps(zero, zero); // All bits set
+                        for(int edge = 0; edge < 3; edge++) {
+                            __m128 value = _mm_add_ps(_mm_add_ps(_mm_mul_ps(edgeA[edge], pixelX), _mm_mul_ps(edgeB[edge], pixelY)), edgeC[edge]);
+                            inside = _mm_and_ps(inside, _mm_cmpge_ps(value, zero));
+                        }
+                        if(_mm_movemask_ps(inside) == 0) continue;
+                        __m128 depth = _mm_add_ps(_mm_add_ps(_mm_mul_ps(depthA, pixelX), _mm_mul_ps(depthB, pixelY)), depthC);
+                        __m128 old = _mm_loadu_ps(row + x);
+                        __m128 nearest = _mm_min_ps(old, depth);
+                        _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, old)));
+                    }
+                }
+#else
+                for(int y = minY; y <= maxY; y++) {
+                    float* row = depthBuffer + size_t(y) * OCCLUSION_BUFFER_WIDTH;
+                    float pixelY = y + 0.5f;
+                    for(int x = minX; x <= triangle.maxX; x++) {
+                        float pixelX = x + 0.5f;
+                        bool inside = true;
+                        for(int edge = 0; edge < 3; edge++)
+                            inside = inside && triangle.edgeA[edge] * pixelX + triangle.edgeB[edge] * pixelY + triangle.edgeC[edge] >= 0;
+                        if(!inside) continue;
+                        row[x] = std::min(row[x], triangle.depthA * pixelX + triangle.depthB * pixelY + triangle.depthC);
+                    }
+                }
+#endif
+            }
+        }
+    }
+
+    void OcclusionCuller::buildPyramid() {
+        for(size_t level = 1; level < levels.size(); level++) {
+            const std::vector<float>& source = levels[level - 1];
+            glm::ivec2 sourceSize = levelSizes[level - 1], size = levelSizes[level];
+            std::vector<float>& destination = levels[level];
+            for(int y = 0; y < size.y; y++) {
+                int y0 = std::min(2 * y, sourceSize.y - 1), y1 = std::min(2 * y + 1, sourceSize.y - 1);
+                for(int x = 0; x < size.x; x++) {
+                    int x0 = std::min(2 * x, sourceSize.x - 1), x1 = std::min(2 * x + 1, sourceSize.x - 1);
+                    destination[size_t(y) * size.x + x] = std::max(
+                        std::max(source[size_t(y0) * sourceSize.x + x0], source[size_t(y0) * sourceSize.x + x1]),
+                        std::max(source[size_t(y1) * sourceSize.x + x0], source[size_t(y1) * sourceSize.x + x1]));
+                }
+            }
+        }
+    }
+
+    void OcclusionCuller::rasterizeOccluders() {
+        if(occluderTriangles.size() < occluders.size()) {
+            occluderTriangles.resize(occluders.size());
+            clipPositions.resize(occluders.size());
+        }
+        for(size_t index = occluders.size(); index < occluderTriangles.size(); index++) occluderTriangles[index].clear();
+
+        JobSystem& jobs = JobSystem::getInstance();
+        // First, the triangles of the occluders are set up in parallel
+        jobs.parallelFor(occluders.size(), 1, [this](size_t begin, size_t end){
+            for(size_t index = begin; index < end; index++) setupOccluder(index);
+        });
+        // Then each band of rows is rasterized by a separate job
+        constexpr int bandCount = (OCCLUSION_BUFFER_HEIGHT + OCCLUSION_BAND_HEIGHT - 1) / OCCLUSION_BAND_HEIGHT;
+        jobs.parallelFor(bandCount, 1, [this](size_t begin, size_t end){
+            for(size_t band = begin; band < end; band++)
+                rasterizeRows(int(band) * OCCLUSION_BAND_HEIGHT, std::min(int(band + 1) * OCCLUSION_BAND_HEIGHT, OCCLUSION_BUFFER_HEIGHT) - 1);
+        });
+        buildPyramid();
+
+        stats.occluders = occluders.size();
+        stats.occluderTriangles = 0;
+        for(size_t index = 0; index < occluders.size(); index++) stats.occluderTriangles += occluderTriangles[index].size();
+    }
+
+    bool OcclusionCuller::isVisible(const glm::mat4& localToWorld, const glm::vec3& boundsMin, const glm::vec3& boundsMax) const {
+        glm::mat4 transform = viewProjection * localToWorld;
+        glm::vec2 screenMin(INFINITY), screenMax(-INFINITY);
+        float nearestDepth = INFINITY;
+        for(int corner = 0; corner < 8; corner++) {
+            glm::vec3 local((corner & 1) ? boundsMax.x : boundsMin.x, (corner & 2) ? boundsMax.y : boundsMin.y, (corner & 4) ? boundsMax.z : boundsMin.z);
+            glm::vec4 clip = transform * glm::vec4(local, 1.0f);
+            // A box that crosses the near plane surrounds the camera, so it can't be hidden
+            if(clip.z < -clip.w || clip.w <= 0) return true;
+            glm::vec3 ndc = glm::vec3(clip) / clip.w;
+            screenMin = glm::min(screenMin, glm::vec2(ndc));
+            screenMax = glm::max(screenMax, glm::vec2(ndc));
+            nearestDepth = std::min(nearestDepth, ndc.z * 0.5f + 0.5f);
+        }
+        // The rectangle of the pixels touched by the box (the boxes outside the screen are left to the frustum culling)
+        const glm::vec2 screenScale(OCCLUSION_BUFFER_WIDTH * 0.5f, OCCLUSION_BUFFER_HEIGHT * 0.5f);
+        screenMin = (screenMin + 1.0f) * screenScale;
+        screenMax = (screenMax + 1.0f) * screenScale;
+        if(screenMax.x < 0 || screenMax.y < 0 || screenMin.x > OCCLUSION_BUFFER_WIDTH || screenMin.y > OCCLUSION_BUFFER_HEIGHT) return true;
+        glm::ivec2 pixelMin = glm::max(glm::ivec2(glm::floor(screenMin)), glm::ivec2(0));
+        glm::ivec2 pixelMax = glm::min(glm::ivec2(glm::floor(screenMax)), glm::ivec2(OCCLUSION_BUFFER_WIDTH - 1, OCCLUSION_BUFFER_HEIGHT - 1));
+
+        // Find the first level where the rectangle covers at most 2x2 texels, then compare with the farthest depth of these texels
+        size_t level = 0;
+        while(level + 1 < levels.size() && ((pixelMax.x >> level) - (pixelMin.x >> level) > 1 || (pixelMax.y >> level) - (pixelMin.y >> level) > 1)) level++;
+        glm::ivec2 size = levelSizes[level];
+        glm::ivec2 texelMin = glm::min(pixelMin >> int(level), size - 1), texelMax = glm::min(pixelMax >> int(level), size - 1);
+        const std::vector<float>& depths = levels[level];
+        float farthestDepth = 0.0f;
+        for(int y = texelMin.y; y <= texelMax.y; y++)
+            for(int x = texelMin.x; x <= texelMax.x; x++)
+                farthestDepth = std::max(farthestDepth, depths[size_t(y) * size.x + x]);
+        return nearestDepth <= farthestDepth;
+    }
+
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// The occluders are rasterized with SSE when the target supports it (always the case on x86-64), otherwise with scalar code
+#if !defined(OCCLUSION_CULLING_SCALAR) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+    #define OCCLUSION_CULLING_SSE
+#endif
+
+// The resolution of the CPU depth buffer (the width must be a multiple of 4 since the pixels are processed 4 at a time)
+#define OCCLUSION_BUFFER_WIDTH 256
+#define OCCLUSION_BUFFER_HEIGHT 128
+// The number of rows rasterized by each job (every job owns its rows, so the jobs never write to the same pixels)
+#define OCCLUSION_BAND_HEIGHT 16
+
+namespace our
+{
+
+    // The counters of the last frame rasterized by an occlusion culler
+    struct OcclusionStats {
+        std::uint64_t occluders = 0; // The occluders given to the culler
+        std::uint64_t occluderTriangles = 0; // The triangles that were rasterized after clipping (the ones outside the screen are not counted)
+    };
+
+    // This class culls the objects hidden behind a few big occluders (such as the ground or the walls) without the GPU.
+    // The occluders are rasterized into a small depth buffer (in parallel on the job system, 4 pixels at a time with SIMD)
+    // then a hierarchical depth pyramid is built from it where every texel holds the farthest depth of the texels it covers.
+    // An object is hidden if the nearest point of its bounding box is behind the farthest occluder depth over its screen rectangle.
+    // Depths are stored in the [0, 1] window range of OpenGL (0 on the near plane and 1 on the far plane).
+    // Usage per frame: "beginFrame", then "addOccluder" for each occluder, "rasterizeOccluders" and finally "isVisible" for each object.
+    class OcclusionCuller {
+        // A triangle ready to be rasterized: its edge functions and its depth plane in pixel coordinates and its pixel rectangle
+        struct Triangle {
+            float edgeA[3], edgeB[3], edgeC[3]; // A pixel (x, y) is inside if "edgeA[i] * x + edgeB[i] * y + edgeC[i] >= 0" for all i
+            float depthA, depthB, depthC; // The depth at a pixel (x, y) is "depthA * x + depthB * y + depthC"
+            int minX, maxX, minY, maxY;
+        };
+
+        struct Occluder {
+            glm::mat4 transform; // From the local space of the occluder to the clip space
+            const glm::vec3* positions;
+            const std::uint32_t* elements;
+            size_t elementCount;
+        };
+
+        glm::mat4 viewProjection = glm::mat4(1.0f);
+        std::vector<Occluder> occluders;
+        std::vector<std::vector<Triangle>> occluderTriangles; // The triangles of each occluder (kept between frames to reuse their memory)
+        std::vector<std::vector<glm::vec4>> clipPositions; // The clip space positions of the vertices of each occluder
+        // The levels of the depth pyramid: the level 0 is the depth buffer and every next level has half its width and height
+        std::vector<std::vector<float>> levels;
+        std::vector<glm::ivec2> levelSizes;
+        OcclusionStats stats;
+
+        // Transforms, clips and sets up the triangles of the given occluder
+        void setupOccluder(size_t index);
+        // Rasterizes the triangles of all the occluders into the rows [firstRow, lastRow] of the depth buffer
+        void rasterizeRows(int firstRow, int lastRow);
+        // Builds the levels of the depth pyramid above the depth buffer
+        void buildPyramid();
+
+    public:
+        OcclusionCuller();
+
+        // Clears the depth buffer and the occluders for a new frame seen through the given view projection matrix
+        void beginFrame(const glm::mat4& viewProjection);
+
+        // Adds a triangle mesh that hides what is behind it. The vertices are transformed by "localToWorld".
+        // The arrays are not copied, so they must stay alive until "rasterizeOccluders" returns
+        void addOccluder(const glm::mat4& localToWorld, const glm::vec3* positions, const std::uint32_t* elements, size_t elementCount);
+
+        // Rasterizes all the added occluders then builds the depth pyramid
+        void rasterizeOccluders();
+
+        // Returns false if the given local space box transformed by "localToWorld" is completely hidden by the occluders
+        // The test is conservative (a hidden box may be reported as visible, never the opposite) and it only reads the
+        // depth pyramid, so it can be called from many threads at once after "rasterizeOccluders"
+        bool isVisible(const glm::mat4& localToWorld, const glm::vec3& boundsMin, const glm::vec3& boundsMax) const;
+
+        // Returns the depth of a pixel of the depth buffer (1 where no occluder was drawn)
+        float getDepth(int x, int y) const { return levels[0][size_t(y) * OCCLUSION_BUFFER_WIDTH + x]; }
+
+        const OcclusionStats& getStats() const { return stats; }
+    };
+
+}
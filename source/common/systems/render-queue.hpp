@@ -0,0 +1,139 @@
+#pragma once
+
+#include "../mesh/mesh.hpp"
+#include "../material/material.hpp"
+
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <vector>
+
+// The number of layers a mesh renderer can be drawn in (the layer is stored in the top 4 bits of the sort key)
+#define RENDER_LAYER_COUNT 16
+
+namespace our
+{
+
+    // The render command stores command that tells the renderer that it should draw
+    // the given mesh at the given localToWorld matrix using the given material
+    // The renderer will fill this struct using the mesh renderer components
+    struct RenderCommand {
+        glm::mat4 localToWorld;
+        glm::mat3 normalMatrix; // The inverse transpose of localToWorld (used to transform the normals)
+        glm::vec3 center;
+        Mesh* mesh;
+        Material* material;
+        std::uint64_t sortKey; // The commands are drawn in the increasing order of their keys (see "makeOpaqueSortKey" and "makeTransparentSortKey")
+    };
+
+    // The sort keys pack everything that decides the draw order into 64 bits, so sorting only compares integers:
+    // - bits 63-60: the layer (layers are drawn in increasing order)
+    // - bit 59: the transparency (opaque draws come first)
+    // - bits 58-0 of an opaque draw: the shader (12 bits), the material (16 bits), the mesh (15 bits) and the quantized view depth (16 bits)
+    //   so the draws are grouped by state and, inside a group, go roughly front to back to help the early depth test
+    // - bits 58-0 of a transparent draw: the inverted view depth (32 bits), the shader (12 bits) and the material (15 bits)
+    //   so the draws go strictly back to front as the blending requires
+    // The IDs are truncated to their field, which can only make two different states share a group.
+    namespace sort_key {
+        inline std::uint64_t field(std::uint64_t value, int bits, int shift) {
+            return (value & ((std::uint64_t(1) << bits) - 1)) << shift;
+        }
+
+        // Returns the bits of a non-negative float, which sort in the same order as the floats themselves
+        inline std::uint32_t depthBits(float depth) {
+            depth = std::max(depth, 0.0f);
+            std::uint32_t bits;
+            std::memcpy(&bits, &depth, sizeof(bits));
+            return bits;
+        }
+
+        // Returns the layer stored in the given key
+        inline std::uint32_t layer(std::uint64_t key) {
+            return std::uint32_t(key >> 60);
+        }
+    }
+
+    // "depth" is the view depth of the command and "far" the distance to the camera far plane (used to quantize the depth)
+    // The IDs are the sort IDs of the shader, the material and the mesh
+    inline std::uint64_t makeOpaqueSortKey(std::uint32_t layer, std::uint32_t shaderID, std::uint32_t materialID, std::uint32_t meshID, float depth, float far) {
+        float normalizedDepth = std::min(std::max(depth / far, 0.0f), 1.0f);
+        return sort_key::field(layer, 4, 60) |
+               sort_key::field(shaderID, 12, 47) |
+               sort_key::field(materialID, 16, 31) |
+               sort_key::field(meshID, 15, 16) |
+               sort_key::field(std::uint32_t(normalizedDepth * 65535.0f), 16, 0);
+    }
+
+    inline std::uint64_t makeOpaqueSortKey(std::uint32_t layer, const Material* material, const Mesh* mesh, float depth, float far) {
+        return makeOpaqueSortKey(layer, material->shader->getSortID(), material->getSortID(), mesh->getSortID(), depth, far);
+    }
+
+    inline std::uint64_t makeTransparentSortKey(std::uint32_t layer, std::uint32_t shaderID, std::uint32_t materialID, float depth) {
+        return sort_key::field(layer, 4, 60) |
+               (std::uint64_t(1) << 59) |
+               sort_key::field(~sort_key::depthBits(depth), 32, 27) |
+               sort_key::field(shaderID, 12, 15) |
+               sort_key::field(materialID, 15, 0);
+    }
+
+    inline std::uint64_t makeTransparentSortKey(std::uint32_t layer, const Material* material, float depth) {
+        return makeTransparentSortKey(layer, material->shader->getSortID(), material->getSortID(), depth);
+    }
+
+    // A queue of render commands that are drawn in the order of their sort keys
+    // The commands are not moved while sorting: only (key, index) pairs are sorted with a radix sort
+    class RenderQueue {
+        struct SortEntry {
+            std::uint64_t key;
+            std::uint32_t index;
+        };
+
+        std::vector<RenderCommand> commands;
+        std::vector<SortEntry> entries, scratch; // Kept between frames to reuse their memory
+
+    public:
+        void clear() { commands.clear(); }
+        void reserve(size_t count) { commands.reserve(count); }
+        size_t size() const { return commands.size(); }
+        bool empty() const { return commands.empty(); }
+
+        void push(const RenderCommand& command) { commands.push_back(command); }
+
+        template<typename Iterator>
+        void append(Iterator begin, Iterator end) { commands.insert(commands.end(), begin, end); }
+
+        // Sorts the commands by their keys (the sort is stable, so commands with equal keys keep their insertion order)
+        // This is a least significant digit radix sort on 8 bit digits. The digits that are the same in all the keys are skipped,
+        // so the cost only depends on the number of bits that actually vary.
+        void sort() {
+            size_t count = commands.size();
+            entries.resize(count);
+            scratch.resize(count);
+            // Count the occurrences of each digit value for the 8 digits in a single pass
+            std::uint32_t histograms[8][256] = {};
+            for(size_t index = 0; index < count; index++){
+                std::uint64_t key = commands[index].sortKey;
+                entries[index] = {key, std::uint32_t(index)};
+                for(int digit = 0; digit < 8; digit++) histograms[digit][(key >> (digit * 8)) & 0xFF]++;
+            }
+            for(int digit = 0; digit < 8; digit++){
+                std::uint32_t* histogram = histograms[digit];
+                // If every key has the same value for this digit, this pass wouldn't change the order
+                if(count == 0 || histogram[(entries[0].key >> (digit * 8)) & 0xFF] == count) continue;
+                std::uint32_t offset = 0;
+                for(int value = 0; value < 256; value++){
+                    std::uint32_t occurrences = histogram[value];
+                    histogram[value] = offset;
+                    offset += occurrences;
+                }
+                for(const SortEntry& entry : entries) scratch[histogram[(entry.key >> (digit * 8)) & 0xFF]++] = entry;
+                entries.swap(scratch);
+            }
+        }
+
+        // Returns the i-th command in the sorted order (valid after "sort")
+        const RenderCommand& operator[](size_t index) const { return commands[entries[index].index]; }
+    };
+
+}
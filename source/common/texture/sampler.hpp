@@ -3,6 +3,7 @@
 #include <glad/gl.h>
 #include <json/json.hpp>
 #include <glm/vec4.hpp>
+#include "../gl-state.hpp"
 
 namespace our {
 
@@ -19,16 +20,17 @@ namespace our {
         // This deconstructor deletes the underlying OpenGL sampler
         ~Sampler() { 
             glDeleteSamplers(1, &name);
+            GLStateCache::getInstance().invalidate(); // The name may be reused by a new object, so the cache must not trust it
          }
 
         // This method binds this sampler to the given texture unit
         void bind(GLuint textureUnit) const {
-            glBindSampler(textureUnit, name);
+            GLStateCache::getInstance().bindSampler(textureUnit, name);
         }
 
         // This static method ensures that no sampler is bound to the given texture unit
         static void unbind(GLuint textureUnit){
-            glBindSampler(textureUnit, 0);
+            GLStateCache::getInstance().bindSampler(textureUnit, 0);
         }
 
         // This function sets a sampler paramter where the value is of type "GLint"
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <glad/gl.h>
+#include <cstddef>
+#include "../gl-state.hpp"
+
+namespace our {
+
+    // This class defines an OpenGL buffer texture (GL_TEXTURE_BUFFER): a buffer whose content is read in the shaders
+    // using "texelFetch" on a samplerBuffer. Unlike a uniform buffer, its size is only limited by GL_MAX_TEXTURE_BUFFER_SIZE.
+    class TextureBuffer {
+        // The OpenGL object names of the buffer holding the data and of the texture reading it
+        GLuint buffer = 0, texture = 0;
+    public:
+        // This constructor creates an empty buffer texture whose texels have the given internal format (for example GL_RGBA32F)
+        explicit TextureBuffer(GLenum format) {
+            glGenBuffers(1, &buffer);
+            glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+            glBufferData(GL_TEXTURE_BUFFER, 16, nullptr, GL_STREAM_DRAW);
+            glBindBuffer(GL_TEXTURE_BUFFER, 0);
+            glGenTextures(1, &texture);
+            // The texture may be created during a frame, so it is bound through the cache to keep the shadowed bindings right
+            GLStateCache::getInstance().bindTexture(0, GL_TEXTURE_BUFFER, texture);
+            glTexBuffer(GL_TEXTURE_BUFFER, format, buffer);
+        }
+
+        // This deconstructor deletes the underlying OpenGL objects
+        ~TextureBuffer() {
+            glDeleteTextures(1, &texture);
+            glDeleteBuffers(1, &buffer);
+            GLStateCache::getInstance().invalidate(); // The name may be reused by a new object, so the cache must not trust it
+        }
+
+        // Replaces the content of the buffer
+        // The old storage is orphaned, so the driver doesn't wait for the draws of the previous frame that still read it
+        void update(const void* data, size_t size) {
+            glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+            if(size == 0) glBufferData(GL_TEXTURE_BUFFER, 16, nullptr, GL_STREAM_DRAW); // An empty buffer can't be attached
+            else glBufferData(GL_TEXTURE_BUFFER, size, data, GL_STREAM_DRAW);
+            glBindBuffer(GL_TEXTURE_BUFFER, 0);
+        }
+
+        // Binds the texture to the given texture unit
+        void bind(GLuint unit) const {
+            GLStateCache::getInstance().bindTexture(unit, GL_TEXTURE_BUFFER, texture);
+        }
+
+        TextureBuffer(const TextureBuffer&) = delete;
+        TextureBuffer& operator=(const TextureBuffer&) = delete;
+    };
+
+}
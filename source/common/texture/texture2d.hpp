@@ -1,6 +1,7 @@
 #pragma once
 
 #include <glad/gl.h>
+#include "../gl-state.hpp"
 
 namespace our {
 
@@ -18,13 +19,20 @@ namespace our {
         // This deconstructor deletes the underlying OpenGL texture
         ~Texture2D() { 
             glDeleteTextures(1, &name);
+            GLStateCache::getInstance().invalidate(); // The name may be reused by a new object, so the cache must not trust it
         }
 
         // This method binds this texture to GL_TEXTURE_2D
+        // It bypasses the GL state cache, so it should only be used while loading textures (outside of a frame)
         void bind() const {
             glBindTexture(GL_TEXTURE_2D, name);
         }
 
+        // This method binds this texture to GL_TEXTURE_2D of the given texture unit through the GL state cache
+        void bind(GLuint textureUnit) const {
+            GLStateCache::getInstance().bindTexture(textureUnit, GL_TEXTURE_2D, name);
+        }
+
         // This static method ensures that no texture is bound to GL_TEXTURE_2D
         static void unbind(){
             glBindTexture(GL_TEXTURE_2D, 0);
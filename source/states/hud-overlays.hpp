@@ -0,0 +1,68 @@
+#pragma once
+
+#include <ecs/world.hpp>
+#include <ecs/prefab.hpp>
+#include <components/mesh-renderer.hpp>
+#include <json/json.hpp>
+
+// The score and the win/lose overlays of the play state
+// The overlays of the scene config are compiled into prefabs once, then they are instantiated when they are first needed.
+// The score entity is persistent: when the score changes, it takes the renderer and the transform of the new score's prototype,
+// so no entity is created per frame.
+class HUDOverlays {
+public:
+    // The names of the score overlays in the scene config (the index is the score)
+    static constexpr const char* scoreNames[] = { "zero", "one", "two", "three", "four", "five" };
+    static constexpr int scoreCount = sizeof(scoreNames) / sizeof(scoreNames[0]);
+
+private:
+    our::Prefab scorePrefabs[scoreCount];
+    our::Prefab winPrefab, losePrefab;
+    our::EntityHandle scoreEntity; // The persistent entity that displays the score (it is updated when the score changes)
+    our::EntityHandle announcementEntity; // The entity that announces the win or the loss
+    int displayedScore = -1; // The score currently shown by "scoreEntity"
+
+public:
+    // Compiles the score and win/lose overlays of the scene config into prefabs
+    void compile(const nlohmann::json& config)
+    {
+        for (int score = 0; score < scoreCount; score++) {
+            scorePrefabs[score].compile(config.value(scoreNames[score], nlohmann::json::array()));
+        }
+        winPrefab.compile(config.value("win", nlohmann::json::array()));
+        losePrefab.compile(config.value("lose", nlohmann::json::array()));
+        scoreEntity = our::EntityHandle();
+        announcementEntity = our::EntityHandle();
+        displayedScore = -1;
+    }
+
+    // Shows the win or lose overlay in the given world (only once, the overlay then stays in the world)
+    void announceWinOrLose(our::World* world, bool win)
+    {
+        if (world->get(announcementEntity)) return;
+        our::Prefab& prefab = win ? winPrefab : losePrefab;
+        if (our::Entity* announcement = prefab.instantiate(world)) {
+            announcementEntity = announcement->getHandle();
+        }
+    }
+
+    // Shows the given score in the given world. The score entity is created the first time, then it copies the renderer
+    // (mesh, material, ...) and the local transform of the prototype of the new score, so the overlays may differ in more than their material
+    void displayScore(our::World* world, int score)
+    {
+        if (score == displayedScore || score < 0 || score >= scoreCount || scorePrefabs[score].empty()) return;
+        our::Entity* entity = world->get(scoreEntity);
+        if (!entity) {
+            entity = scorePrefabs[score].instantiate(world);
+            scoreEntity = entity->getHandle();
+        } else {
+            const our::Entity* prototype = scorePrefabs[score].getRoot();
+            entity->copyComponentFrom<our::MeshRendererComponent>(prototype);
+            entity->setLocalTransform(prototype->getLocalTransform());
+        }
+        displayedScore = score;
+    }
+
+    // Returns the entity showing the score (or a null handle if no score was displayed yet)
+    our::EntityHandle getScoreEntity() const { return scoreEntity; }
+};
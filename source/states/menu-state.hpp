@@ -22,9 +22,9 @@ class MenuState: public our::State {
     void onInitialize() override {
         // First of all, we get the scene configuration from the app config
         auto& config = getApp()->getConfig()["scene"];
-        // If we have assets in the scene config, we deserialize them
+        // If we have assets in the scene config, we deserialize them (and log the loading time if "startup-timing" is enabled)
         if(config.contains("assets")){
-            our::deserializeAllAssets(config["assets"]);
+            our::deserializeAllAssets(config["assets"], getApp()->getConfig().value("startup-timing", false));
         }
         // If we have a world in the scene config, we use it to populate our world
         if(config.contains("menu")){
@@ -50,6 +50,8 @@ class MenuState: public our::State {
     }
 
     void onDestroy() override {
+        // We release the GPU resources of the renderer while the OpenGL context is alive
+        renderer.destroy();
         // and we delete all the loaded assets to free memory on the RAM and the VRAM
         our::clearAllAssets();
     }
@@ -3,6 +3,8 @@
 #include <application.hpp>
 
 #include <ecs/world.hpp>
+#include <ecs/system-scheduler.hpp>
+#include <ecs/prefab.hpp>
 #include <systems/forward-renderer.hpp>
 #include <systems/free-player-controller.hpp>
 #include <systems/movement.hpp>
@@ -11,6 +13,8 @@
 #include <components/mesh-renderer.hpp>
 #include <stdlib.h>
 
+#include "hud-overlays.hpp"
+
 // This state shows how to use the ECS framework and deserialization.
 class Playstate: public our::State {
 
@@ -19,91 +23,74 @@ class Playstate: public our::State {
     our::PlayerControllerSystem playerController;
     our::MovementSystem movementSystem;
     our::ObstacleCollisionSystem obstacleCollisionSystem;
+    our::SystemScheduler scheduler; // Runs the game logic systems (in parallel when their data accesses don't conflict)
+    bool stopPlaying = false; // Set by the player controller when the game ends
+    HUDOverlays overlays; // The score and win/lose overlays (compiled once when the state is initialized)
 
     void onInitialize() override {
         // First of all, we get the scene configuration from the app config
         auto& config = getApp()->getConfig()["scene"];
-        // If we have assets in the scene config, we deserialize them
+        // If we have assets in the scene config, we deserialize them (and log the loading time if "startup-timing" is enabled)
         if(config.contains("assets")){
-            our::deserializeAllAssets(config["assets"]);
+            our::deserializeAllAssets(config["assets"], getApp()->getConfig().value("startup-timing", false));
         }
         // If we have a world in the scene config, we use it to populate our world
         if(config.contains("world")){
             world.deserialize(config["world"]);
             storeObstacles();
         }
+        overlays.compile(config);
+        // The renderer options are optional, so a scene without them uses the defaults
+        renderer.configure(config.value("renderer", nlohmann::json::object()));
         // We initialize the player controller system since it needs a pointer to the app
         playerController.enter(getApp());
+        scheduleSystems();
+    }
+
+    // Registers the game logic systems with the data that each of them reads and writes
+    void scheduleSystems()
+    {
+        scheduler.clear();
+        scheduler.add(our::SystemAccess().reads<our::MovementComponent>().writes<our::Transform>(),
+            [this](our::World* world, float deltaTime) {
+                movementSystem.update(world, deltaTime);
+            });
+        // The player controller reads the input and ends the game in the movement system, so it stays on the main thread
+        scheduler.add(our::SystemAccess().reads<our::MeshRendererComponent, our::FreePlayerControllerComponent>().writes<our::Transform>().onMainThread(),
+            [this](our::World* world, float deltaTime) {
+                stopPlaying = playerController.update(world, deltaTime, &obstacleCollisionSystem, &movementSystem);
+            });
     }
 
     void storeObstacles()
     {
-        for (auto entity : world.getEntities()) {
-            our::MeshRendererComponent* obstacle = entity->getComponent<our::MeshRendererComponent>();
-            if (obstacle != nullptr && obstacle->isObstacle()) {
+        obstacleCollisionSystem.clear();
+        world.forEach<our::MeshRendererComponent>([&](our::Entity* /*entity*/, our::MeshRendererComponent* obstacle) {
+            if (obstacle->isObstacle()) {
                 // store obstacle position and dimensions to be able to detect collision
                 float obstacleRadius = obstacle->radius;
                 glm::vec3 obstaclePosition = obstacle->fixedPosition;
                 obstacleCollisionSystem.addObstacle(obstacleRadius, obstaclePosition);
             }
-        }
+        });
     }
 
     void onDraw(double deltaTime) override {
         // Here, we just run a bunch of systems to control the world logic
-        movementSystem.update(&world, (float)deltaTime);
-        bool stopPlaying = playerController.update(&world, (float)deltaTime, &obstacleCollisionSystem, &movementSystem);
-        auto& config = getApp()->getConfig()["scene"];
+        scheduler.run(&world, (float)deltaTime);
         if (stopPlaying) {
-            announceWinOrLose(config);
+            overlays.announceWinOrLose(&world, playerController.isWin());
         }
-        int score = playerController.getScore();
-        displayScore(score, config);
+        overlays.displayScore(&world, playerController.getScore());
 
         // And finally we use the renderer system to draw the scene
         auto size = getApp()->getFrameBufferSize();
         renderer.render(&world, glm::ivec2(0, 0), size);
     }
 
-    void announceWinOrLose(const nlohmann::json& config)
-    {
-        if (playerController.isWin()) {
-            // announce winning
-            if (config.contains("win")) {
-                world.deserialize(config["win"]);
-            }
-        }
-        else {
-            // announce losing
-            if (config.contains("lose")) {
-                world.deserialize(config["lose"]);
-            }
-        }
-    }
-
-    void displayScore(int score, const nlohmann::json& config)
-    {
-        if (score == 0) {
-            if (config.contains("zero")) { world.deserialize(config["zero"]); }
-        }
-        else if (score == 1) {
-            if (config.contains("one")) { world.deserialize(config["one"]); }
-        }
-        else if (score == 2) {
-            if (config.contains("two")) { world.deserialize(config["two"]); }
-        }
-        else if (score == 3) {
-            if (config.contains("three")) { world.deserialize(config["three"]); }
-        }
-        else if (score == 4) {
-            if (config.contains("four")) { world.deserialize(config["four"]); }
-        }
-        else if (score == 5) {
-            if (config.contains("five")) { world.deserialize(config["five"]); }
-        }
-    }
-
     void onDestroy() override {
+        // We release the GPU resources of the renderer while the OpenGL context is alive
+        renderer.destroy();
         // and we delete all the loaded assets to free memory on the RAM and the VRAM
         our::clearAllAssets();
     }
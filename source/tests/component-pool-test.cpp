@@ -0,0 +1,71 @@
+#include <ecs/world.hpp>
+#include <components/movement.hpp>
+#include <components/light.hpp>
+
+#include <cstdio>
+#include <deque>
+#include <vector>
+
+// Checks that the component pools stop allocating from the heap once the game reaches a steady state:
+// every frame spawns and despawns entities and moves some of them between archetypes, and the level is restarted
+// (all the entities are deleted) every few frames, but the number of live entities stays bounded,
+// so after the warmup frames every component block must be recycled from the pools
+#define WARMUP_FRAMES 200
+#define FRAMES 10000
+#define SPAWNS_PER_FRAME 20
+#define LIFETIME_FRAMES 50
+#define RESTART_FRAMES 500
+
+int main() {
+    our::World world;
+    std::deque<std::vector<our::EntityHandle>> spawned; // The entities spawned by each of the last LIFETIME_FRAMES frames
+
+    int failures = 0;
+    our::ComponentPoolStats warm;
+    for (int frame = 0; frame < WARMUP_FRAMES + FRAMES; frame++) {
+        std::vector<our::EntityHandle>& handles = spawned.emplace_back();
+        for (int index = 0; index < SPAWNS_PER_FRAME; index++) {
+            our::Entity* entity = world.add();
+            entity->addComponent<our::MovementComponent>();
+            if (index % 3 == 0) entity->addComponent<our::LightComponent>();
+            handles.push_back(entity->getHandle());
+        }
+        // Some of the older entities lose or gain a component, which moves them to another archetype
+        for (our::EntityHandle handle : spawned.front()) {
+            our::Entity* entity = world.get(handle);
+            if (entity->getComponent<our::LightComponent>()) entity->deleteComponent<our::LightComponent>();
+            else entity->addComponent<our::LightComponent>();
+        }
+        if (frame % RESTART_FRAMES == RESTART_FRAMES - 1) {
+            for (our::Entity* entity : world.getEntities()) world.markForRemoval(entity);
+            spawned.clear();
+        } else if (spawned.size() > LIFETIME_FRAMES) {
+            for (our::EntityHandle handle : spawned.front()) world.markForRemoval(handle);
+            spawned.pop_front();
+        }
+        world.deleteMarkedEntities();
+        world.updateTransforms();
+
+        if (frame + 1 == WARMUP_FRAMES) warm = world.getComponentPoolStats();
+    }
+
+    our::ComponentPoolStats stats = world.getComponentPoolStats();
+    if (stats.heapAllocations != warm.heapAllocations) {
+        std::printf("FAILED: %zu heap allocations after the warmup (%zu before)\n", stats.heapAllocations - warm.heapAllocations, warm.heapAllocations);
+        failures++;
+    }
+    if (stats.reuses == warm.reuses) {
+        std::printf("FAILED: no block was recycled after the warmup\n");
+        failures++;
+    }
+    our::ComponentPoolStats movementStats = world.getComponentPoolStats<our::MovementComponent>();
+    our::ComponentPoolStats lightStats = world.getComponentPoolStats<our::LightComponent>();
+    if (movementStats.heapAllocations + lightStats.heapAllocations != stats.heapAllocations) {
+        std::printf("FAILED: the pools of the component types don't add up to the total\n");
+        failures++;
+    }
+
+    std::printf("%d frames, %zu heap allocations, %zu reuses, %zu blocks in use, %zu free blocks, %d failures\n",
+        FRAMES, stats.heapAllocations, stats.reuses, stats.blocksInUse, stats.freeBlocks, failures);
+    return failures == 0 ? 0 : 1;
+}
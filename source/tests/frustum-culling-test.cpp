@@ -0,0 +1,96 @@
+#include <systems/frustum-culling.hpp>
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+// Checks the frustum culling: the SSE version must give exactly the same result as the scalar version for every sphere
+// (including the tail of a batch that isn't a multiple of 4), and both must agree with a plain double precision test
+#define SPHERE_COUNT 100003
+#define TOLERANCE 1e-3 // The spheres that touch a plane within this distance may go either way in single precision
+
+namespace {
+
+    using namespace our::frustum_culling;
+
+    // Returns how far the sphere is inside the frustum (negative when it is completely outside one of the planes)
+    double getClearance(const Frustum& frustum, const glm::vec4& sphere) {
+        double clearance = 1e30;
+        for(const glm::vec4& plane : frustum.planes) {
+            double distance = double(plane.x) * sphere.x + double(plane.y) * sphere.y + double(plane.z) * sphere.z + plane.w;
+            clearance = std::min(clearance, distance + sphere.w);
+        }
+        return clearance;
+    }
+
+    // Tests the spheres with both versions and compares them with each other and with the double precision test
+    int checkSpheres(const char* name, const Frustum& frustum, const std::vector<glm::vec4>& spheres, size_t& visibleCount) {
+        int failures = 0;
+        std::vector<std::uint8_t> simd(spheres.size()), scalar(spheres.size());
+        testSpheres(frustum, spheres.size(), spheres.data(), simd.data());
+        testSpheresScalar(frustum, spheres.size(), spheres.data(), scalar.data());
+        for(size_t index = 0; index < spheres.size(); index++) {
+            const glm::vec4& sphere = spheres[index];
+            if(simd[index] != scalar[index]) {
+                if(failures++ < 10) std::printf("FAILED: %s: sphere %zu (%f, %f, %f, %f) is %d with SSE and %d without\n",
+                    name, index, sphere.x, sphere.y, sphere.z, sphere.w, simd[index], scalar[index]);
+            }
+            double clearance = getClearance(frustum, sphere);
+            if(std::abs(clearance) > TOLERANCE && scalar[index] != (clearance > 0)) {
+                if(failures++ < 10) std::printf("FAILED: %s: sphere %zu (%f, %f, %f, %f) is %d but its clearance is %f\n",
+                    name, index, sphere.x, sphere.y, sphere.z, sphere.w, scalar[index], clearance);
+            }
+            visibleCount += scalar[index];
+        }
+        return failures;
+    }
+
+}
+
+int main() {
+    int failures = 0;
+    size_t visibleCount = 0;
+    std::mt19937 random(17);
+    std::uniform_real_distribution<float> coordinate(-120.0f, 120.0f), radius(0.0f, 8.0f);
+
+    glm::mat4 view = glm::lookAt(glm::vec3(5, 3, 20), glm::vec3(0, 0, 0), glm::vec3(0, 1, 0));
+    Frustum perspective = extractFrustum(glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 100.0f) * view);
+    Frustum orthographic = extractFrustum(glm::ortho(-30.0f, 30.0f, -20.0f, 20.0f, 0.1f, 80.0f) * view);
+
+    std::vector<glm::vec4> spheres(SPHERE_COUNT);
+    for(glm::vec4& sphere : spheres) sphere = glm::vec4(coordinate(random), coordinate(random), coordinate(random), radius(random));
+    // Spheres that touch the planes exactly (as far as float allows) are where the two versions could disagree
+    for(int plane = 0; plane < 6; plane++) {
+        for(int index = 0; index < 1000; index++) {
+            glm::vec4 sphere = spheres[plane * 1000 + index];
+            glm::vec3 normal = glm::vec3(perspective.planes[plane]);
+            float distance = glm::dot(normal, glm::vec3(sphere)) + perspective.planes[plane].w;
+            spheres[6000 + plane * 1000 + index] = glm::vec4(glm::vec3(sphere) - normal * (distance + sphere.w), sphere.w);
+        }
+    }
+    failures += checkSpheres("perspective", perspective, spheres, visibleCount);
+    failures += checkSpheres("orthographic", orthographic, spheres, visibleCount);
+
+    // A few spheres whose result is known
+    const std::vector<glm::vec4> known = {
+        {0, 0, 0, 1},       // At the target of the camera
+        {5, 3, 25, 1},      // Behind the camera
+        {-60, 0, -150, 1},  // Beyond the far plane
+        {-47, 0, 0, 1},     // Left of the view
+        {-47, 0, 0, 30},    // Left of the view, but big enough to reach into it
+        {5, 3, 20, 0.05f},  // Around the eye, between the eye and the near plane
+    };
+    const std::uint8_t expected[] = {1, 0, 0, 0, 1, 0};
+    std::vector<std::uint8_t> visible(known.size());
+    testSpheres(perspective, known.size(), known.data(), visible.data());
+    for(size_t index = 0; index < known.size(); index++) {
+        if(visible[index] != expected[index]) {
+            std::printf("FAILED: the known sphere %zu is %d instead of %d\n", index, visible[index], expected[index]);
+            failures++;
+        }
+    }
+
+    std::printf("%zu spheres, %zu visible, %d failures\n", spheres.size() * 2, visibleCount, failures);
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,77 @@
+#include <ecs/world.hpp>
+#include <asset-loader.hpp>
+#include <material/material.hpp>
+#include "../states/hud-overlays.hpp"
+
+#include <cstdio>
+
+// Checks that the HUD overlays don't create entities when the score changes:
+// after the first instantiation of the score and the announcement, the number of entities in the world must stay the same
+// and the score entity must look exactly like the overlay of the current score (renderer and transform)
+#define ITERATIONS 10000
+
+namespace {
+
+    // An overlay like the ones of the scene config (a textured plane in front of the camera)
+    // The overlays are moved and sized by "offset", so the test can tell which overlay the score entity copied
+    nlohmann::json overlay(const std::string& material, int offset) {
+        return nlohmann::json::array({{
+            {"position", {10 + offset, 5, -53}},
+            {"rotation", {0, 0, 0}},
+            {"scale", {3, 3, 3}},
+            {"components", nlohmann::json::array({{{"type", "Mesh Renderer"}, {"mesh", "plane"}, {"material", material}, {"radius", 1 + offset}}})}
+        }});
+    }
+
+}
+
+int main() {
+    // The materials are never drawn, so they don't need a shader or an OpenGL context
+    nlohmann::json config = nlohmann::json::object();
+    for (int score = 0; score < HUDOverlays::scoreCount; score++) {
+        our::AssetLoader<our::Material>::add(HUDOverlays::scoreNames[score], new our::Material());
+        config[HUDOverlays::scoreNames[score]] = overlay(HUDOverlays::scoreNames[score], score);
+    }
+    for (const char* name : { "win", "lose" }) {
+        our::AssetLoader<our::Material>::add(name, new our::Material());
+        config[name] = overlay(name, 0);
+    }
+
+    our::World world;
+    HUDOverlays overlays;
+    overlays.compile(config);
+
+    int failures = 0;
+    size_t entityCount = 0;
+    for (int iteration = 0; iteration < ITERATIONS; iteration++) {
+        int score = (iteration * 7 + iteration / 3) % HUDOverlays::scoreCount;
+        overlays.displayScore(&world, score);
+        overlays.announceWinOrLose(&world, iteration % 2 == 0);
+        world.updateTransforms();
+
+        if (iteration == 0) {
+            entityCount = world.getEntities().size();
+        } else if (world.getEntities().size() != entityCount) {
+            std::printf("FAILED: iteration %d has %zu entities instead of %zu\n", iteration, world.getEntities().size(), entityCount);
+            failures++;
+            entityCount = world.getEntities().size();
+        }
+
+        our::Entity* scoreEntity = world.get(overlays.getScoreEntity());
+        auto* scoreRenderer = scoreEntity ? scoreEntity->getComponent<our::MeshRendererComponent>() : nullptr;
+        if (!scoreRenderer || scoreRenderer->material != our::AssetLoader<our::Material>::get(HUDOverlays::scoreNames[score])) {
+            std::printf("FAILED: iteration %d doesn't display the score %d\n", iteration, score);
+            failures++;
+        } else if (scoreRenderer->getOwner() != scoreEntity || scoreRenderer->radius != 1.0f + score) {
+            std::printf("FAILED: iteration %d has the wrong renderer for the score %d\n", iteration, score);
+            failures++;
+        } else if (scoreEntity->getLocalTransform().position.x != 10.0f + score || scoreEntity->getLocalToWorldMatrix()[3].x != 10.0f + score) {
+            std::printf("FAILED: iteration %d has the wrong transform for the score %d\n", iteration, score);
+            failures++;
+        }
+    }
+
+    our::clearAllAssets();
+    std::printf("%d iterations, %zu entities, %d failures\n", ITERATIONS, entityCount, failures);
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,102 @@
+#include <systems/light-clusters.hpp>
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+// Checks the light cluster grid without a GPU:
+// a point in the view frustum must find every light that reaches it in the list of its cluster (found like the shader does),
+// and the lights that don't fit in a cluster must be counted in the statistics instead of being silently dropped
+#define LIGHT_COUNT 500
+#define POINT_COUNT 20000
+#define NEAR 0.1f
+#define FAR 100.0f
+
+namespace {
+
+    // Returns the light list of the cluster containing the given view space point (the same lookup as textured-light.frag)
+    std::vector<std::uint32_t> getPointLights(const our::LightClusterGrid& grid, const glm::mat4& projection, glm::vec3 point) {
+        glm::vec4 clip = projection * glm::vec4(point, 1.0f);
+        glm::vec2 ndc = glm::vec2(clip) / clip.w;
+        int x = std::clamp(int((ndc.x * 0.5f + 0.5f) * LIGHT_CLUSTER_COUNT_X), 0, LIGHT_CLUSTER_COUNT_X - 1);
+        int y = std::clamp(int((ndc.y * 0.5f + 0.5f) * LIGHT_CLUSTER_COUNT_Y), 0, LIGHT_CLUSTER_COUNT_Y - 1);
+        int z = std::clamp(int(std::floor(std::log(-point.z) * grid.getDepthScale() + grid.getDepthBias())), 0, LIGHT_CLUSTER_COUNT_Z - 1);
+        glm::uvec2 cluster = grid.getClusters()[(size_t(z) * LIGHT_CLUSTER_COUNT_Y + y) * LIGHT_CLUSTER_COUNT_X + x];
+        auto begin = grid.getLightIndices().begin() + cluster.x;
+        return std::vector<std::uint32_t>(begin, begin + cluster.y);
+    }
+
+}
+
+int main() {
+    int failures = 0;
+    std::mt19937 random(7);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+    glm::mat4 view = glm::lookAt(glm::vec3(3, 2, 10), glm::vec3(0, 0, 0), glm::vec3(0, 1, 0));
+    glm::mat4 projection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, NEAR, FAR);
+    glm::mat4 inverseView = glm::inverse(view);
+
+    // Random lights scattered in and around the frustum
+    std::vector<our::LightBounds> lights;
+    for (int index = 0; index < LIGHT_COUNT; index++) {
+        glm::vec3 center = glm::vec3(inverseView * glm::vec4(
+            (unit(random) * 2 - 1) * 60, (unit(random) * 2 - 1) * 35, -unit(random) * 110, 1.0f));
+        lights.push_back({center, 0.5f + unit(random) * 6});
+    }
+    our::LightClusterGrid grid;
+    grid.build(lights, view, projection, NEAR, FAR);
+    if (grid.getStatistics().lights != LIGHT_COUNT || grid.getStatistics().overflowingClusters != 0) {
+        std::printf("FAILED: the statistics of the scattered lights are wrong\n");
+        failures++;
+    }
+
+    // Every light that reaches a point must be listed in the cluster of the point
+    int checks = 0;
+    for (int index = 0; index < POINT_COUNT; index++) {
+        // The depth is picked like the slices are spaced (exponentially) so that the near slices get their share of points
+        float depth = NEAR * std::pow(FAR / NEAR, unit(random));
+        glm::vec3 viewPoint = glm::vec3(
+            (unit(random) * 2 - 1) * depth / projection[0][0], (unit(random) * 2 - 1) * depth / projection[1][1], -depth);
+        std::vector<std::uint32_t> clusterLights = getPointLights(grid, projection, viewPoint);
+        glm::vec3 worldPoint = glm::vec3(inverseView * glm::vec4(viewPoint, 1.0f));
+        for (std::uint32_t light = 0; light < lights.size(); light++) {
+            // The points very close to the surface of the sphere are skipped, since rounding decides if they are inside
+            if (glm::distance(worldPoint, lights[light].center) > lights[light].radius * 0.999f) continue;
+            checks++;
+            if (std::find(clusterLights.begin(), clusterLights.end(), light) == clusterLights.end()) {
+                std::printf("FAILED: the light %u reaches the point (%f, %f, %f) but isn't in its cluster\n", light, viewPoint.x, viewPoint.y, viewPoint.z);
+                failures++;
+            }
+        }
+    }
+
+    // Too many lights in the same place: the extra lights of each cluster are counted
+    std::vector<our::LightBounds> crowd(LIGHT_CLUSTER_MAX_LIGHTS + 44, our::LightBounds{glm::vec3(inverseView * glm::vec4(0, 0, -20, 1)), 0.5f});
+    grid.build(crowd, view, projection, NEAR, FAR);
+    const our::LightClusterStatistics& statistics = grid.getStatistics();
+    size_t expectedDropped = 0, fullClusters = 0;
+    for (glm::uvec2 cluster : grid.getClusters()) {
+        if (cluster.y > LIGHT_CLUSTER_MAX_LIGHTS) {
+            std::printf("FAILED: a cluster holds %u lights\n", cluster.y);
+            failures++;
+        }
+        if (cluster.y == LIGHT_CLUSTER_MAX_LIGHTS) {
+            fullClusters++;
+            expectedDropped += crowd.size() - LIGHT_CLUSTER_MAX_LIGHTS; // Every light of the crowd touches the same clusters
+        }
+    }
+    if (fullClusters == 0 || statistics.overflowingClusters != fullClusters || statistics.droppedLights != expectedDropped ||
+        statistics.maxLightsPerCluster != crowd.size()) {
+        std::printf("FAILED: the overflow statistics are wrong (%zu overflowing clusters, %zu dropped lights, at most %zu lights per cluster)\n",
+            statistics.overflowingClusters, statistics.droppedLights, statistics.maxLightsPerCluster);
+        failures++;
+    }
+
+    std::printf("%d light checks, %zu overflowing clusters with %zu dropped lights, %d failures\n",
+        checks, statistics.overflowingClusters, statistics.droppedLights, failures);
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,229 @@
+#include <mesh/mesh-utils.hpp>
+#include <systems/mesh-lod.hpp>
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <cmath>
+#include <cstdio>
+#include <set>
+#include <tuple>
+#include <vector>
+
+// Checks the mesh LODs without a GPU:
+// "mesh_utils::simplify" must reach the target triangle count without degenerate or flipped triangles (on a smooth sphere
+// with a texture seam, a flat shaded sphere and an open height field), and "LODSelector" must hold the level near a threshold
+#define SPHERE_RINGS 16
+#define SPHERE_SEGMENTS 32
+#define GRID_SIZE 40
+#define LOD_COUNT 4
+
+namespace {
+
+    using namespace our;
+
+    struct TestMesh {
+        const char* name;
+        std::vector<Vertex> vertices;
+        std::vector<GLuint> elements;
+        // Returns the direction the triangle at the given point should face (the triangles are counter clockwise around it)
+        glm::vec3 (*getOutside)(const glm::vec3& point);
+    };
+
+    Vertex makeVertex(const glm::vec3& position, const glm::vec2& texCoord, const glm::vec3& normal) {
+        Vertex vertex;
+        vertex.position = position;
+        vertex.color = Color(255, 255, 255, 255);
+        vertex.tex_coord = texCoord;
+        vertex.normal = normal;
+        return vertex;
+    }
+
+    // A unit UV sphere: the first and last columns share their positions (the texture seam) and so do the vertices of each pole
+    TestMesh makeSphere() {
+        TestMesh mesh{"sphere", {}, {}, [](const glm::vec3& point) { return point; }};
+        for(int ring = 0; ring <= SPHERE_RINGS; ring++) {
+            float theta = glm::pi<float>() * ring / SPHERE_RINGS;
+            for(int segment = 0; segment <= SPHERE_SEGMENTS; segment++) {
+                float phi = glm::two_pi<float>() * segment / SPHERE_SEGMENTS;
+                // The poles and the seam are computed exactly so the vertices sharing a position are equal
+                glm::vec3 position(std::sin(theta) * std::cos(phi), std::cos(theta), -std::sin(theta) * std::sin(phi));
+                if(ring == 0 || ring == SPHERE_RINGS) position = glm::vec3(0, ring == 0 ? 1 : -1, 0);
+                if(segment == SPHERE_SEGMENTS) position = mesh.vertices[mesh.vertices.size() - SPHERE_SEGMENTS].position;
+                mesh.vertices.push_back(makeVertex(position, {float(segment) / SPHERE_SEGMENTS, float(ring) / SPHERE_RINGS}, position));
+            }
+        }
+        for(int ring = 0; ring < SPHERE_RINGS; ring++) {
+            for(int segment = 0; segment < SPHERE_SEGMENTS; segment++) {
+                GLuint topLeft = ring * (SPHERE_SEGMENTS + 1) + segment, bottomLeft = topLeft + SPHERE_SEGMENTS + 1;
+                if(ring != 0) mesh.elements.insert(mesh.elements.end(), {topLeft, bottomLeft, topLeft + 1});
+                if(ring != SPHERE_RINGS - 1) mesh.elements.insert(mesh.elements.end(), {topLeft + 1, bottomLeft, bottomLeft + 1});
+            }
+        }
+        return mesh;
+    }
+
+    // The same sphere where every triangle has its own vertices with the normal of its face (like a flat shaded model)
+    TestMesh makeFlatSphere() {
+        TestMesh smooth = makeSphere();
+        TestMesh mesh{"flat sphere", {}, {}, smooth.getOutside};
+        for(size_t element = 0; element < smooth.elements.size(); element += 3) {
+            glm::vec3 corners[3];
+            for(int corner = 0; corner < 3; corner++) corners[corner] = smooth.vertices[smooth.elements[element + corner]].position;
+            glm::vec3 normal = glm::normalize(glm::cross(corners[1] - corners[0], corners[2] - corners[0]));
+            for(int corner = 0; corner < 3; corner++) {
+                mesh.elements.push_back(GLuint(mesh.vertices.size()));
+                mesh.vertices.push_back(makeVertex(corners[corner], smooth.vertices[smooth.elements[element + corner]].tex_coord, normal));
+            }
+        }
+        return mesh;
+    }
+
+    // A bumpy open grid in the xz plane facing up (its border has to stay in place)
+    TestMesh makeHeightField() {
+        TestMesh mesh{"height field", {}, {}, [](const glm::vec3&) { return glm::vec3(0, 1, 0); }};
+        for(int row = 0; row < GRID_SIZE; row++) {
+            for(int column = 0; column < GRID_SIZE; column++) {
+                float x = float(column) / (GRID_SIZE - 1) * 10.0f, z = float(row) / (GRID_SIZE - 1) * 10.0f;
+                glm::vec3 position(x, 0.3f * std::sin(x) * std::cos(z), z);
+                mesh.vertices.push_back(makeVertex(position, {x / 10.0f, z / 10.0f}, {0, 1, 0}));
+            }
+        }
+        for(int row = 0; row + 1 < GRID_SIZE; row++) {
+            for(int column = 0; column + 1 < GRID_SIZE; column++) {
+                GLuint first = row * GRID_SIZE + column, below = first + GRID_SIZE;
+                mesh.elements.insert(mesh.elements.end(), {first, below, first + 1, first + 1, below, below + 1});
+            }
+        }
+        return mesh;
+    }
+
+    // Simplifies the mesh to half its triangles a few times (like "generateLODs") and checks every level
+    int checkSimplify(const TestMesh& mesh) {
+        int failures = 0;
+        std::set<std::tuple<float, float, float>> originalPositions;
+        glm::vec3 originalMin(INFINITY), originalMax(-INFINITY);
+        for(const Vertex& vertex : mesh.vertices) {
+            originalPositions.insert({vertex.position.x, vertex.position.y, vertex.position.z});
+            originalMin = glm::min(originalMin, vertex.position);
+            originalMax = glm::max(originalMax, vertex.position);
+        }
+
+        std::vector<Vertex> vertices = mesh.vertices;
+        std::vector<GLuint> elements = mesh.elements;
+        std::printf("%s: %zu", mesh.name, elements.size() / 3);
+        for(int level = 1; level < LOD_COUNT; level++) {
+            size_t target = elements.size() / 6;
+            std::vector<Vertex> simplifiedVertices;
+            std::vector<GLuint> simplifiedElements;
+            mesh_utils::simplify(vertices, elements, target, simplifiedVertices, simplifiedElements);
+            std::printf(" -> %zu", simplifiedElements.size() / 3);
+            if(simplifiedElements.size() / 3 > target || simplifiedElements.size() % 3 != 0 || simplifiedElements.empty()) {
+                std::printf("\nFAILED: %s: the LOD %d has %zu triangles for a target of %zu\n", mesh.name, level, simplifiedElements.size() / 3, target);
+                failures++;
+            }
+            glm::vec3 boundsMin(INFINITY), boundsMax(-INFINITY);
+            int degenerate = 0, flipped = 0, invalid = 0;
+            for(const Vertex& vertex : simplifiedVertices) {
+                boundsMin = glm::min(boundsMin, vertex.position);
+                boundsMax = glm::max(boundsMax, vertex.position);
+                if(originalPositions.count({vertex.position.x, vertex.position.y, vertex.position.z}) == 0) invalid++;
+            }
+            for(size_t element = 0; element + 2 < simplifiedElements.size(); element += 3) {
+                if(simplifiedElements[element] >= simplifiedVertices.size() || simplifiedElements[element + 1] >= simplifiedVertices.size() ||
+                   simplifiedElements[element + 2] >= simplifiedVertices.size()) {
+                    invalid++;
+                    continue;
+                }
+                glm::vec3 a = simplifiedVertices[simplifiedElements[element]].position;
+                glm::vec3 b = simplifiedVertices[simplifiedElements[element + 1]].position;
+                glm::vec3 c = simplifiedVertices[simplifiedElements[element + 2]].position;
+                glm::vec3 normal = glm::cross(b - a, c - a);
+                if(a == b || b == c || c == a || glm::length(normal) < 1e-8f) degenerate++;
+                else if(glm::dot(normal, mesh.getOutside((a + b + c) / 3.0f)) <= 0.0f) flipped++;
+            }
+            if(degenerate || flipped || invalid) {
+                std::printf("\nFAILED: %s: the LOD %d has %d degenerate triangles, %d flipped triangles and %d invalid vertices or elements\n",
+                    mesh.name, level, degenerate, flipped, invalid);
+                failures++;
+            }
+            // Simplifying never moves a vertex, so the bounds can only shrink (and the border of the height field keeps them)
+            if(glm::any(glm::lessThan(boundsMin, originalMin)) || glm::any(glm::greaterThan(boundsMax, originalMax)) ||
+               glm::distance(boundsMin, originalMin) + glm::distance(boundsMax, originalMax) > 0.1f * glm::distance(originalMin, originalMax)) {
+                std::printf("\nFAILED: %s: the bounds of the LOD %d moved\n", mesh.name, level);
+                failures++;
+            }
+            vertices = std::move(simplifiedVertices);
+            elements = std::move(simplifiedElements);
+        }
+        std::printf(" triangles\n");
+        return failures;
+    }
+
+    int checkLevel(const char* name, size_t level, size_t expected) {
+        if(level == expected) return 0;
+        std::printf("FAILED: %s: the LOD is %zu instead of %zu\n", name, level, expected);
+        return 1;
+    }
+
+    int checkSelector() {
+        int failures = 0;
+        LODSelector selector(glm::vec3(0), glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 100.0f), 1.0f);
+        float threshold = selector.getThreshold(1);
+
+        // Around the threshold between the LOD 0 and 1, the level only changes past the hysteresis
+        failures += checkLevel("above the threshold", selector.selectLevel(0, LOD_COUNT, threshold * 1.2f), 0);
+        failures += checkLevel("just below the threshold", selector.selectLevel(0, LOD_COUNT, threshold * 0.95f), 0);
+        failures += checkLevel("below the hysteresis", selector.selectLevel(0, LOD_COUNT, threshold * 0.85f), 1);
+        failures += checkLevel("just above the threshold", selector.selectLevel(1, LOD_COUNT, threshold * 1.05f), 1);
+        failures += checkLevel("above the hysteresis", selector.selectLevel(1, LOD_COUNT, threshold * 1.15f), 0);
+
+        // A size that oscillates around the threshold (within the hysteresis) never changes the level
+        for(size_t start = 0; start < 2; start++) {
+            size_t level = start;
+            for(int frame = 0; frame < 100; frame++) {
+                level = selector.selectLevel(level, LOD_COUNT, threshold * (frame % 2 ? 1.08f : 0.92f));
+                if(level != start) {
+                    std::printf("FAILED: the LOD left %zu at the frame %d while oscillating around the threshold\n", start, frame);
+                    failures++;
+                    break;
+                }
+            }
+        }
+
+        // Big jumps skip levels, and the level is clamped to the available levels
+        failures += checkLevel("tiny", selector.selectLevel(0, LOD_COUNT, threshold * 0.01f), LOD_COUNT - 1);
+        failures += checkLevel("huge", selector.selectLevel(LOD_COUNT - 1, LOD_COUNT, threshold * 10.0f), 0);
+        failures += checkLevel("fewer levels", selector.selectLevel(3, 2, threshold * 0.01f), 1);
+        failures += checkLevel("no LOD", selector.selectLevel(0, 1, threshold * 0.01f), 0);
+        failures += checkLevel("disabled", LODSelector(glm::vec3(0), glm::mat4(1.0f), 0.0f).selectLevel(2, LOD_COUNT, 0.001f), 0);
+
+        // A sphere moving away then back goes through every level in order and returns to the full mesh
+        size_t level = 0;
+        int levelChanges = 0;
+        for(int step = 0; step <= 400; step++) {
+            float distance = 1.0f + (step <= 200 ? step : 400 - step) * 0.5f;
+            size_t next = selector.selectLevel(level, LOD_COUNT, selector.getProjectedSize(glm::vec4(0, 0, -distance, 1.0f)));
+            if(next != level) levelChanges++;
+            if((step <= 200 && next < level) || (step > 200 && next > level) || next > level + 1 || next + 1 < level) {
+                std::printf("FAILED: the LOD went from %zu to %zu at the distance %f\n", level, next, distance);
+                failures++;
+            }
+            level = next;
+        }
+        if(level != 0 || levelChanges != 2 * (LOD_COUNT - 1)) {
+            std::printf("FAILED: the moving sphere ended at the LOD %zu after %d changes\n", level, levelChanges);
+            failures++;
+        }
+        return failures;
+    }
+
+}
+
+int main() {
+    int failures = 0;
+    failures += checkSimplify(makeSphere());
+    failures += checkSimplify(makeFlatSphere());
+    failures += checkSimplify(makeHeightField());
+    failures += checkSelector();
+    std::printf("%d failures\n", failures);
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,135 @@
+#include <systems/obstacle-collision.hpp>
+
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+// Checks the swept-sphere queries of the obstacle collision system:
+// a fast sweep must hit an obstacle it passes through within a single step (at the time of the first contact),
+// and the grid broadphase must find the same first hit as a brute force test of every obstacle
+#define OBSTACLE_COUNT 1000
+#define SWEEP_COUNT 5000
+#define TIME_TOLERANCE 1e-4f
+// A path that passes this close to the surface of an obstacle grazes it: whether they touch is decided by rounding errors
+#define GRAZE_TOLERANCE 1e-4f
+
+namespace {
+
+    struct Sphere {
+        glm::vec3 position;
+        float radius;
+    };
+
+    // The distance between the surfaces of the obstacle and of the sphere at the closest point of its path (negative if they touch)
+    float clearance(glm::vec3 from, glm::vec3 to, float radius, const Sphere& obstacle) {
+        glm::vec3 direction = to - from;
+        float length2 = glm::dot(direction, direction);
+        float closest = length2 > 0 ? glm::clamp(glm::dot(obstacle.position - from, direction) / length2, 0.0f, 1.0f) : 0.0f;
+        return glm::distance(from + closest * direction, obstacle.position) - radius - obstacle.radius;
+    }
+
+    // The time of the first contact of a sphere moving from "from" to "to" with the obstacle (or a negative value if they never touch)
+    // It doesn't share the closed form of the system: the distance to the obstacle decreases until the closest point of the path,
+    // so the first contact is found by bisection between the start of the sweep and the closest point
+    float bruteForceTime(glm::vec3 from, glm::vec3 to, float radius, const Sphere& obstacle) {
+        auto touching = [&](float time) {
+            return glm::distance(from + time * (to - from), obstacle.position) <= radius + obstacle.radius;
+        };
+        if (touching(0)) return 0;
+        glm::vec3 direction = to - from;
+        float length2 = glm::dot(direction, direction);
+        float closest = length2 > 0 ? glm::clamp(glm::dot(obstacle.position - from, direction) / length2, 0.0f, 1.0f) : 0.0f;
+        if (!touching(closest)) return -1;
+        float low = 0, high = closest;
+        for (int step = 0; step < 40; step++) {
+            float middle = 0.5f * (low + high);
+            (touching(middle) ? high : low) = middle;
+        }
+        return high;
+    }
+
+    // The first hit of the sweep found by testing every obstacle
+    bool bruteForceSweep(const std::vector<Sphere>& obstacles, glm::vec3 from, glm::vec3 to, float radius, our::CollisionHit& hit) {
+        bool found = false;
+        for (size_t index = 0; index < obstacles.size(); index++) {
+            float time = bruteForceTime(from, to, radius, obstacles[index]);
+            if (time >= 0 && (!found || time < hit.time)) {
+                hit = {index, time};
+                found = true;
+            }
+        }
+        return found;
+    }
+
+}
+
+int main() {
+    int failures = 0;
+
+    // A sphere moving 200 units in one step must not tunnel through an obstacle that neither of its positions touches
+    {
+        our::ObstacleCollisionSystem system;
+        system.addObstacle(5.0f, {0, 0, -300});
+        size_t wall = system.addObstacle(1.0f, {0, 0, 0});
+        our::CollisionHit hit;
+        glm::vec3 from = {0, 0, 100}, to = {0, 0, -100};
+        if (system.isCollision(1.0f, from) || system.isCollision(1.0f, to)) {
+            std::printf("FAILED: the start or the end of the fast sweep already touches the obstacle\n");
+            failures++;
+        }
+        // The spheres touch when the center of the player reaches z = 2, which is 98 units into the 200 units of the sweep
+        if (!system.sweepSphere(from, to, 1.0f, hit) || hit.obstacle != wall || std::abs(hit.time - 0.49f) > TIME_TOLERANCE) {
+            std::printf("FAILED: the fast sweep didn't report the obstacle at time 0.49\n");
+            failures++;
+        }
+        // A sweep moving away from the obstacle or passing beside it doesn't hit it
+        if (system.sweepSphere({0, 0, 3}, {0, 0, 100}, 1.0f, hit) || system.sweepSphere({2.5f, 0, 100}, {2.5f, 0, -100}, 0.4f, hit)) {
+            std::printf("FAILED: a sweep that misses the obstacle reported a hit\n");
+            failures++;
+        }
+    }
+
+    // Random obstacles (also at negative coordinates) and random sweeps, compared with a brute force test of every obstacle
+    std::mt19937 random(42);
+    std::uniform_real_distribution<float> coordinate(-60.0f, 60.0f), radius(0.2f, 3.0f), step(-20.0f, 20.0f);
+    std::vector<Sphere> obstacles;
+    our::ObstacleCollisionSystem system;
+    for (int index = 0; index < OBSTACLE_COUNT; index++) {
+        obstacles.push_back({{coordinate(random), coordinate(random), coordinate(random)}, radius(random)});
+        system.addObstacle(obstacles.back().radius, obstacles.back().position);
+    }
+    int hits = 0, grazes = 0;
+    for (int sweep = 0; sweep < SWEEP_COUNT; sweep++) {
+        // Half of the way through, some obstacles are moved to check that the grid follows them
+        if (sweep == SWEEP_COUNT / 2) {
+            for (size_t index = 0; index < obstacles.size(); index += 3) {
+                obstacles[index] = {{coordinate(random), coordinate(random), coordinate(random)}, radius(random)};
+                system.updateObstacle(index, obstacles[index].radius, obstacles[index].position);
+            }
+        }
+        glm::vec3 from = {coordinate(random), coordinate(random), coordinate(random)};
+        glm::vec3 to = from + glm::vec3(step(random), step(random), step(random));
+        float sphereRadius = radius(random);
+        our::CollisionHit hit{}, expected{};
+        bool found = system.sweepSphere(from, to, sphereRadius, hit);
+        bool expectedFound = bruteForceSweep(obstacles, from, to, sphereRadius, expected);
+        // Two obstacles may be touched at (almost) the same time, so the hit is compared through its time
+        bool same = found == expectedFound && (!found || (std::abs(hit.time - expected.time) <= TIME_TOLERANCE &&
+            std::abs(bruteForceTime(from, to, sphereRadius, obstacles[hit.obstacle]) - hit.time) <= TIME_TOLERANCE));
+        // The results may only differ if the first obstacle found by one of them is grazed by the path
+        bool grazing = (found && std::abs(clearance(from, to, sphereRadius, obstacles[hit.obstacle])) < GRAZE_TOLERANCE) ||
+            (expectedFound && std::abs(clearance(from, to, sphereRadius, obstacles[expected.obstacle])) < GRAZE_TOLERANCE);
+        if (!same && grazing) {
+            grazes++;
+        } else if (!same) {
+            std::printf("FAILED: sweep %d found %s at %f, brute force found %s at %f\n", sweep,
+                found ? "a hit" : "nothing", found ? hit.time : 0.0f, expectedFound ? "a hit" : "nothing", expectedFound ? expected.time : 0.0f);
+            failures++;
+        }
+        if (found) hits++;
+    }
+
+    std::printf("%d sweeps against %d obstacles, %d hits, %d grazes, %d failures\n", SWEEP_COUNT, OBSTACLE_COUNT, hits, grazes, failures);
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,93 @@
+#include <systems/occlusion-culling.hpp>
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <cstdio>
+#include <vector>
+
+// Checks the CPU occlusion culling without a GPU: the camera is at the origin looking down -z,
+// a wall hides the boxes behind it and a ground plane (which crosses the near plane) hides the boxes under it.
+// The same test is built twice: with the SSE rasterizer and with OCCLUSION_CULLING_SCALAR
+#define WALL_DISTANCE 10.0f
+
+namespace {
+
+    // A quad made of 2 triangles with its corners in the given order
+    struct Quad {
+        glm::vec3 positions[4];
+        std::uint32_t elements[6] = {0, 1, 2, 2, 3, 0};
+    };
+
+    // The box of a mesh (a unit cube around the origin) moved to the given position
+    struct Box {
+        const char* name;
+        glm::vec3 position;
+        bool visible;
+    };
+
+    int checkBoxes(const our::OcclusionCuller& culler, const std::vector<Box>& boxes) {
+        int failures = 0;
+        for(const Box& box : boxes) {
+            bool visible = culler.isVisible(glm::translate(glm::mat4(1.0f), box.position), glm::vec3(-0.5f), glm::vec3(0.5f));
+            if(visible != box.visible) {
+                std::printf("FAILED: the box %s is %s\n", box.name, visible ? "visible" : "hidden");
+                failures++;
+            }
+        }
+        return failures;
+    }
+
+}
+
+int main() {
+    int failures = 0;
+    glm::mat4 projection = glm::perspective(glm::radians(60.0f), 2.0f, 0.1f, 100.0f);
+    our::OcclusionCuller culler;
+
+    // A 10x6 wall facing the camera (it covers about 43% of the width and 52% of the height of the view)
+    Quad wall = {{{-5, -3, -WALL_DISTANCE}, {5, -3, -WALL_DISTANCE}, {5, 3, -WALL_DISTANCE}, {-5, 3, -WALL_DISTANCE}}};
+    culler.beginFrame(projection);
+    culler.addOccluder(glm::mat4(1.0f), wall.positions, wall.elements, 6);
+    culler.rasterizeOccluders();
+    if(culler.getStats().occluders != 1 || culler.getStats().occluderTriangles != 2 ||
+        culler.getDepth(OCCLUSION_BUFFER_WIDTH / 2, OCCLUSION_BUFFER_HEIGHT / 2) >= 1.0f) {
+        std::printf("FAILED: the wall was not rasterized\n");
+        failures++;
+    }
+    failures += checkBoxes(culler, {
+        {"behind the wall", {0, 0, -20}, false},
+        {"behind the wall, near its corner", {-6, 3, -20}, false},
+        {"far behind the wall", {2, -1, -90}, false},
+        {"in front of the wall", {0, 0, -5}, true},
+        {"touching the front of the wall", {0, 0, -WALL_DISTANCE + 0.5f}, true},
+        {"beside the wall", {15, 0, -20}, true},
+        {"above the wall", {0, 8, -20}, true},
+        {"half hidden by the edge of the wall", {10, 0, -20}, true},
+        {"crossing the near plane", {0, 0, -0.05f}, true},
+        {"behind the camera", {0, 0, 5}, true},
+    });
+
+    // A big ground plane under the camera: it extends behind the camera so it has to be clipped against the near plane
+    Quad ground = {{{-50, -1, 50}, {50, -1, 50}, {50, -1, -50}, {-50, -1, -50}}};
+    culler.beginFrame(projection);
+    culler.addOccluder(glm::mat4(1.0f), ground.positions, ground.elements, 6);
+    culler.rasterizeOccluders();
+    failures += checkBoxes(culler, {
+        {"under the ground", {0, -5, -10}, false},
+        {"far under the ground", {3, -8, -30}, false},
+        {"on the ground", {0, -0.5f, -10}, true},
+        {"above the ground", {0, 2, -10}, true},
+        {"under the ground, crossing the near plane", {0, -0.6f, 0}, true},
+    });
+
+    // Without occluders, nothing is hidden
+    culler.beginFrame(projection);
+    culler.rasterizeOccluders();
+    failures += checkBoxes(culler, {{"with no occluder", {0, 0, -20}, true}});
+
+#ifdef OCCLUSION_CULLING_SSE
+    std::printf("SSE rasterizer, %d failures\n", failures);
+#else
+    std::printf("scalar rasterizer, %d failures\n", failures);
+#endif
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,126 @@
+#include <mesh/mesh.hpp>
+
+#include <glm/gtc/packing.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+// Checks the packed and quantized vertex formats without a GPU: every vertex is encoded then decoded the way the vertex fetch
+// converts the attributes (see Mesh::setVertexAttributes), and the result must be within the precision of each attribute.
+// It also checks that the meshes use 16-bit elements exactly when they have at most 65536 vertices
+#define VERTEX_COUNT 100000
+
+namespace {
+
+    using namespace our;
+
+    struct Errors {
+        float position = 0, texCoord = 0, normal = 0;
+        int colors = 0;
+    };
+
+    // GL converts a half float to a float exactly and a signed normalized 10-bit component c to max(c / 511, -1)
+    glm::vec2 decodeTexCoord(std::uint32_t texCoord) { return glm::unpackHalf2x16(texCoord); }
+    glm::vec3 decodeNormal(std::uint32_t normal) { return glm::vec3(glm::unpackSnorm3x10_1x2(normal)); }
+
+    // A half float has 11 significant bits, so rounding moves a value by at most 2^-11 of its magnitude
+    // (the values under 2^-14 are denormals with a fixed step of 2^-24)
+    float getHalfTolerance(float value) { return std::max(std::abs(value), 6.1e-5f) * 4.9e-4f; }
+
+    // Returns the largest error of the components of "decoded" relative to their tolerance (above 1 means out of tolerance)
+    float getTexCoordError(const glm::vec2& original, const glm::vec2& decoded) {
+        return std::max(std::abs(decoded.x - original.x) / getHalfTolerance(original.x), std::abs(decoded.y - original.y) / getHalfTolerance(original.y));
+    }
+
+    // The 10-bit components are rounded to the nearest multiple of 1/511 (so they move by half a step, plus the float error)
+    float getNormalError(const glm::vec3& original, const glm::vec3& decoded) {
+        glm::vec3 difference = glm::abs(decoded - original) / (0.5f / 511.0f + 1e-6f);
+        return std::max(difference.x, std::max(difference.y, difference.z));
+    }
+
+}
+
+int main() {
+    int failures = 0;
+    std::mt19937 random(25);
+    std::uniform_real_distribution<float> position(-50.0f, 50.0f), texCoord(-4.0f, 4.0f), unit(-1.0f, 1.0f);
+    std::uniform_int_distribution<int> byte(0, 255);
+
+    std::vector<Vertex> vertices(VERTEX_COUNT);
+    glm::vec3 boundsMin(INFINITY), boundsMax(-INFINITY);
+    for(size_t index = 0; index < vertices.size(); index++) {
+        Vertex& vertex = vertices[index];
+        vertex.position = glm::vec3(position(random), position(random) * 0.2f, position(random));
+        vertex.color = Color(byte(random), byte(random), byte(random), byte(random));
+        vertex.tex_coord = glm::vec2(texCoord(random), texCoord(random) * 0.001f);
+        glm::vec3 normal(unit(random), unit(random), unit(random));
+        vertex.normal = glm::length(normal) > 1e-3f ? glm::normalize(normal) : glm::vec3(0, 1, 0);
+        // A few normals along the axes, where the components reach -1 and 1 exactly
+        if(index < 6) vertex.normal = glm::vec3(0), vertex.normal[index % 3] = index < 3 ? 1.0f : -1.0f;
+        boundsMin = glm::min(boundsMin, vertex.position);
+        boundsMax = glm::max(boundsMax, vertex.position);
+    }
+
+    // The quantization covers the bounds with the same scale along the 3 axes (like the Mesh constructor)
+    glm::vec3 offset = boundsMin;
+    float scale = std::max(glm::max(boundsMax.x - boundsMin.x, glm::max(boundsMax.y - boundsMin.y, boundsMax.z - boundsMin.z)), 1e-6f);
+    // Rounding to 16 bits moves a position by half a step, plus the float error of the decoding
+    float positionTolerance = scale / 65535.0f * 0.5f + scale * 1e-6f;
+
+    Errors packedErrors, quantizedErrors;
+    std::uint16_t quantizedMin = 65535, quantizedMax = 0;
+    for(const Vertex& vertex : vertices) {
+        PackedVertex packed = packVertex(vertex);
+        if(packed.position != vertex.position) packedErrors.position = INFINITY;
+        packedErrors.colors += packed.color != vertex.color;
+        packedErrors.texCoord = std::max(packedErrors.texCoord, getTexCoordError(vertex.tex_coord, decodeTexCoord(packed.tex_coord)));
+        packedErrors.normal = std::max(packedErrors.normal, getNormalError(vertex.normal, decodeNormal(packed.normal)));
+
+        QuantizedVertex quantized = quantizeVertex(vertex, offset, scale);
+        // The GPU normalizes the 16-bit positions to [0, 1] then the object matrix applies Mesh::getPositionDecoding
+        glm::vec3 decoded = offset + glm::vec3(quantized.position) / 65535.0f * scale;
+        glm::vec3 difference = glm::abs(decoded - vertex.position);
+        quantizedErrors.position = std::max(quantizedErrors.position, std::max(difference.x, std::max(difference.y, difference.z)) / positionTolerance);
+        quantizedErrors.colors += quantized.color != vertex.color;
+        quantizedErrors.texCoord = std::max(quantizedErrors.texCoord, getTexCoordError(vertex.tex_coord, decodeTexCoord(quantized.tex_coord)));
+        quantizedErrors.normal = std::max(quantizedErrors.normal, getNormalError(vertex.normal, decodeNormal(quantized.normal)));
+        quantizedMin = std::min({quantizedMin, quantized.position.x, quantized.position.y, quantized.position.z});
+        quantizedMax = std::max({quantizedMax, quantized.position.x, quantized.position.y, quantized.position.z});
+    }
+    for(auto [name, errors] : {std::pair<const char*, Errors>{"packed", packedErrors}, {"quantized", quantizedErrors}}) {
+        std::printf("%s: position %.3f, texture coordinates %.3f, normal %.3f of the tolerance, %d wrong colors\n",
+            name, errors.position, errors.texCoord, errors.normal, errors.colors);
+        if(!(errors.position <= 1.0f && errors.texCoord <= 1.0f && errors.normal <= 1.0f) || errors.colors != 0) {
+            std::printf("FAILED: the %s vertices don't round-trip within the tolerance\n", name);
+            failures++;
+        }
+    }
+    // The quantized positions use the whole 16-bit range along the largest axis of the bounds
+    if(quantizedMin != 0 || quantizedMax != 65535) {
+        std::printf("FAILED: the quantized positions go from %u to %u instead of 0 to 65535\n", quantizedMin, quantizedMax);
+        failures++;
+    }
+
+    // 16-bit elements exactly when every vertex can be indexed with 16 bits
+    const size_t vertexCounts[] = {0, 3, 65535, 65536, 65537, 1000000};
+    for(size_t vertexCount : vertexCounts) {
+        GLenum expected = vertexCount <= 65536 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+        if(Mesh::chooseElementType(vertexCount) != expected) {
+            std::printf("FAILED: a mesh with %zu vertices uses %s elements\n", vertexCount, expected == GL_UNSIGNED_SHORT ? "32-bit" : "16-bit");
+            failures++;
+        }
+    }
+    // The elements of the largest mesh with 16-bit elements (including the last vertex, 65535) are kept exactly
+    std::vector<unsigned int> elements;
+    for(unsigned int element = 0; element < 65536; element++) elements.insert(elements.end(), {element, 65535 - element, (element * 7919) % 65536});
+    std::vector<std::uint16_t> shortElements = Mesh::packShortElements(elements);
+    if(shortElements.size() != elements.size() || !std::equal(elements.begin(), elements.end(), shortElements.begin())) {
+        std::printf("FAILED: the 16-bit elements differ from the original elements\n");
+        failures++;
+    }
+
+    std::printf("%d failures\n", failures);
+    return failures == 0 ? 0 : 1;
+}